@@ -1,16 +1,25 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <SDL.h>
 #include <cstdlib>
 #include <ctime>
 
 // Engine headers
 #include <Vec2.h>
-#include <Body.h>
 #include <CircleShape.h>
 #include <PolygonShape.h>
-#include <Collision.h>
+#include <Broadphase.h>
+#include <World.h>
+#include <Profiler.h>
+#include <ShapeRegistry.h>
+#include <Snapshot.h>
+#include <Trajectory.h>
+#include <Integrator.h>
+#include <SDLDebugDraw.h>
 
 // ImGui headers
 #include <imgui.h>
@@ -20,7 +29,7 @@
 // --- Constants ---
 const int WINDOW_WIDTH = 1280;
 const int WINDOW_HEIGHT = 720;
-const float TIME_PER_FRAME = 1.0f / 60.0f;
+const float PHYSICS_RATE = 60.0f; // Steps per second, whatever the frame rate
 
 // --- Main Application ---
 int main(int argc, char *argv[])
@@ -37,7 +46,23 @@ int main(int argc, char *argv[])
 
     // --- Game Setup ---
     bool isRunning = true;
-    std::vector<std::unique_ptr<Body>> bodies;
+    // The world is drawn in pixels, so the window is the viewport: bodies
+    // outside it are culled before they reach the renderer
+    SDLDebugDraw debugDraw(renderer);
+    debugDraw.SetViewport(AABB(Vec2(0.0f, 0.0f), Vec2(WINDOW_WIDTH, WINDOW_HEIGHT)));
+    World world;
+    world.gravity = Vec2(0.0f, 980.0f);
+    world.fixedTimeStep = 1.0f / PHYSICS_RATE;
+    int physicsRate = static_cast<int>(PHYSICS_RATE);
+    bool interpolate = true;
+
+    // "None" tests all pairs, for validating the other broadphases
+    const char *broadphaseNames[] = {"None (all pairs)", "Uniform grid", "Dynamic AABB tree"};
+    int broadphaseIndex = 2;
+    int threadCount = world.GetThreadCount();
+    bool fireAsBullet = true;
+    std::vector<float> stepTimes; // Profiler history, in ms, oldest first
+    const char *traceStatus = "";
 
     const float floorWidth = WINDOW_WIDTH;
     const float floorHeight = 30.0f;
@@ -46,12 +71,57 @@ int main(int argc, char *argv[])
         {floorWidth / 2.0f, -floorHeight / 2.0f},
         {floorWidth / 2.0f, floorHeight / 2.0f},
         {-floorWidth / 2.0f, floorHeight / 2.0f}};
-    bodies.push_back(std::make_unique<Body>(PolygonShape(floorVertices, 0.0f), WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT - (floorHeight / 2.0f)));
+    world.CreateBody(PolygonShape(floorVertices, 0.0f), WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT - (floorHeight / 2.0f));
+
+    // The shapes of the spawned bodies, built once: every box references
+    // the same registered outline instead of a copy of its own
+    const std::vector<Vec2> boxVertices = {{-30, -30}, {30, -30}, {30, 30}, {-30, 30}};
+    const PolygonShape boxShape(world.GetShapeRegistry().GetPolygon(boxVertices), 5.0f);
+    const CircleShape ballShape(30.0f, 5.0f);
+
+    // Stress mode keeps the window filled with thousands of small bodies, a
+    // mix of balls and polygons, to see how each setting holds up under
+    // load. Walls on both sides keep the pile on screen.
+    ShapeRegistry &registry = world.GetShapeRegistry();
+    const CircleShape stressBall(5.0f, 1.0f);
+    const PolygonShape stressPolygons[] = {
+        PolygonShape(registry.GetPolygon({{-5, -5}, {5, -5}, {5, 5}, {-5, 5}}), 1.0f),
+        PolygonShape(registry.GetPolygon({{0, -6}, {6, 5}, {-6, 5}}), 1.0f),
+        PolygonShape(registry.GetPolygon({{-3, -6}, {3, -6}, {7, 0}, {3, 6}, {-3, 6}, {-7, 0}}), 1.0f)};
+    bool stressMode = false;
+    std::vector<BodyHandle> stressWalls;
+    int stressTarget = 3000;
+    int stressSpawnPerFrame = 40;
+    std::vector<BodyHandle> stressBodies;
+    std::vector<float> frameTimes(240, 0.0f); // Ring buffer, in ms
+    size_t frameTimeCursor = 0;
+
+    // Saved by the "Save state" button, to jump back to
+    Snapshot savedState;
+
+    // Every step goes to trajectory.p2dt while recording. Replaying shows the
+    // recorded frames instead of the live simulation, which is paused.
+    const char *trajectoryPath = "trajectory.p2dt";
+    TrajectoryRecorder recorder;
+    TrajectoryReader replay;
+    TrajectoryFrame replayFrame;
+    bool replaying = false;
+    bool replayPlaying = true;
+    float replayPosition = 0.0f; // In frames
+    const char *trajectoryStatus = "";
 
     // --- Main Loop ---
     float spawnTimer = 0.0f;
+    Uint64 lastCounter = SDL_GetPerformanceCounter();
     while (isRunning)
     {
+        // Real time since the last frame
+        const Uint64 counter = SDL_GetPerformanceCounter();
+        const float elapsedTime = static_cast<float>(counter - lastCounter) / static_cast<float>(SDL_GetPerformanceFrequency());
+        lastCounter = counter;
+        frameTimes[frameTimeCursor] = 1000.0f * elapsedTime;
+        frameTimeCursor = (frameTimeCursor + 1) % frameTimes.size();
+
         // --- Event Handling ---
         SDL_Event event;
         while (SDL_PollEvent(&event))
@@ -64,77 +134,301 @@ int main(int argc, char *argv[])
         }
 
         // --- Spawning New Bodies ---
-        spawnTimer += TIME_PER_FRAME;
-        if (spawnTimer > 0.5f)
+        spawnTimer += elapsedTime;
+        if (spawnTimer > 0.5f && !replaying)
         {
-            if (bodies.size() < 20)
+            if (world.GetBodyCount() < 20)
             {
-                std::vector<Vec2> boxVertices = {{-30, -30}, {30, -30}, {30, 30}, {-30, 30}};
-                bodies.push_back(std::make_unique<Body>(
-                    PolygonShape(boxVertices, 5.0f),
-                    100 + rand() % (WINDOW_WIDTH - 200),
-                    50 + rand() % 150));
+                // Every other body is a ball: circles and polygons collide
+                // with each other through GJK/EPA
+                const float x = 100 + rand() % (WINDOW_WIDTH - 200);
+                const float y = 50 + rand() % 150;
+                if (world.GetBodyCount() % 2 == 0)
+                {
+                    world.CreateBody(ballShape, x, y);
+                }
+                else
+                {
+                    world.CreateBody(boxShape, x, y);
+                }
             }
             spawnTimer = 0.0f;
         }
 
-        // --- Physics Update ---
-        for (auto &body : bodies)
+        // Towards the target count a few bodies per frame, dropped from above
+        // the window; the newest go first when the target is lowered
+        if (stressMode && !replaying)
         {
-            if (body->inverseMass != 0.0f)
+            if (stressWalls.empty())
+            {
+                const std::vector<Vec2> wallVertices = {{-15, -WINDOW_HEIGHT}, {15, -WINDOW_HEIGHT}, {15, WINDOW_HEIGHT}, {-15, WINDOW_HEIGHT}};
+                stressWalls.push_back(world.CreateBody(PolygonShape(wallVertices, 0.0f), -15.0f, 0.0f));
+                stressWalls.push_back(world.CreateBody(PolygonShape(wallVertices, 0.0f), WINDOW_WIDTH + 15.0f, 0.0f));
+            }
+            for (int spawned = 0; spawned < stressSpawnPerFrame && stressBodies.size() < static_cast<size_t>(stressTarget); ++spawned)
             {
-                body->AddForce(Vec2(0.0, 980.0f * body->shape->mass));
+                const float x = 20 + rand() % (WINDOW_WIDTH - 40);
+                const float y = -20 - rand() % 200;
+                const size_t kind = stressBodies.size() % 4;
+                if (kind == 0)
+                    stressBodies.push_back(world.CreateBody(stressBall, x, y));
+                else
+                    stressBodies.push_back(world.CreateBody(stressPolygons[kind - 1], x, y));
             }
         }
-        for (auto &body : bodies)
+        // Removed in one batch: one by one, each body would scan all the
+        // others. The walls go when stress mode is left.
+        const size_t stressKept = stressMode ? std::min(stressBodies.size(), static_cast<size_t>(stressTarget)) : 0;
+        if (stressKept < stressBodies.size())
+        {
+            world.DestroyBodies(std::vector<BodyHandle>(stressBodies.begin() + stressKept, stressBodies.end()));
+            stressBodies.resize(stressKept);
+        }
+        if (!stressMode && !stressWalls.empty())
         {
-            body->Integrate(TIME_PER_FRAME);
+            world.DestroyBodies(stressWalls);
+            stressWalls.clear();
         }
 
-        // --- Collision Detection and Resolution ---
-        Collision::DetectAndResolveCollisions(bodies);
+        // --- Physics Update ---
+        // As many fixed steps as fit in the time that passed, so the
+        // simulation runs at the same speed whatever the frame rate
+        const int steps = replaying ? 0 : world.Update(elapsedTime);
+        if (replaying && replayPlaying)
+        {
+            replayPosition = std::fmod(replayPosition + elapsedTime / replay.GetFrameTime(), static_cast<float>(replay.GetFrameCount()));
+        }
 
         // --- Rendering ---
         SDL_SetRenderDrawColor(renderer, 10, 10, 30, 255);
         SDL_RenderClear(renderer);
 
-        for (const auto &body : bodies)
+        // Between the last two steps, for smooth motion when the physics
+        // runs slower than the display
+        if (replaying)
         {
-            if (body->inverseMass == 0.0f)
-            {
-                SDL_SetRenderDrawColor(renderer, 0, 255, 100, 255);
-            }
+            if (replay.ReadFrame(static_cast<std::uint64_t>(replayPosition), replayFrame))
+                replay.Draw(replayFrame, debugDraw);
+        }
+        else if (interpolate)
+            world.DrawInterpolated(debugDraw);
+        else
+            world.Draw(debugDraw);
+        debugDraw.Flush();
+
+        // --- ImGui ---
+        ImGui_ImplSDLRenderer2_NewFrame();
+        ImGui_ImplSDL2_NewFrame();
+        ImGui::NewFrame();
+        ImGui::Begin("Info");
+        ImGui::Text("Boxes and balls are spawned periodically.");
+        ImGui::Text("Contacts are clipped manifolds, solved with sequential impulses.");
+        ImGui::Text("Body count: %zu", world.GetBodyCount());
+        ImGui::Text("Frame: %.2f ms, %d physics steps", 1000.0f * elapsedTime, steps);
+        if (ImGui::SliderInt("Physics rate (Hz)", &physicsRate, 10, 240))
+        {
+            world.fixedTimeStep = 1.0f / static_cast<float>(physicsRate);
+        }
+        ImGui::SliderInt("Max steps per frame", &world.maxStepsPerUpdate, 1, 20);
+        ImGui::Checkbox("Interpolate", &interpolate);
+        ImGui::CheckboxFlags("Draw AABBs", &debugDraw.flags, DebugDraw::AABBS);
+        ImGui::SameLine();
+        ImGui::CheckboxFlags("Draw contacts", &debugDraw.flags, DebugDraw::CONTACTS);
+        ImGui::Text("Debug draw: %d vertices in one call", debugDraw.GetFlushedVertexCount());
+        if (ImGui::Combo("Broadphase", &broadphaseIndex, broadphaseNames, IM_ARRAYSIZE(broadphaseNames)))
+        {
+            if (broadphaseIndex == 0)
+                world.SetBroadphase(std::make_unique<BruteForceBroadphase>());
+            else if (broadphaseIndex == 1)
+                world.SetBroadphase(std::make_unique<UniformGridBroadphase>());
             else
+                world.SetBroadphase(std::make_unique<TreeBroadphase>());
+        }
+        ImGui::Text("Candidate pairs: %zu", world.GetPairs().size());
+        ImGui::Text("Integrator: %s", Integrator::GetBackendName(Integrator::GetBackend()));
+        if (ImGui::SliderInt("Threads", &threadCount, 1, 16))
+        {
+            world.SetThreadCount(threadCount);
+        }
+        ImGui::Text("Islands: %zu", world.GetIslands().GetIslandCount());
+        ImGui::SliderInt("Velocity iterations", &world.solverSettings.velocityIterations, 1, 30);
+        ImGui::SliderInt("Position iterations", &world.solverSettings.positionIterations, 0, 10);
+        ImGui::Checkbox("Warm starting", &world.solverSettings.warmStarting);
+        ImGui::SliderFloat("Friction", &world.solverSettings.friction, 0.0f, 1.0f);
+        ImGui::SliderFloat("Restitution", &world.solverSettings.restitution, 0.0f, 1.0f);
+        ImGui::Checkbox("Allow sleeping", &world.allowSleep);
+        ImGui::Text("Awake bodies: %zu", world.GetAwakeBodyCount());
+        // A pebble this fast moves several floor thicknesses per frame: it
+        // only stops on the floor when swept as a bullet
+        if (ImGui::Button("Fire pebble"))
+        {
+            const BodyHandle pebble = world.CreateBody(CircleShape(4.0f, 1.0f), 100 + rand() % (WINDOW_WIDTH - 200), 20.0f);
+            world.GetBody(pebble).SetVelocity(Vec2(0.0f, 6000.0f));
+            world.GetBody(pebble).SetBullet(fireAsBullet);
+        }
+        ImGui::SameLine();
+        ImGui::Checkbox("As bullet", &fireAsBullet);
+        if (ImGui::Button("Save state"))
+        {
+            world.Save(savedState);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Restore state") && world.Restore(SnapshotReader(savedState)))
+        {
+            physicsRate = static_cast<int>(std::lround(1.0f / world.fixedTimeStep));
+            // Stress bodies and walls the snapshot does not have are gone.
+            // Forget them now, before their slots go to other bodies.
+            auto isGone = [&](BodyHandle handle)
+            { return !world.IsValid(handle); };
+            stressBodies.erase(std::remove_if(stressBodies.begin(), stressBodies.end(), isGone), stressBodies.end());
+            stressWalls.erase(std::remove_if(stressWalls.begin(), stressWalls.end(), isGone), stressWalls.end());
+        }
+        ImGui::SameLine();
+        ImGui::Text("%zu KB", savedState.GetSize() / 1024);
+        ImGui::End();
+
+        ImGui::Begin("Stress test");
+        ImGui::Checkbox("Stress mode", &stressMode);
+        ImGui::SliderInt("Bodies", &stressTarget, 0, 10000);
+        ImGui::SliderInt("Spawned per frame", &stressSpawnPerFrame, 1, 500);
+        ImGui::Text("Stress bodies: %zu, total %zu", stressBodies.size(), world.GetBodyCount());
+        ImGui::SliderInt("Substeps", &world.substeps, 1, 8);
+        ImGui::SliderFloat("Gravity", &world.gravity.y, -2000.0f, 2000.0f);
+        {
+            float total = 0.0f;
+            float maxFrameTime = 0.0f;
+            for (float frameTime : frameTimes)
             {
-                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+                total += frameTime;
+                maxFrameTime = std::max(maxFrameTime, frameTime);
             }
+            const float average = total / static_cast<float>(frameTimes.size());
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "avg %.2f ms (%.0f fps), max %.2f ms", average,
+                     average > 0.0f ? 1000.0f / average : 0.0f, maxFrameTime);
+            ImGui::PlotLines("Frame", frameTimes.data(), static_cast<int>(frameTimes.size()), static_cast<int>(frameTimeCursor),
+                             overlay, 0.0f, maxFrameTime * 1.2f, ImVec2(0.0f, 80.0f));
+        }
+        ImGui::End();
 
-            if (body->shape->GetType() == Shape::POLYGON)
+        ImGui::Begin("Trajectory");
+        if (!replaying)
+        {
+            if (!recorder.IsOpen() && ImGui::Button("Record"))
             {
-                PolygonShape *poly = static_cast<PolygonShape *>(body->shape.get());
-                std::vector<SDL_Point> sdlPoints;
-                for (const auto &v : poly->worldVertices)
+                TrajectorySettings settings;
+                settings.frameTime = world.fixedTimeStep / static_cast<float>(std::max(world.substeps, 1));
+                if (recorder.Open(trajectoryPath, settings))
                 {
-                    sdlPoints.push_back({(int)v.x, (int)v.y});
+                    world.recorder = &recorder;
+                    trajectoryStatus = "";
                 }
-                if (sdlPoints.size() > 0)
+                else
+                {
+                    trajectoryStatus = "Could not write trajectory.p2dt";
+                }
+            }
+            else if (recorder.IsOpen() && ImGui::Button("Stop recording"))
+            {
+                world.recorder = nullptr;
+                trajectoryStatus = recorder.Close() ? "Saved trajectory.p2dt" : "Could not write trajectory.p2dt";
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Replay"))
+            {
+                if (recorder.IsOpen())
                 {
-                    // --- THIS IS THE CORRECTED LINE ---
-                    // Access the first vertex using the array subscript operator [0]
-                    sdlPoints.push_back({(int)poly->worldVertices[0].x, (int)poly->worldVertices[0].y});
-                    SDL_RenderDrawLines(renderer, sdlPoints.data(), sdlPoints.size());
+                    world.recorder = nullptr;
+                    recorder.Close();
                 }
+                replaying = replay.Open(trajectoryPath) && replay.GetFrameCount() > 0;
+                replayPosition = 0.0f;
+                trajectoryStatus = replaying ? "" : "No recording to replay";
+            }
+            if (recorder.IsOpen())
+            {
+                ImGui::Text("Recording: %llu frames, %llu KB written", static_cast<unsigned long long>(recorder.GetFrameCount()),
+                            static_cast<unsigned long long>(recorder.GetBytesWritten() / 1024));
+            }
+        }
+        else
+        {
+            if (ImGui::Button("Back to live"))
+            {
+                replay.Close();
+                replaying = false;
             }
+            ImGui::SameLine();
+            ImGui::Checkbox("Play", &replayPlaying);
+            int frame = static_cast<int>(replayPosition);
+            if (ImGui::SliderInt("Frame", &frame, 0, static_cast<int>(replay.GetFrameCount()) - 1))
+            {
+                replayPosition = static_cast<float>(frame);
+            }
+            ImGui::Text("Bodies: %zu", replayFrame.GetBodyCount());
         }
+        ImGui::TextUnformatted(trajectoryStatus);
+        ImGui::End();
 
-        // --- ImGui ---
-        ImGui_ImplSDLRenderer2_NewFrame();
-        ImGui_ImplSDL2_NewFrame();
-        ImGui::NewFrame();
-        ImGui::Begin("Info");
-        ImGui::Text("Boxes are spawned periodically.");
-        ImGui::Text("Collision is detected using the Separating Axis Theorem (SAT).");
-        ImGui::Text("Body count: %zu", bodies.size());
+        // Where the time of the last steps went, phase by phase
+        Profiler &profiler = world.GetProfiler();
+        ImGui::Begin("Profiler");
+        ImGui::Checkbox("Record", &profiler.enabled);
+        const size_t frameCount = profiler.GetFrameCount();
+        if (frameCount > 0)
+        {
+            stepTimes.clear();
+            float maxStepTime = 0.0f;
+            for (size_t age = frameCount; age-- > 0;)
+            {
+                stepTimes.push_back(profiler.GetFrame(age).duration / 1e6f);
+                maxStepTime = std::max(maxStepTime, stepTimes.back());
+            }
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "last %.2f ms, max %.2f ms", stepTimes.back(), maxStepTime);
+            ImGui::PlotLines("Step", stepTimes.data(), static_cast<int>(stepTimes.size()), 0, overlay, 0.0f,
+                             maxStepTime * 1.2f, ImVec2(0.0f, 60.0f));
+
+            const ProfileFrame &latest = profiler.GetFrame(0);
+            if (ImGui::BeginTable("Phases", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+            {
+                ImGui::TableSetupColumn("Phase");
+                ImGui::TableSetupColumn("Last ms");
+                ImGui::TableSetupColumn("Average ms");
+                ImGui::TableHeadersRow();
+                for (const ProfileScope &scope : latest.scopes)
+                {
+                    double total = 0.0;
+                    for (size_t age = 0; age < frameCount; ++age)
+                    {
+                        total += profiler.GetFrame(age).GetScopeTime(scope.name);
+                    }
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%*s%s", 2 * scope.depth, "", scope.name); // Nested scopes indented
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", scope.duration / 1e6);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", total / frameCount / 1e6);
+                }
+                ImGui::EndTable();
+            }
+            for (const ProfileCounter &counter : latest.counters)
+            {
+                ImGui::Text("%s: %lld", counter.name, static_cast<long long>(counter.value));
+            }
+        }
+        else
+        {
+            ImGui::Text("No steps recorded yet.");
+        }
+        // Opens in chrome://tracing or ui.perfetto.dev
+        if (ImGui::Button("Export Chrome trace"))
+        {
+            traceStatus = profiler.ExportChromeTrace("step_trace.json") ? "Saved step_trace.json" : "Could not write step_trace.json";
+        }
+        ImGui::SameLine();
+        ImGui::TextUnformatted(traceStatus);
         ImGui::End();
         ImGui::Render();
         ImGui_ImplSDLRenderer2_RenderDrawData(ImGui::GetDrawData(), renderer);
@@ -0,0 +1,6 @@
+#pragma once
+
+// Counts every call to the global operator new in the executable that links
+// AllocationCounter.cpp. Benchmarks read it before and after a run to prove
+// (or measure) how much a step allocates.
+long long GetAllocationCount();
@@ -0,0 +1,162 @@
+// Speed and accuracy of the Barnes-Hut gravity pass.
+//
+// Scatters n particles over a disc, like the nbody_gravity scenario, and
+// compares BarnesHutTree at a few opening angles with the exact pairwise sum
+// of Forces::GenerateGravitationalForce:
+//   build    - sorting the particles and building the tree
+//   forces   - walking the tree for every particle
+//   pairwise - the exact O(n^2) loop the nbody_gravity scenario runs. Above
+//              PAIRWISE_LIMIT particles it is too slow to run and is
+//              extrapolated from the largest size that was run (marked ~)
+// Over a sample of particles, the rms error is the rms of |approximate - exact|
+// relative to the rms of |exact|, and the max error the worst
+// |approximate - exact| / |exact| of a single particle (large for the few
+// particles whose pulls nearly cancel out).
+// A step after the first must not allocate.
+
+#include <BarnesHut.h>
+#include <Forces.h>
+#include <JobSystem.h>
+#include <Particle.h>
+
+#include "AllocationCounter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// --- Benchmark ---
+const float G = 100.0f;
+const size_t SAMPLE_COUNT = 1000;
+const size_t PAIRWISE_LIMIT = 16000;
+const double MAX_RMS_ERROR = 0.02; // At theta = 0.5
+
+double Milliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main()
+{
+    bool ok = true;
+    JobSystem jobSystem;
+    std::printf("threads: %d\n", jobSystem.GetThreadCount());
+    std::printf("%8s %6s %10s %10s %12s %9s %10s %10s\n", "n", "theta", "build ms", "forces ms", "pairwise ms",
+                "speedup", "rms error", "max error");
+
+    double pairwiseNanosecondsPerPair = 0.0;
+    for (size_t n : {1000, 4000, 16000, 64000, 256000})
+    {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        std::uniform_real_distribution<float> distance(10.0f, 500.0f);
+        std::uniform_real_distribution<float> mass(1.0f, 10.0f);
+        std::vector<Particle> particles;
+        std::vector<float> positionX, positionY, inverseMasses;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const float a = angle(random);
+            const float r = distance(random);
+            particles.emplace_back(r * std::cos(a), r * std::sin(a), mass(random));
+            positionX.push_back(particles.back().position.x);
+            positionY.push_back(particles.back().position.y);
+            inverseMasses.push_back(particles.back().inverseMass);
+        }
+
+        // Exact forces on the sample, and the pairwise loop timed when affordable
+        const size_t sampleCount = std::min(n, SAMPLE_COUNT);
+        std::vector<Vec2> exact(sampleCount, Vec2(0.0f, 0.0f));
+        for (size_t s = 0; s < sampleCount; ++s)
+        {
+            for (size_t j = 0; j < n; ++j)
+            {
+                if (j != s)
+                {
+                    exact[s] += Forces::GenerateGravitationalForce(particles[s], particles[j], G);
+                }
+            }
+        }
+        double pairwiseMilliseconds;
+        const bool pairwiseRun = n <= PAIRWISE_LIMIT;
+        if (pairwiseRun)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < n; ++i)
+            {
+                for (size_t j = i + 1; j < n; ++j)
+                {
+                    const Vec2 force = Forces::GenerateGravitationalForce(particles[i], particles[j], G);
+                    particles[i].AddForce(force);
+                    particles[j].AddForce(-force);
+                }
+            }
+            pairwiseMilliseconds = Milliseconds(start, std::chrono::steady_clock::now());
+            pairwiseNanosecondsPerPair = pairwiseMilliseconds * 1e6 / (0.5 * n * (n - 1.0));
+        }
+        else
+        {
+            pairwiseMilliseconds = pairwiseNanosecondsPerPair * 0.5 * n * (n - 1.0) / 1e6;
+        }
+
+        for (float theta : {0.3f, 0.5f, 0.7f})
+        {
+            BarnesHutTree tree;
+            std::vector<float> forceX(n), forceY(n);
+            double buildMilliseconds = 0.0, forceMilliseconds = 0.0;
+            long long allocations = 0;
+            const int runs = 3;
+            for (int run = 0; run < runs; ++run)
+            {
+                std::fill(forceX.begin(), forceX.end(), 0.0f);
+                std::fill(forceY.begin(), forceY.end(), 0.0f);
+                const long long allocationsBefore = GetAllocationCount();
+                const auto start = std::chrono::steady_clock::now();
+                tree.Build(positionX.data(), positionY.data(), inverseMasses.data(), n, jobSystem);
+                const auto built = std::chrono::steady_clock::now();
+                tree.ApplyForces(G, theta, forceX.data(), forceY.data(), jobSystem);
+                const auto end = std::chrono::steady_clock::now();
+                if (run > 0)
+                {
+                    // The first run sizes the buffers
+                    buildMilliseconds += Milliseconds(start, built) / (runs - 1);
+                    forceMilliseconds += Milliseconds(built, end) / (runs - 1);
+                    allocations += GetAllocationCount() - allocationsBefore;
+                }
+            }
+
+            double sumSquaredError = 0.0, sumSquaredForce = 0.0, maxError = 0.0;
+            for (size_t s = 0; s < sampleCount; ++s)
+            {
+                const double error = (Vec2(forceX[s], forceY[s]) - exact[s]).Magnitude();
+                sumSquaredError += error * error;
+                sumSquaredForce += exact[s].MagnitudeSq();
+                maxError = std::max(maxError, error / std::max(exact[s].Magnitude(), 1e-20f));
+            }
+            const double rmsError = std::sqrt(sumSquaredError / sumSquaredForce);
+
+            std::printf("%8zu %6.1f %10.2f %10.2f %c%11.1f %8.1fx %9.4f%% %9.4f%%\n", n, theta, buildMilliseconds,
+                        forceMilliseconds, pairwiseRun ? ' ' : '~', pairwiseMilliseconds,
+                        pairwiseMilliseconds / (buildMilliseconds + forceMilliseconds), 100.0 * rmsError,
+                        100.0 * maxError);
+
+            if (theta == 0.5f && rmsError > MAX_RMS_ERROR)
+            {
+                std::printf("  rms error above %.1f%% at theta 0.5\n", 100.0 * MAX_RMS_ERROR);
+                ok = false;
+            }
+            if (allocations != 0)
+            {
+                std::printf("  %lld allocations after the first step\n", allocations);
+                ok = false;
+            }
+        }
+    }
+
+    std::printf("%s\n", ok ? "OK: within the error budget, no allocations"
+                           : "FAILED: too inaccurate or the tree allocated");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
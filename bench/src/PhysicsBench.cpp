@@ -0,0 +1,253 @@
+// Headless engine benchmark.
+//
+// Runs canned scenarios without a window and reports steps/sec, time per
+// phase and heap allocations as JSON, for regression tracking in CI.
+//
+// Usage: PhysicsBench [--scenario NAME|all] [--size N] [--steps N]
+//                     [--warmup N] [--threads N] [--dt SECONDS]
+//                     [--allocation-threads N] [--output FILE] [--list]
+//
+// Allocations are also counted with the job system running on
+// --allocation-threads threads (4 by default, 0 to skip), in a second,
+// shorter run of each scenario: a step must not allocate just because it
+// runs on several threads.
+
+#include "AllocationCounter.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct BenchOptions
+{
+    std::vector<std::string> scenarios;
+    ScenarioOptions scenario;
+    int steps = 300;
+    int warmupSteps = 30;
+    float dt = 1.0f / 60.0f;
+    int allocationThreads = 4;
+    std::string outputPath;
+};
+
+struct BenchResult
+{
+    std::string name;
+    size_t objectCount = 0;
+    double setupMilliseconds = 0.0;
+    double totalMilliseconds = 0.0;
+    long long setupAllocations = 0;
+    long long stepAllocations = 0;
+    double threadedAllocationsPerStep = -1.0; // Negative when not measured
+    std::uint64_t stateHash = 0;
+    std::vector<PhaseTimer::Phase> phases;
+};
+
+static void PrintUsage()
+{
+    std::fprintf(stderr,
+                 "Usage: PhysicsBench [--scenario NAME|all] [--size N] [--steps N] [--warmup N]\n"
+                 "                    [--threads N] [--dt SECONDS] [--allocation-threads N]\n"
+                 "                    [--output FILE] [--list]\n");
+}
+
+static bool ParseArguments(int argc, char *argv[], BenchOptions &options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--list")
+        {
+            for (const auto &name : GetScenarioNames())
+                std::printf("%s\n", name.c_str());
+            std::exit(EXIT_SUCCESS);
+        }
+
+        if (i + 1 >= argc)
+        {
+            PrintUsage();
+            return false;
+        }
+        const char *value = argv[++i];
+
+        if (arg == "--scenario")
+        {
+            if (std::strcmp(value, "all") == 0)
+                options.scenarios = GetScenarioNames();
+            else
+                options.scenarios.push_back(value);
+        }
+        else if (arg == "--size")
+            options.scenario.size = std::atoi(value);
+        else if (arg == "--threads")
+            options.scenario.threadCount = std::atoi(value);
+        else if (arg == "--steps")
+            options.steps = std::atoi(value);
+        else if (arg == "--warmup")
+            options.warmupSteps = std::atoi(value);
+        else if (arg == "--dt")
+            options.dt = static_cast<float>(std::atof(value));
+        else if (arg == "--allocation-threads")
+            options.allocationThreads = std::atoi(value);
+        else if (arg == "--output")
+            options.outputPath = value;
+        else
+        {
+            PrintUsage();
+            return false;
+        }
+    }
+
+    if (options.scenarios.empty())
+        options.scenarios = GetScenarioNames();
+    return options.steps > 0 && options.scenario.size > 0;
+}
+
+static BenchResult Run(Scenario &scenario, const BenchOptions &options)
+{
+    BenchResult result;
+    result.name = scenario.GetName();
+
+    long long allocations = GetAllocationCount();
+    auto start = std::chrono::steady_clock::now();
+    scenario.Setup(options.scenario);
+    result.setupMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    result.setupAllocations = GetAllocationCount() - allocations;
+    result.objectCount = scenario.GetObjectCount();
+
+    PhaseTimer timer;
+    for (int i = 0; i < options.warmupSteps; ++i)
+    {
+        scenario.Step(options.dt, timer);
+    }
+    timer.Reset();
+
+    allocations = GetAllocationCount();
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.steps; ++i)
+    {
+        scenario.Step(options.dt, timer);
+    }
+    result.totalMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    result.stepAllocations = GetAllocationCount() - allocations;
+    result.phases = timer.GetPhases();
+    result.stateHash = scenario.GetStateHash();
+    return result;
+}
+
+// Steady state allocations per step of a fresh copy of the scenario, run on
+// threadCount threads
+static double CountThreadedAllocations(const std::string &name, const BenchOptions &options, int threadCount)
+{
+    std::unique_ptr<Scenario> scenario = CreateScenario(name);
+    ScenarioOptions scenarioOptions = options.scenario;
+    scenarioOptions.threadCount = threadCount;
+    scenario->Setup(scenarioOptions);
+
+    PhaseTimer timer;
+    for (int i = 0; i < options.warmupSteps; ++i)
+    {
+        scenario->Step(options.dt, timer);
+    }
+    const int steps = std::min(options.steps, 60);
+    const long long allocations = GetAllocationCount();
+    for (int i = 0; i < steps; ++i)
+    {
+        scenario->Step(options.dt, timer);
+    }
+    return static_cast<double>(GetAllocationCount() - allocations) / steps;
+}
+
+static void WriteJson(std::FILE *file, const BenchOptions &options, const std::vector<BenchResult> &results)
+{
+    std::fprintf(file, "{\n");
+    std::fprintf(file, "  \"steps\": %d,\n", options.steps);
+    std::fprintf(file, "  \"warmup_steps\": %d,\n", options.warmupSteps);
+    std::fprintf(file, "  \"dt\": %g,\n", options.dt);
+    std::fprintf(file, "  \"size\": %d,\n", options.scenario.size);
+    std::fprintf(file, "  \"threads\": %d,\n", options.scenario.threadCount);
+    std::fprintf(file, "  \"allocation_threads\": %d,\n", options.allocationThreads);
+    std::fprintf(file, "  \"scenarios\": [\n");
+    for (size_t r = 0; r < results.size(); ++r)
+    {
+        const BenchResult &result = results[r];
+        const double seconds = result.totalMilliseconds / 1000.0;
+        std::fprintf(file, "    {\n");
+        std::fprintf(file, "      \"name\": \"%s\",\n", result.name.c_str());
+        std::fprintf(file, "      \"objects\": %zu,\n", result.objectCount);
+        std::fprintf(file, "      \"setup_ms\": %.3f,\n", result.setupMilliseconds);
+        std::fprintf(file, "      \"setup_allocations\": %lld,\n", result.setupAllocations);
+        std::fprintf(file, "      \"total_ms\": %.3f,\n", result.totalMilliseconds);
+        std::fprintf(file, "      \"steps_per_second\": %.2f,\n", seconds > 0.0 ? options.steps / seconds : 0.0);
+        std::fprintf(file, "      \"ms_per_step\": %.4f,\n", result.totalMilliseconds / options.steps);
+        std::fprintf(file, "      \"allocations\": %lld,\n", result.stepAllocations);
+        std::fprintf(file, "      \"allocations_per_step\": %.2f,\n", static_cast<double>(result.stepAllocations) / options.steps);
+        if (result.threadedAllocationsPerStep >= 0.0)
+        {
+            std::fprintf(file, "      \"allocations_per_step_threaded\": %.2f,\n", result.threadedAllocationsPerStep);
+        }
+        if (result.stateHash != 0)
+        {
+            // With ENGINE_DETERMINISTIC on, the same options give the same
+            // hash with any compiler, on any machine
+            std::fprintf(file, "      \"state_hash\": \"%016llx\",\n", static_cast<unsigned long long>(result.stateHash));
+        }
+        std::fprintf(file, "      \"phases_ms_per_step\": {");
+        for (size_t p = 0; p < result.phases.size(); ++p)
+        {
+            std::fprintf(file, "%s\n        \"%s\": %.4f", p == 0 ? "" : ",", result.phases[p].name.c_str(),
+                         result.phases[p].totalMilliseconds / options.steps);
+        }
+        std::fprintf(file, "\n      }\n");
+        std::fprintf(file, "    }%s\n", r + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n");
+    std::fprintf(file, "}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    BenchOptions options;
+    if (!ParseArguments(argc, argv, options))
+    {
+        return EXIT_FAILURE;
+    }
+
+    std::vector<BenchResult> results;
+    for (const auto &name : options.scenarios)
+    {
+        std::unique_ptr<Scenario> scenario = CreateScenario(name);
+        if (!scenario)
+        {
+            std::fprintf(stderr, "Unknown scenario '%s' (use --list)\n", name.c_str());
+            return EXIT_FAILURE;
+        }
+        std::fprintf(stderr, "Running %s...\n", name.c_str());
+        results.push_back(Run(*scenario, options));
+        if (options.allocationThreads > 1)
+        {
+            results.back().threadedAllocationsPerStep = CountThreadedAllocations(name, options, options.allocationThreads);
+        }
+    }
+
+    std::FILE *file = stdout;
+    if (!options.outputPath.empty())
+    {
+        file = std::fopen(options.outputPath.c_str(), "w");
+        if (!file)
+        {
+            std::fprintf(stderr, "Cannot open '%s' for writing\n", options.outputPath.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+    WriteJson(file, options, results);
+    if (file != stdout)
+    {
+        std::fclose(file);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,799 @@
+#include "Scenarios.h"
+
+#include <CircleShape.h>
+#include <Forces.h>
+#include <Particle.h>
+#include <ParticleSystem.h>
+#include <PolygonShape.h>
+#include <Trajectory.h>
+#include <World.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+
+namespace
+{
+    const float GRAVITY = 980.0f; // Same pixel units as the App
+
+    std::vector<Vec2> BoxVertices(float halfWidth, float halfHeight)
+    {
+        return {{-halfWidth, -halfHeight}, {halfWidth, -halfHeight}, {halfWidth, halfHeight}, {-halfWidth, halfHeight}};
+    }
+
+    // Runs the phases of World::Step one by one so each can be timed
+    void StepWorld(World &world, float dt, PhaseTimer &timer)
+    {
+        timer.Time("integrate", [&]
+                   { world.Integrate(dt); });
+        timer.Time("transform", [&]
+                   {
+            world.UpdateWorldVertices();
+            world.UpdateAABBs(); });
+        timer.Time("broadphase", [&]
+                   { world.FindPairs(); });
+        timer.Time("narrowphase", [&]
+                   { world.DetectCollisions(); });
+        timer.Time("islands", [&]
+                   { world.BuildIslands(); });
+        timer.Time("solve", [&]
+                   { world.ResolveCollisions(dt); });
+        timer.Time("continuous", [&]
+                   { world.SolveContinuous(dt); });
+        timer.Time("sleep", [&]
+                   { world.UpdateSleep(dt); });
+    }
+
+    // A block of alternating boxes and balls above a static floor
+    void CreateCheckerStack(World &world, const ScenarioOptions &options)
+    {
+        world.SetThreadCount(options.threadCount);
+        world.gravity = Vec2(0.0f, GRAVITY);
+
+        const int columns = std::max(1, static_cast<int>(std::sqrt(static_cast<float>(options.size))));
+        const int rows = std::max(1, options.size / columns);
+        const float spacing = 24.0f;
+        const float width = columns * spacing;
+        world.CreateBody(PolygonShape(BoxVertices(width / 2.0f + 100.0f, 15.0f), 0.0f), width / 2.0f, 0.0f);
+
+        const PolygonShape box(BoxVertices(10.0f, 10.0f), 5.0f);
+        const CircleShape ball(10.0f, 5.0f);
+        for (int row = 0; row < rows; ++row)
+        {
+            for (int column = 0; column < columns; ++column)
+            {
+                const float x = column * spacing + spacing / 2.0f;
+                const float y = -40.0f - row * spacing;
+                if ((row + column) % 2 == 0)
+                    world.CreateBody(box, x, y);
+                else
+                    world.CreateBody(ball, x, y);
+            }
+        }
+    }
+
+    // Boxes stacked in a pyramid on a static floor
+    class BoxPyramid : public Scenario
+    {
+    public:
+        const char *GetName() const override { return "box_pyramid"; }
+
+        void Setup(const ScenarioOptions &options) override
+        {
+            world.SetThreadCount(options.threadCount);
+            world.gravity = Vec2(0.0f, GRAVITY);
+
+            // rows * (rows + 1) / 2 boxes
+            int rows = 1;
+            while ((rows + 1) * (rows + 2) / 2 <= options.size)
+                ++rows;
+
+            const float halfSize = 10.0f;
+            const float spacing = 2.0f * halfSize + 1.0f;
+            const float floorWidth = rows * spacing + 200.0f;
+            const float floorY = 0.0f;
+            world.CreateBody(PolygonShape(BoxVertices(floorWidth / 2.0f, 15.0f), 0.0f), 0.0f, floorY);
+
+            const PolygonShape box(BoxVertices(halfSize, halfSize), 5.0f);
+            for (int row = 0; row < rows; ++row)
+            {
+                const int count = rows - row;
+                const float y = floorY - 15.0f - halfSize - row * spacing;
+                for (int i = 0; i < count; ++i)
+                {
+                    const float x = (i - (count - 1) / 2.0f) * spacing;
+                    world.CreateBody(box, x, y);
+                }
+            }
+        }
+
+        void Step(float dt, PhaseTimer &timer) override { StepWorld(world, dt, timer); }
+        size_t GetObjectCount() const override { return world.GetBodyCount(); }
+        std::uint64_t GetStateHash() const override { return world.ComputeStateHash(); }
+
+    private:
+        World world;
+    };
+
+    // Many short, separate stacks on one static floor: an island each, all
+    // touching the floor. Sleeping is off so every island is solved every
+    // step, in parallel, while sharing the floor (run it with --threads
+    // under ThreadSanitizer to check the solver never writes the floor).
+    class IslandStacks : public Scenario
+    {
+    public:
+        const char *GetName() const override { return "island_stacks"; }
+
+        void Setup(const ScenarioOptions &options) override
+        {
+            world.SetThreadCount(options.threadCount);
+            world.gravity = Vec2(0.0f, GRAVITY);
+            world.allowSleep = false;
+
+            const int height = 4;
+            const int stacks = std::max(1, options.size / height);
+            const float halfSize = 10.0f;
+            const float gap = 30.0f;
+            const float width = stacks * (2.0f * halfSize + gap);
+            world.CreateBody(PolygonShape(BoxVertices(width / 2.0f + 100.0f, 15.0f), 0.0f), width / 2.0f, 0.0f);
+
+            const PolygonShape box(BoxVertices(halfSize, halfSize), 5.0f);
+            for (int stack = 0; stack < stacks; ++stack)
+            {
+                const float x = stack * (2.0f * halfSize + gap) + halfSize;
+                for (int level = 0; level < height; ++level)
+                {
+                    world.CreateBody(box, x, -15.0f - halfSize - level * (2.0f * halfSize + 1.0f));
+                }
+            }
+        }
+
+        void Step(float dt, PhaseTimer &timer) override { StepWorld(world, dt, timer); }
+        size_t GetObjectCount() const override { return world.GetBodyCount(); }
+        std::uint64_t GetStateHash() const override { return world.ComputeStateHash(); }
+
+    private:
+        World world;
+    };
+
+    // Circles dropped onto a bed of static circles
+    class CirclePile : public Scenario
+    {
+    public:
+        const char *GetName() const override { return "circle_pile"; }
+
+        void Setup(const ScenarioOptions &options) override
+        {
+            world.SetThreadCount(options.threadCount);
+            world.gravity = Vec2(0.0f, GRAVITY);
+
+            const int columns = std::max(1, static_cast<int>(std::sqrt(static_cast<float>(options.size))));
+            const int rows = std::max(1, options.size / columns);
+            const float radius = 8.0f;
+            const float spacing = 2.0f * radius + 2.0f;
+            const float width = columns * spacing;
+
+            // The bed
+            const float bedRadius = 20.0f;
+            for (float x = -bedRadius; x <= width + bedRadius; x += bedRadius)
+            {
+                world.CreateBody(CircleShape(bedRadius, 0.0f), x, 0.0f);
+            }
+
+            std::mt19937 random(1);
+            std::uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+            for (int row = 0; row < rows; ++row)
+            {
+                for (int column = 0; column < columns; ++column)
+                {
+                    world.CreateBody(CircleShape(radius, 1.0f),
+                                     column * spacing + radius + jitter(random),
+                                     -bedRadius - radius - row * spacing);
+                }
+            }
+        }
+
+        void Step(float dt, PhaseTimer &timer) override { StepWorld(world, dt, timer); }
+        size_t GetObjectCount() const override { return world.GetBodyCount(); }
+        std::uint64_t GetStateHash() const override { return world.ComputeStateHash(); }
+
+    private:
+        World world;
+    };
+
+    // Small circles flagged as bullets, fired at a thin floor far faster than
+    // it is thick per step, among a few plain boxes
+    class BulletHail : public Scenario
+    {
+    public:
+        const char *GetName() const override { return "bullet_hail"; }
+
+        void Setup(const ScenarioOptions &options) override
+        {
+            world.SetThreadCount(options.threadCount);
+            world.gravity = Vec2(0.0f, GRAVITY);
+
+            const int columns = std::max(1, static_cast<int>(std::sqrt(static_cast<float>(options.size))));
+            const int rows = std::max(1, options.size / columns);
+            const float radius = 3.0f;
+            const float spacing = 20.0f;
+            const float width = columns * spacing;
+            world.CreateBody(PolygonShape(BoxVertices(width / 2.0f + 100.0f, 5.0f), 0.0f), width / 2.0f, 0.0f);
+
+            const PolygonShape box(BoxVertices(8.0f, 8.0f), 5.0f);
+            for (float x = 0.0f; x < width; x += 10.0f * spacing)
+            {
+                world.CreateBody(box, x, -13.0f);
+            }
+
+            std::mt19937 random(1);
+            std::uniform_real_distribution<float> speed(2000.0f, 6000.0f);
+            for (int row = 0; row < rows; ++row)
+            {
+                for (int column = 0; column < columns; ++column)
+                {
+                    const BodyHandle handle = world.CreateBody(CircleShape(radius, 1.0f), column * spacing + radius,
+                                                               -100.0f - row * spacing);
+                    BodyRef bullet = world.GetBody(handle);
+                    bullet.SetVelocity(Vec2(0.0f, speed(random)));
+                    bullet.SetBullet(true);
+                }
+            }
+        }
+
+        void Step(float dt, PhaseTimer &timer) override { StepWorld(world, dt, timer); }
+        size_t GetObjectCount() const override { return world.GetBodyCount(); }
+        std::uint64_t GetStateHash() const override { return world.ComputeStateHash(); }
+
+    private:
+        World world;
+    };
+
+    // Boxes and circles rain onto a floor narrower than the shower: those that
+    // fall off its ends are destroyed and new ones created at the top, every
+    // step. Once the pools have warmed up, the churn does not allocate.
+    class BodyChurn : public Scenario
+    {
+    public:
+        const char *GetName() const override { return "body_churn"; }
+
+        void Setup(const ScenarioOptions &options) override
+        {
+            world.SetThreadCount(options.threadCount);
+            world.gravity = Vec2(0.0f, GRAVITY);
+            world.Reserve(options.size + 1);
+            fallen.reserve(options.size);
+
+            width = 40.0f * std::sqrt(static_cast<float>(options.size));
+            world.CreateBody(PolygonShape(BoxVertices(width / 4.0f, 15.0f), 0.0f), width / 2.0f, 0.0f);
+            for (int i = 0; i < options.size; ++i)
+            {
+                Spawn(i, -100.0f - 40.0f * (i / 10));
+            }
+        }
+
+        void Step(float dt, PhaseTimer &timer) override
+        {
+            StepWorld(world, dt, timer);
+            timer.Time("churn", [&]
+                       {
+                fallen.clear();
+                for (size_t i = 0; i < world.GetBodyCount(); ++i)
+                {
+                    if (world.positionY[i] > 1000.0f)
+                    {
+                        fallen.push_back(world.GetHandle(i));
+                    }
+                }
+                for (const BodyHandle handle : fallen)
+                {
+                    world.DestroyBody(handle);
+                    Spawn(spawned, -500.0f);
+                } });
+        }
+
+        size_t GetObjectCount() const override { return world.GetBodyCount(); }
+        std::uint64_t GetStateHash() const override { return world.ComputeStateHash(); }
+
+    private:
+        // Every body shares one of these two shapes; the World copies them
+        // into its pools
+        void Spawn(int count, float y)
+        {
+            std::uniform_real_distribution<float> x(0.0f, width);
+            if (count % 2 == 0)
+                world.CreateBody(box, x(random), y);
+            else
+                world.CreateBody(ball, x(random), y);
+            spawned = count + 1;
+        }
+
+        World world;
+        const PolygonShape box = PolygonShape(BoxVertices(10.0f, 10.0f), 5.0f);
+        const CircleShape ball = CircleShape(10.0f, 5.0f);
+        float width = 0.0f;
+        int spawned = 0;
+        std::vector<BodyHandle> fallen;
+        std::mt19937 random{1};
+    };
+
+    // A rollback netcode client: every step saves the world, steps it, then
+    // rolls back to the snapshot and steps again, as if a late input had
+    // arrived. The save and restore phases are the cost of the rollback.
+    class Rollback : public Scenario
+    {
+    public:
+        const char *GetName() const override { return "rollback"; }
+
+        void Setup(const ScenarioOptions &options) override { CreateCheckerStack(world, options); }
+
+        void Step(float dt, PhaseTimer &timer) override
+        {
+            timer.Time("save", [&]
+                       { world.Save(snapshot); });
+            StepWorld(world, dt, timer);
+            timer.Time("restore", [&]
+                       { world.Restore(SnapshotReader(snapshot)); });
+            StepWorld(world, dt, timer);
+        }
+
+        size_t GetObjectCount() const override { return world.GetBodyCount(); }
+        std::uint64_t GetStateHash() const override { return world.ComputeStateHash(); }
+
+    private:
+        World world;
+        Snapshot snapshot;
+    };
+
+    // Every step is streamed to a trajectory file in the temp directory. The
+    // record phase is what the step loop pays; compressing and writing
+    // happen on the recorder's thread.
+    class TrajectoryRecording : public Scenario
+    {
+    public:
+        ~TrajectoryRecording() override
+        {
+            recorder.Close();
+            std::remove(path.c_str());
+        }
+
+        const char *GetName() const override { return "trajectory_recording"; }
+
+        void Setup(const ScenarioOptions &options) override
+        {
+            CreateCheckerStack(world, options);
+            path = (std::filesystem::temp_directory_path() / "physics_bench_trajectory.p2dt").string();
+            recorder.Open(path.c_str());
+        }
+
+        void Step(float dt, PhaseTimer &timer) override
+        {
+            StepWorld(world, dt, timer);
+            timer.Time("record", [&]
+                       { recorder.Record(world); });
+        }
+
+        size_t GetObjectCount() const override { return world.GetBodyCount(); }
+        std::uint64_t GetStateHash() const override { return world.ComputeStateHash(); }
+
+    private:
+        World world;
+        TrajectoryRecorder recorder;
+        std::string path;
+    };
+
+    // Particles falling under weight and drag, recycled at the top when they
+    // hit the ground
+    class ParticleRain : public Scenario
+    {
+    public:
+        const char *GetName() const override { return "particle_rain"; }
+
+        void Setup(const ScenarioOptions &options) override
+        {
+            std::uniform_real_distribution<float> x(0.0f, WIDTH);
+            std::uniform_real_distribution<float> y(0.0f, HEIGHT);
+            for (int i = 0; i < options.size; ++i)
+            {
+                particles.emplace_back(x(random), y(random), 1.0f);
+            }
+        }
+
+        void Step(float dt, PhaseTimer &timer) override
+        {
+            timer.Time("forces", [&]
+                       {
+                for (auto &particle : particles)
+                {
+                    particle.AddForce(Forces::GenerateWeightForce(particle, GRAVITY));
+                    particle.AddForce(Forces::GenerateDragForce(particle, 0.001f));
+                } });
+            timer.Time("integrate", [&]
+                       {
+                for (auto &particle : particles)
+                {
+                    particle.Integrate(dt);
+                } });
+            timer.Time("recycle", [&]
+                       {
+                std::uniform_real_distribution<float> x(0.0f, WIDTH);
+                for (auto &particle : particles)
+                {
+                    if (particle.position.y > HEIGHT)
+                    {
+                        particle.position = Vec2(x(random), 0.0f);
+                        particle.velocity = Vec2(0.0f, 0.0f);
+                    }
+                } });
+        }
+
+        size_t GetObjectCount() const override { return particles.size(); }
+
+    private:
+        static constexpr float WIDTH = 1280.0f;
+        static constexpr float HEIGHT = 720.0f;
+
+        std::vector<Particle> particles;
+        std::mt19937 random{1};
+    };
+
+    // The same rain through a ParticleSystem: batched weight and drag, and
+    // particles that hit the ground are killed and respawned at the top
+    // through the free list
+    class ParticleRainBatched : public Scenario
+    {
+    public:
+        const char *GetName() const override { return "particle_rain_batched"; }
+
+        void Setup(const ScenarioOptions &options) override
+        {
+            system.SetThreadCount(options.threadCount);
+            system.gravity = Vec2(0.0f, GRAVITY);
+            system.drag = 0.001f;
+            system.Reserve(options.size);
+
+            std::uniform_real_distribution<float> x(0.0f, WIDTH);
+            std::uniform_real_distribution<float> y(0.0f, HEIGHT);
+            for (int i = 0; i < options.size; ++i)
+            {
+                system.Spawn(Vec2(x(random), y(random)), Vec2(0.0f, 0.0f), 1.0f);
+            }
+        }
+
+        void Step(float dt, PhaseTimer &timer) override
+        {
+            timer.Time("forces", [&]
+                       { system.ApplyForces(); });
+            timer.Time("integrate", [&]
+                       { system.Integrate(dt); });
+            timer.Time("recycle", [&]
+                       {
+                int landed = 0;
+                for (size_t i = 0; i < system.GetCapacity(); ++i)
+                {
+                    if (system.positionY[i] > HEIGHT && system.IsAlive(static_cast<std::uint32_t>(i)))
+                    {
+                        system.Kill(static_cast<std::uint32_t>(i));
+                        ++landed;
+                    }
+                }
+                std::uniform_real_distribution<float> x(0.0f, WIDTH);
+                for (int i = 0; i < landed; ++i)
+                {
+                    system.Spawn(Vec2(x(random), 0.0f), Vec2(0.0f, 0.0f), 1.0f);
+                } });
+        }
+
+        size_t GetObjectCount() const override { return system.GetParticleCount(); }
+        std::uint64_t GetStateHash() const override { return system.ComputeStateHash(); }
+
+    private:
+        static constexpr float WIDTH = 1280.0f;
+        static constexpr float HEIGHT = 720.0f;
+
+        ParticleSystem system;
+        std::mt19937 random{1};
+    };
+
+    // A square cloth of particles joined by springs, hanging from its top row
+    class SpringCloth : public Scenario
+    {
+    public:
+        const char *GetName() const override { return "spring_cloth"; }
+
+        void Setup(const ScenarioOptions &options) override
+        {
+            side = std::max(2, static_cast<int>(std::sqrt(static_cast<float>(options.size))));
+            for (int row = 0; row < side; ++row)
+            {
+                for (int column = 0; column < side; ++column)
+                {
+                    // The top row has no mass, so it stays pinned
+                    particles.emplace_back(column * REST_LENGTH, row * REST_LENGTH, row == 0 ? 0.0f : 1.0f);
+                }
+            }
+        }
+
+        void Step(float dt, PhaseTimer &timer) override
+        {
+            timer.Time("forces", [&]
+                       {
+                for (auto &particle : particles)
+                {
+                    particle.AddForce(Forces::GenerateWeightForce(particle, GRAVITY));
+                    particle.AddForce(Forces::GenerateDragForce(particle, 0.002f));
+                } });
+            timer.Time("springs", [&]
+                       {
+                for (int row = 0; row < side; ++row)
+                {
+                    for (int column = 0; column < side; ++column)
+                    {
+                        Particle &p = particles[row * side + column];
+                        if (column + 1 < side)
+                            ApplySpring(p, particles[row * side + column + 1]);
+                        if (row + 1 < side)
+                            ApplySpring(p, particles[(row + 1) * side + column]);
+                    }
+                } });
+            timer.Time("integrate", [&]
+                       {
+                for (auto &particle : particles)
+                {
+                    particle.Integrate(dt);
+                } });
+        }
+
+        size_t GetObjectCount() const override { return particles.size(); }
+
+    private:
+        static constexpr float REST_LENGTH = 10.0f;
+        static constexpr float STIFFNESS = 300.0f;
+
+        static void ApplySpring(Particle &a, Particle &b)
+        {
+            const Vec2 force = Forces::GenerateSpringForce(a, b, REST_LENGTH, STIFFNESS);
+            a.AddForce(force);
+            b.AddForce(-force);
+        }
+
+        int side = 0;
+        std::vector<Particle> particles;
+    };
+
+    // The same cloth in a ParticleSystem, its links either batched springs
+    // of the same stiffness or rigid XPBD constraints
+    class LinkedCloth : public Scenario
+    {
+    public:
+        explicit LinkedCloth(ConstraintNetwork::Solver solver) : solver(solver) {}
+
+        const char *GetName() const override
+        {
+            return solver == ConstraintNetwork::Solver::XPBD ? "cloth_xpbd" : "cloth_springs";
+        }
+
+        void Setup(const ScenarioOptions &options) override
+        {
+            system.SetThreadCount(options.threadCount);
+            system.gravity = Vec2(0.0f, GRAVITY);
+            system.drag = 0.002f;
+            system.links.solver = solver;
+            const float stiffness = solver == ConstraintNetwork::Solver::XPBD ? ConstraintNetwork::rigid : STIFFNESS;
+
+            const int side = std::max(2, static_cast<int>(std::sqrt(static_cast<float>(options.size))));
+            for (int row = 0; row < side; ++row)
+            {
+                for (int column = 0; column < side; ++column)
+                {
+                    system.Spawn(Vec2(column * REST_LENGTH, row * REST_LENGTH), Vec2(0.0f, 0.0f), row == 0 ? 0.0f : 1.0f);
+                }
+            }
+            for (int row = 0; row < side; ++row)
+            {
+                for (int column = 0; column < side; ++column)
+                {
+                    const std::uint32_t index = row * side + column;
+                    if (column + 1 < side)
+                        system.AddSpring(index, index + 1, REST_LENGTH, stiffness);
+                    if (row + 1 < side)
+                        system.AddSpring(index, index + side, REST_LENGTH, stiffness);
+                }
+            }
+        }
+
+        void Step(float dt, PhaseTimer &timer) override
+        {
+            timer.Time("forces", [&]
+                       {
+                system.ApplyForces();
+                system.ApplySprings(); });
+            timer.Time("integrate", [&]
+                       { system.Integrate(dt); });
+        }
+
+        size_t GetObjectCount() const override { return system.GetParticleCount(); }
+        std::uint64_t GetStateHash() const override { return system.ComputeStateHash(); }
+
+    protected:
+        static constexpr float REST_LENGTH = 10.0f;
+        static constexpr float STIFFNESS = 300.0f;
+
+        ConstraintNetwork::Solver solver;
+        ParticleSystem system;
+    };
+
+    // The XPBD cloth rolled back every step, like Rollback. The first
+    // snapshot is taken before the cloth is ever stepped, while its links are
+    // not coloured yet; a snapshot that does not restore stops the bench.
+    class ClothRollback : public LinkedCloth
+    {
+    public:
+        ClothRollback() : LinkedCloth(ConstraintNetwork::Solver::XPBD) {}
+
+        const char *GetName() const override { return "cloth_rollback"; }
+
+        void Setup(const ScenarioOptions &options) override
+        {
+            LinkedCloth::Setup(options);
+            system.Save(snapshot);
+            Restore();
+        }
+
+        void Step(float dt, PhaseTimer &timer) override
+        {
+            timer.Time("save", [&]
+                       { system.Save(snapshot); });
+            LinkedCloth::Step(dt, timer);
+            timer.Time("restore", [&]
+                       { Restore(); });
+            LinkedCloth::Step(dt, timer);
+        }
+
+    private:
+        void Restore()
+        {
+            if (!system.Restore(SnapshotReader(snapshot)))
+            {
+                std::fprintf(stderr, "cloth_rollback: the snapshot did not restore\n");
+                std::exit(1);
+            }
+        }
+
+        Snapshot snapshot;
+    };
+
+    // Particles attracting each other, every pair
+    class NBodyGravity : public Scenario
+    {
+    public:
+        const char *GetName() const override { return "nbody_gravity"; }
+
+        void Setup(const ScenarioOptions &options) override
+        {
+            std::mt19937 random(1);
+            std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+            std::uniform_real_distribution<float> distance(10.0f, 500.0f);
+            std::uniform_real_distribution<float> mass(1.0f, 10.0f);
+            for (int i = 0; i < options.size; ++i)
+            {
+                const float a = angle(random);
+                const float r = distance(random);
+                particles.emplace_back(r * std::cos(a), r * std::sin(a), mass(random));
+            }
+        }
+
+        void Step(float dt, PhaseTimer &timer) override
+        {
+            timer.Time("gravity", [&]
+                       {
+                for (size_t i = 0; i < particles.size(); ++i)
+                {
+                    for (size_t j = i + 1; j < particles.size(); ++j)
+                    {
+                        const Vec2 force = Forces::GenerateGravitationalForce(particles[i], particles[j], G);
+                        particles[i].AddForce(force);
+                        particles[j].AddForce(-force);
+                    }
+                } });
+            timer.Time("integrate", [&]
+                       {
+                for (auto &particle : particles)
+                {
+                    particle.Integrate(dt);
+                } });
+        }
+
+        size_t GetObjectCount() const override { return particles.size(); }
+
+    private:
+        static constexpr float G = 100.0f;
+
+        std::vector<Particle> particles;
+    };
+
+    // The same particles attracting each other through a Barnes-Hut tree
+    class NBodyBarnesHut : public Scenario
+    {
+    public:
+        const char *GetName() const override { return "nbody_barnes_hut"; }
+
+        void Setup(const ScenarioOptions &options) override
+        {
+            system.SetThreadCount(options.threadCount);
+            system.gravity = Vec2(0.0f, 0.0f);
+            system.gravitationalConstant = G;
+            system.openingAngle = 0.5f;
+
+            std::mt19937 random(1);
+            std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+            std::uniform_real_distribution<float> distance(10.0f, 500.0f);
+            std::uniform_real_distribution<float> mass(1.0f, 10.0f);
+            for (int i = 0; i < options.size; ++i)
+            {
+                const float a = angle(random);
+                const float r = distance(random);
+                system.Spawn(Vec2(r * std::cos(a), r * std::sin(a)), Vec2(0.0f, 0.0f), mass(random));
+            }
+        }
+
+        void Step(float dt, PhaseTimer &timer) override
+        {
+            timer.Time("gravity", [&]
+                       { system.ApplyAttraction(); });
+            timer.Time("integrate", [&]
+                       { system.Integrate(dt); });
+        }
+
+        size_t GetObjectCount() const override { return system.GetParticleCount(); }
+        std::uint64_t GetStateHash() const override { return system.ComputeStateHash(); }
+
+    private:
+        static constexpr float G = 100.0f;
+
+        ParticleSystem system;
+    };
+}
+
+std::vector<std::string> GetScenarioNames()
+{
+    return {"box_pyramid", "island_stacks", "particle_rain", "particle_rain_batched", "circle_pile", "bullet_hail", "body_churn", "rollback", "trajectory_recording", "spring_cloth", "cloth_springs", "cloth_xpbd", "cloth_rollback", "nbody_gravity", "nbody_barnes_hut"};
+}
+
+std::unique_ptr<Scenario> CreateScenario(const std::string &name)
+{
+    if (name == "box_pyramid")
+        return std::make_unique<BoxPyramid>();
+    if (name == "island_stacks")
+        return std::make_unique<IslandStacks>();
+    if (name == "particle_rain")
+        return std::make_unique<ParticleRain>();
+    if (name == "particle_rain_batched")
+        return std::make_unique<ParticleRainBatched>();
+    if (name == "circle_pile")
+        return std::make_unique<CirclePile>();
+    if (name == "bullet_hail")
+        return std::make_unique<BulletHail>();
+    if (name == "body_churn")
+        return std::make_unique<BodyChurn>();
+    if (name == "rollback")
+        return std::make_unique<Rollback>();
+    if (name == "trajectory_recording")
+        return std::make_unique<TrajectoryRecording>();
+    if (name == "spring_cloth")
+        return std::make_unique<SpringCloth>();
+    if (name == "cloth_springs")
+        return std::make_unique<LinkedCloth>(ConstraintNetwork::Solver::Springs);
+    if (name == "cloth_xpbd")
+        return std::make_unique<LinkedCloth>(ConstraintNetwork::Solver::XPBD);
+    if (name == "cloth_rollback")
+        return std::make_unique<ClothRollback>();
+    if (name == "nbody_gravity")
+        return std::make_unique<NBodyGravity>();
+    if (name == "nbody_barnes_hut")
+        return std::make_unique<NBodyBarnesHut>();
+    return nullptr;
+}
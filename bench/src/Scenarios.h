@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Accumulates wall-clock time per named phase of a step
+class PhaseTimer
+{
+public:
+    struct Phase
+    {
+        std::string name;
+        double totalMilliseconds = 0.0;
+    };
+
+    template <typename Fn>
+    void Time(const char *name, Fn &&fn)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const auto end = std::chrono::steady_clock::now();
+        Find(name).totalMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    void Reset() { phases.clear(); }
+    const std::vector<Phase> &GetPhases() const { return phases; }
+
+private:
+    Phase &Find(const char *name)
+    {
+        for (auto &phase : phases)
+        {
+            if (phase.name == name)
+                return phase;
+        }
+        phases.push_back({name, 0.0});
+        return phases.back();
+    }
+
+    std::vector<Phase> phases;
+};
+
+struct ScenarioOptions
+{
+    int size = 1000;    // Rough number of objects in the scene
+    int threadCount = 1;
+};
+
+// A canned scene that can be stepped headless
+class Scenario
+{
+public:
+    virtual ~Scenario() = default;
+
+    virtual const char *GetName() const = 0;
+    virtual void Setup(const ScenarioOptions &options) = 0;
+    virtual void Step(float dt, PhaseTimer &timer) = 0;
+
+    // Number of simulated objects (bodies or particles) after Setup
+    virtual size_t GetObjectCount() const = 0;
+
+    // Hash of the simulation state (see World::ComputeStateHash), to compare
+    // runs across builds and machines. 0 for the scenes without one.
+    virtual std::uint64_t GetStateHash() const { return 0; }
+};
+
+std::vector<std::string> GetScenarioNames();
+std::unique_ptr<Scenario> CreateScenario(const std::string &name);
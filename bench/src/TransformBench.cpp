@@ -0,0 +1,110 @@
+// Microbenchmark for the world-space vertex transform pass.
+//
+// Runs the transform pass of both the Body API and the World over rotating
+// and resting boxes, and counts every heap allocation made while stepping.
+// The pass must not allocate at all once the bodies exist.
+
+#include <Body.h>
+#include <PolygonShape.h>
+#include <World.h>
+
+#include "AllocationCounter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+// --- Benchmark ---
+const int BOX_COUNT = 20000;
+const int STEP_COUNT = 200;
+const float TIME_PER_STEP = 1.0f / 60.0f;
+
+struct Result
+{
+    double microsecondsPerStep;
+    long long allocations; // Over all measured steps
+};
+
+template <typename Fn>
+Result Measure(Fn &&step)
+{
+    step(); // Warm up
+    const long long allocationsBefore = GetAllocationCount();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < STEP_COUNT; ++i)
+    {
+        step();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    const long long allocations = GetAllocationCount() - allocationsBefore;
+
+    Result result;
+    result.microsecondsPerStep = std::chrono::duration<double, std::micro>(end - start).count() / STEP_COUNT;
+    result.allocations = allocations;
+    return result;
+}
+
+std::vector<Vec2> BoxVertices(float halfSize)
+{
+    return {{-halfSize, -halfSize}, {halfSize, -halfSize}, {halfSize, halfSize}, {-halfSize, halfSize}};
+}
+
+int main()
+{
+    bool ok = true;
+
+    // 1. Body API: half of the boxes spin, half rest
+    {
+        // Every copy of box shares its geometry
+        const PolygonShape box(BoxVertices(10.0f), 5.0f);
+        std::vector<std::unique_ptr<Body>> bodies;
+        for (int i = 0; i < BOX_COUNT; ++i)
+        {
+            bodies.push_back(std::make_unique<Body>(box, i * 1.0f, 0.0f));
+            if (i % 2 == 0)
+                bodies.back()->angularVelocity = 1.0f;
+        }
+
+        const Result result = Measure([&]
+                                      {
+            for (auto &body : bodies)
+            {
+                body->angle += body->angularVelocity * TIME_PER_STEP;
+                body->UpdateWorldVertices();
+            } });
+        std::printf("Body::UpdateWorldVertices   %8.1f us/step  %lld allocations\n",
+                    result.microsecondsPerStep, result.allocations);
+        ok = ok && result.allocations == 0;
+    }
+
+    // 2. World: all boxes moving vs. all boxes resting
+    {
+        World world;
+        world.SetThreadCount(1);
+        for (int i = 0; i < BOX_COUNT; ++i)
+        {
+            BodyRef body = world.GetBody(world.CreateBody(PolygonShape(BoxVertices(10.0f), 5.0f), i * 1.0f, 0.0f));
+            body.SetAngularVelocity(1.0f);
+        }
+
+        const Result moving = Measure([&]
+                                      {
+            for (size_t i = 0; i < world.GetBodyCount(); ++i)
+                world.angles[i] += world.angularVelocities[i] * TIME_PER_STEP;
+            world.UpdateWorldVertices(); });
+        std::printf("World::UpdateWorldVertices  %8.1f us/step  %lld allocations  (all moving)\n",
+                    moving.microsecondsPerStep, moving.allocations);
+
+        const Result resting = Measure([&]
+                                       { world.UpdateWorldVertices(); });
+        std::printf("World::UpdateWorldVertices  %8.1f us/step  %lld allocations  (all resting)\n",
+                    resting.microsecondsPerStep, resting.allocations);
+
+        ok = ok && moving.allocations == 0 && resting.allocations == 0;
+    }
+
+    std::printf("%s\n", ok ? "OK: the transform pass does not allocate" : "FAILED: the transform pass allocated");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Vec2.h>
+#include <algorithm>
+
+// Axis-Aligned Bounding Box.
+// The cheapest possible bounding volume: two boxes overlap only if their
+// intervals overlap on both the x and the y axis. The broadphase uses these
+// to throw away pairs of bodies that cannot possibly be touching.
+struct AABB
+{
+    Vec2 min;
+    Vec2 max;
+
+    AABB() = default;
+    AABB(const Vec2 &min, const Vec2 &max) : min(min), max(max) {}
+
+    bool Overlaps(const AABB &other) const
+    {
+        return !(max.x < other.min.x || other.max.x < min.x ||
+                 max.y < other.min.y || other.max.y < min.y);
+    }
+
+    bool Contains(const AABB &other) const
+    {
+        return min.x <= other.min.x && min.y <= other.min.y &&
+               other.max.x <= max.x && other.max.y <= max.y;
+    }
+
+    Vec2 Center() const { return (min + max) * 0.5f; }
+    Vec2 Extents() const { return (max - min) * 0.5f; }
+
+    // Used as the cost of a box when comparing the "size" of two boxes
+    float Perimeter() const { return 2.0f * ((max.x - min.x) + (max.y - min.y)); }
+
+    // Return a copy grown by margin on every side
+    AABB Fattened(float margin) const
+    {
+        return AABB(Vec2(min.x - margin, min.y - margin), Vec2(max.x + margin, max.y + margin));
+    }
+
+    static AABB Combine(const AABB &a, const AABB &b)
+    {
+        return AABB(Vec2(std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y)),
+                    Vec2(std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y)));
+    }
+};
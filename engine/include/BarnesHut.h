@@ -0,0 +1,84 @@
+#pragma once
+
+#include <JobSystem.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Gravitational attraction between many particles in O(n log n), by the
+// Barnes-Hut approximation.
+//
+// A quadtree is built over the particles each step and every cell stores the
+// total mass and the centre of mass of the particles inside it. Seen from far
+// enough away, a whole cell pulls like one particle of that mass at that
+// centre: a cell of size s at distance d is treated that way when
+// s / d < theta (the opening angle). Smaller angles open more cells and get
+// closer to the exact pairwise sum; 0 opens every cell and is exact. Keep it
+// under 1 / sqrt(2), or a particle may be lumped in with its own cell and
+// pull on itself.
+//
+// The force law is the one of Forces::GenerateGravitationalForce, softened
+// the same way (squared distances below 1 count as 1). Particles with an
+// inverse mass of 0 neither attract nor get attracted.
+//
+// The tree is stored flat, in depth-first order: a cell's children follow it
+// directly, and each cell knows where the next cell after its subtree is.
+// Walking it needs no stack and no pointers, just an index that either steps
+// into a cell or skips over it.
+class BarnesHutTree
+{
+public:
+    // Particles per leaf cell, at most (unless they all sit at the same spot)
+    int leafCapacity = 8;
+
+    // Sorts the particles along a Morton (Z-order) curve and builds the
+    // tree. The subtrees below the second level are built in parallel.
+    void Build(const float *positionX, const float *positionY, const float *inverseMasses, size_t count,
+               JobSystem &jobSystem);
+
+    // Adds the attraction of every other particle to the force of each
+    // particle, for the particles given to the last Build
+    void ApplyForces(float gravitationalConstant, float theta, float *forceX, float *forceY,
+                     JobSystem &jobSystem) const;
+
+    size_t GetNodeCount() const { return nodes.size(); }
+    size_t GetParticleCount() const { return order.size(); }
+
+private:
+    struct Node
+    {
+        float x, y;         // Centre of mass
+        float mass;
+        float size;         // Width of the square cell
+        std::uint32_t next; // First node after this one's subtree
+        std::uint32_t begin, end; // Particles inside, as a range of the sorted arrays
+        bool leaf;
+    };
+
+    // A subtree below the parallel split level, built on its own
+    struct Subtree
+    {
+        std::uint32_t begin, end;
+        std::vector<Node> nodes;
+    };
+
+    void BuildNode(std::uint32_t begin, std::uint32_t end, int level, std::vector<Node> &out) const;
+    void BuildTop(std::uint32_t begin, std::uint32_t end, int level, size_t &subtree);
+    void SortByCode();
+
+    float rootSize = 0.0f;
+
+    // The particles with mass, in Morton order
+    std::vector<std::uint32_t> codes;
+    std::vector<std::uint32_t> order; // Index of each sorted particle in the caller's arrays
+    std::vector<float> sortedX;
+    std::vector<float> sortedY;
+    std::vector<float> sortedMass;
+
+    std::vector<Node> nodes;
+    std::vector<Subtree> subtrees;
+
+    // Radix sort scratch
+    std::vector<std::uint32_t> scratchCodes;
+    std::vector<std::uint32_t> scratchOrder;
+};
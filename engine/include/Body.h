@@ -1,6 +1,7 @@
 #pragma once
 #include <Vec2.h>
 #include <Shape.h>
+#include <Transform.h>
 #include <memory>
 
 class Body
@@ -31,6 +32,10 @@ public:
 
     void Integrate(float dt);
 
-    // Helper to transform shape vertices to world space
+    // Helper to transform shape vertices to world space.
+    // Does nothing if the body has not moved since the last call.
     void UpdateWorldVertices();
+
+    // Position and rotation the world vertices were last computed with
+    Transform transform;
 };
\ No newline at end of file
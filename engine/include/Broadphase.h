@@ -0,0 +1,118 @@
+#pragma once
+
+#include <AABB.h>
+#include <DynamicTree.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Broadphase collision detection.
+// Testing every pair of bodies with the (expensive) narrow phase is O(n^2).
+// The broadphase only looks at cheap bounding boxes and hands the narrow
+// phase a short list of candidate pairs that might actually be touching.
+
+// A candidate pair. a and b are indices into the AABB list that was passed
+// to FindPairs, and a < b always holds.
+struct BroadphasePair
+{
+    int a;
+    int b;
+
+    bool operator<(const BroadphasePair &other) const
+    {
+        return a < other.a || (a == other.a && b < other.b);
+    }
+    bool operator==(const BroadphasePair &other) const { return a == other.a && b == other.b; }
+};
+
+class Broadphase
+{
+public:
+    virtual ~Broadphase() = default;
+
+    // Fills pairs with every (a, b) whose boxes overlap, sorted by (a, b) so the
+    // narrow phase visits them in the same order as the brute-force loop.
+    virtual void FindPairs(const std::vector<AABB> &aabbs, std::vector<BroadphasePair> &pairs) = 0;
+
+    // A copy with the same settings and cached state (see World::Clone)
+    virtual std::unique_ptr<Broadphase> Clone() const = 0;
+};
+
+// Tests every pair of boxes. Slow, but trivially correct: use it to validate
+// the other broadphases.
+class BruteForceBroadphase : public Broadphase
+{
+public:
+    void FindPairs(const std::vector<AABB> &aabbs, std::vector<BroadphasePair> &pairs) override;
+    std::unique_ptr<Broadphase> Clone() const override { return std::make_unique<BruteForceBroadphase>(*this); }
+};
+
+// Uniform grid / spatial hash.
+// Every box is inserted into the cells it covers and only boxes that share a
+// cell are tested against each other. Cells are hashed, so the grid has no
+// fixed bounds. Boxes much larger than a cell (like the floor) would cover
+// hundreds of cells; they are kept out of the grid and tested against every
+// other box instead.
+class UniformGridBroadphase : public Broadphase
+{
+public:
+    // A cellSize <= 0 picks the cell size automatically from the average box
+    // size every time FindPairs is called.
+    explicit UniformGridBroadphase(float cellSize = 0.0f, int maxCellsPerBox = 16)
+        : cellSize(cellSize), maxCellsPerBox(maxCellsPerBox) {}
+
+    void FindPairs(const std::vector<AABB> &aabbs, std::vector<BroadphasePair> &pairs) override;
+    std::unique_ptr<Broadphase> Clone() const override { return std::make_unique<UniformGridBroadphase>(*this); }
+
+    float cellSize;
+    int maxCellsPerBox;
+
+private:
+    struct CellEntry
+    {
+        std::uint64_t cell;
+        int index;
+
+        bool operator<(const CellEntry &other) const
+        {
+            return cell < other.cell || (cell == other.cell && index < other.index);
+        }
+    };
+
+    // Scratch buffers, kept between calls so a steady-state step does not allocate
+    std::vector<CellEntry> entries;
+    std::vector<int> oversized;
+};
+
+// Incremental broadphase built on a DynamicTree.
+// Proxies are keyed by body index and persist between calls. A body is only
+// re-inserted when it leaves its fat box, and only those moved bodies query
+// the tree for new pairs. The set of pairs whose fat boxes overlap is cached
+// across frames, so pairs between bodies that did not move cost nothing.
+class TreeBroadphase : public Broadphase
+{
+public:
+    explicit TreeBroadphase(float margin = 10.0f) : tree(margin) {}
+
+    void FindPairs(const std::vector<AABB> &aabbs, std::vector<BroadphasePair> &pairs) override;
+
+    // Drops every proxy and cached pair, e.g. when the body list is rebuilt
+    void Clear();
+    std::unique_ptr<Broadphase> Clone() const override { return std::make_unique<TreeBroadphase>(*this); }
+
+    // The tree's user data is the body index, so it can be queried directly
+    // for ray casts and region queries.
+    const DynamicTree &GetTree() const { return tree; }
+
+    // Number of fat-box overlaps currently cached
+    size_t GetCachedPairCount() const { return pairCache.size(); }
+
+private:
+    DynamicTree tree;
+    std::vector<int> proxies; // body index -> proxy id
+    std::vector<char> moved;  // body index -> moved this call
+
+    std::vector<BroadphasePair> pairCache; // sorted
+    std::vector<BroadphasePair> newPairs;
+    std::vector<BroadphasePair> merged;
+};
@@ -6,18 +6,19 @@ class CircleShape : public Shape
 public:
     float radius;
 
-    CircleShape(float radius, float mass) : radius(radius) { this->mass = mass; }
+    CircleShape(float radius, float mass) : Shape(CIRCLE), radius(radius) { this->mass = mass; }
 
-    float GetMomentOfInertia() const override
+    float GetMomentOfInertia() const
     {
         // For a solid disk, I = 0.5 * m * r^2
         return 0.5f * mass * radius * radius;
     }
 
-    Type GetType() const override
-    {
-        return CIRCLE;
-    }
+    // The core of a circle is its centre
+    int GetVertexCount() const override { return 1; }
+    Vec2 GetVertex(int, const Vec2 &position) const override { return position; }
+    int GetSupport(const Vec2 &, const Vec2 &) const override { return 0; }
+    float GetRadius() const override { return radius; }
 
     std::unique_ptr<Shape> Clone() const override
     {
@@ -1,204 +1,346 @@
 #pragma once
 
-#include <Body.h>
 #include <CircleShape.h>
+#include <Distance.h>
 #include <PolygonShape.h>
+#include <cstdint>
 #include <limits>
 
-// Section 17: Collision Contact Information
-// This struct holds all the information about a collision event.
-struct CollisionInfo
+// Identifies a contact point by the vertex of A and the vertex of B it lies
+// next to. The same two vertices touching in the next frame give the same id,
+// which is how a point finds its impulses from the last frame.
+inline std::uint32_t MakeContactId(int vertexA, int vertexB)
 {
-    Body *a;
-    Body *b;
-    float penetrationDepth;
-    Vec2 collisionNormal;
-    Vec2 contactPoint;
+    return static_cast<std::uint32_t>(vertexA & 0xFFFF) | static_cast<std::uint32_t>(vertexB & 0xFFFF) << 16;
+}
+
+struct ManifoldPoint
+{
+    Vec2 point;         // Halfway between the two surfaces
+    float separation;   // Negative while the shapes overlap
+    std::uint32_t id;   // See MakeContactId
+    float normalImpulse = 0.0f;  // Accumulated by the solver, and carried
+    float tangentImpulse = 0.0f; // over to the next frame by id
+};
+
+// Where two shapes touch: up to two points sharing one normal, enough to
+// hold a box flat on another one.
+struct Manifold
+{
+    Vec2 normal; // Points from A to B
+    ManifoldPoint points[2];
+    int pointCount = 0;
+};
+
+// The axis that separated two polygons the last time they were tested.
+// Pairs that are close but apart usually stay apart along the same edge for
+// many frames, so trying that edge first lets most of them leave after a
+// single support query.
+struct SeparatingAxis
+{
+    std::int16_t edge = -1;   // -1 when the pair was touching or is new
+    std::int16_t support = 0; // Deepest vertex of the other polygon, the next search starts there
+    std::uint8_t owner = 0;   // 0: an edge of A, 1: an edge of B
+};
+
+// What the narrow phase remembers about a pair from one frame to the next
+struct NarrowPhaseCache
+{
+    SeparatingAxis axis;  // Polygon pairs
+    SimplexCache simplex; // Pairs that go through GJK
 };
 
 class Collision
 {
 private:
-    // Helper for SAT: Projects the vertices of a polygon onto an axis
-    static void ProjectVertices(const PolygonShape *polygon, const Vec2 &axis, float &min, float &max)
+    // Distance from edge i of polyA to the deepest vertex of polyB behind it.
+    // That vertex is the support point of B against the edge normal, searched
+    // from support, which is updated.
+    static float EdgeSeparation(const PolygonShape &polyA, const PolygonShape &polyB, int i, int &support)
     {
-        min = std::numeric_limits<float>::max();
-        max = std::numeric_limits<float>::min();
-        for (const auto &v : polygon->worldVertices)
+        const Vec2 &normal = polyA.worldNormals[i];
+        support = polyB.FindSupport(-normal, support);
+        return normal.Dot(polyB.worldVertices[support] - polyA.worldVertices[i]);
+    }
+
+    // Largest distance from an edge of A to the deepest vertex of B behind it.
+    // A positive result means that edge separates the two polygons.
+    // The edge normals of A turn steadily around the polygon, and so does the
+    // support point of B against them, so each search starts from the last
+    // one and the whole loop walks around B about once.
+    static float FindMaxSeparation(const PolygonShape &polyA, const PolygonShape &polyB, int &bestEdge, int &bestSupport)
+    {
+        float maxSeparation = -std::numeric_limits<float>::max();
+        bestEdge = 0;
+        bestSupport = 0;
+        int support = 0;
+        for (size_t i = 0; i < polyA.worldVertices.size(); ++i)
         {
-            float projection = v.Dot(axis);
-            if (projection < min)
-                min = projection;
-            if (projection > max)
-                max = projection;
+            const float separation = EdgeSeparation(polyA, polyB, static_cast<int>(i), support);
+            if (separation > maxSeparation)
+            {
+                maxSeparation = separation;
+                bestEdge = static_cast<int>(i);
+                bestSupport = support;
+                if (separation > 0.0f)
+                {
+                    break; // Found a separating axis, no need to look further
+                }
+            }
         }
+        return maxSeparation;
     }
 
 public:
-    static bool PolygonPolygonCollision(CollisionInfo &info)
+    static bool PolygonPolygon(const PolygonShape &polyA, const PolygonShape &polyB, Manifold &manifold)
     {
-        PolygonShape *polyA = static_cast<PolygonShape *>(info.a->shape.get());
-        PolygonShape *polyB = static_cast<PolygonShape *>(info.b->shape.get());
+        SeparatingAxis axis;
+        return PolygonPolygon(polyA, polyB, manifold, axis);
+    }
 
-        float minOverlap = std::numeric_limits<float>::max();
-        Vec2 smallestAxis;
+    // Polygon-polygon manifold by clipping. The edge with the least
+    // penetration is the reference edge; the edge of the other polygon that
+    // faces it the most (the incident edge) is clipped to the ends of the
+    // reference edge, and the points of it that are behind the reference edge
+    // are the contacts.
+    //
+    // axis is the separating axis from the last test of this pair, and is
+    // updated for the next one.
+    static bool PolygonPolygon(const PolygonShape &polyA, const PolygonShape &polyB, Manifold &manifold,
+                               SeparatingAxis &axis)
+    {
+        manifold.pointCount = 0;
 
-        // Loop through axes of Polygon A
-        for (size_t i = 0; i < polyA->worldVertices.size(); ++i)
+        if (axis.edge >= 0)
         {
-            Vec2 v1 = polyA->worldVertices[i];
-            Vec2 v2 = polyA->worldVertices[(i + 1) % polyA->worldVertices.size()];
-            Vec2 edge = v2 - v1;
-            Vec2 axis = edge.Perpendicular().Normalized();
-
-            float minA, maxA, minB, maxB;
-            ProjectVertices(polyA, axis, minA, maxA);
-            ProjectVertices(polyB, axis, minB, maxB);
-
-            if (maxA < minB || maxB < minA)
+            const PolygonShape &owner = axis.owner == 0 ? polyA : polyB;
+            const PolygonShape &other = axis.owner == 0 ? polyB : polyA;
+            if (axis.edge < static_cast<int>(owner.worldVertices.size()) &&
+                axis.support < static_cast<int>(other.worldVertices.size()))
             {
-                return false; // Found a separating axis, no collision
+                int support = axis.support;
+                if (EdgeSeparation(owner, other, axis.edge, support) > 0.0f)
+                {
+                    axis.support = static_cast<std::int16_t>(support);
+                    return false;
+                }
             }
+            axis.edge = -1;
+        }
 
-            // Calculate overlap and update if it's the smallest
-            float overlap = std::min(maxA, maxB) - std::max(minA, minB);
-            if (overlap < minOverlap)
-            {
-                minOverlap = overlap;
-                smallestAxis = axis;
-            }
+        int edgeA;
+        int supportA;
+        const float separationA = FindMaxSeparation(polyA, polyB, edgeA, supportA);
+        if (separationA > 0.0f)
+        {
+            axis = {static_cast<std::int16_t>(edgeA), static_cast<std::int16_t>(supportA), 0};
+            return false;
         }
 
-        // Loop through axes of Polygon B
-        for (size_t i = 0; i < polyB->worldVertices.size(); ++i)
+        int edgeB;
+        int supportB;
+        const float separationB = FindMaxSeparation(polyB, polyA, edgeB, supportB);
+        if (separationB > 0.0f)
         {
-            Vec2 v1 = polyB->worldVertices[i];
-            Vec2 v2 = polyB->worldVertices[(i + 1) % polyB->worldVertices.size()];
-            Vec2 edge = v2 - v1;
-            Vec2 axis = edge.Perpendicular().Normalized();
+            axis = {static_cast<std::int16_t>(edgeB), static_cast<std::int16_t>(supportB), 1};
+            return false;
+        }
 
-            float minA, maxA, minB, maxB;
-            ProjectVertices(polyA, axis, minA, maxA);
-            ProjectVertices(polyB, axis, minB, maxB);
+        // Prefer A's edge unless B's is clearly better, so the choice does
+        // not flicker between frames when both are about as good
+        const float tolerance = 0.05f; // pixels
+        const PolygonShape *reference = &polyA;
+        const PolygonShape *incident = &polyB;
+        int referenceEdge = edgeA;
+        int incidentSupport = supportA;
+        bool flip = false;
+        if (separationB > separationA + tolerance)
+        {
+            reference = &polyB;
+            incident = &polyA;
+            referenceEdge = edgeB;
+            incidentSupport = supportB;
+            flip = true;
+        }
 
-            if (maxA < minB || maxB < minA)
-            {
-                return false; // Found a separating axis, no collision
-            }
+        // The incident edge is one of the two edges at the deepest vertex:
+        // whichever faces the reference normal more
+        const size_t incidentCount = incident->worldVertices.size();
+        const Vec2 normal = reference->worldNormals[referenceEdge];
+        const int previousEdge = static_cast<int>((incidentSupport + incidentCount - 1) % incidentCount);
+        const int incidentEdge = normal.Dot(incident->worldNormals[previousEdge]) <
+                                         normal.Dot(incident->worldNormals[incidentSupport])
+                                     ? previousEdge
+                                     : incidentSupport;
 
-            float overlap = std::min(maxA, maxB) - std::max(minA, minB);
-            if (overlap < minOverlap)
+        // The reference edge runs from r1 to r2, the incident edge from i1 to
+        // i2, the other way round: i2 lies next to r1 and i1 next to r2
+        const int r1 = referenceEdge;
+        const int r2 = static_cast<int>((referenceEdge + 1) % reference->worldVertices.size());
+        const int i1 = incidentEdge;
+        const int i2 = static_cast<int>((incidentEdge + 1) % incidentCount);
+        const Vec2 &referenceStart = reference->worldVertices[r1];
+        const Vec2 &incident1 = incident->worldVertices[i1];
+        const Vec2 &incident2 = incident->worldVertices[i2];
+
+        // Positions along the reference edge
+        const Vec2 edge = reference->worldVertices[r2] - referenceStart;
+        const float length = edge.Magnitude();
+        const Vec2 tangent = edge / length;
+        const float lower1 = 0.0f;
+        const float upper1 = length;
+        const float upper2 = tangent.Dot(incident1 - referenceStart);
+        const float lower2 = tangent.Dot(incident2 - referenceStart);
+        manifold.normal = flip ? -normal : normal;
+        auto addPoint = [&](const Vec2 &v, int referenceVertex, int incidentVertex)
+        {
+            const float separation = normal.Dot(v - referenceStart);
+            if (separation > 0.0f)
+                return;
+
+            ManifoldPoint &point = manifold.points[manifold.pointCount++];
+            point.point = v - normal * (0.5f * separation);
+            point.separation = separation;
+            point.id = flip ? MakeContactId(incidentVertex, referenceVertex) : MakeContactId(referenceVertex, incidentVertex);
+            point.normalImpulse = 0.0f;
+            point.tangentImpulse = 0.0f;
+        };
+
+        if (upper2 >= lower1 && upper1 >= lower2)
+        {
+            // Cut the incident edge where it sticks out past the reference edge
+            Vec2 lower = incident2;
+            Vec2 upper = incident1;
+            const float span = upper2 - lower2;
+            if (span > 1e-5f)
             {
-                minOverlap = overlap;
-                smallestAxis = axis;
+                if (lower2 < lower1)
+                    lower = incident2 + (incident1 - incident2) * ((lower1 - lower2) / span);
+                if (upper2 > upper1)
+                    upper = incident2 + (incident1 - incident2) * ((upper1 - lower2) / span);
             }
+            addPoint(lower, r1, i2);
+            addPoint(upper, r2, i1);
         }
 
-        // If we get here, there is a collision. Populate the info struct.
-        info.penetrationDepth = minOverlap;
-        info.collisionNormal = smallestAxis;
+        // Two corners overlapping just past the end of the reference edge
+        // (short edges on polygons with many sides) leave nothing after
+        // clipping; the deepest vertex, which the separating axis test found
+        // behind the reference edge, is then the contact
+        if (manifold.pointCount == 0)
+        {
+            addPoint(incident->worldVertices[incidentSupport], r1, incidentSupport);
+        }
+        return manifold.pointCount > 0;
+    }
 
-        // Ensure normal points from A to B
-        Vec2 dir = info.b->position - info.a->position;
-        if (info.collisionNormal.Dot(dir) < 0)
+    static bool CircleCircle(const CircleShape &circleA, const Vec2 &positionA,
+                             const CircleShape &circleB, const Vec2 &positionB, Manifold &manifold)
+    {
+        manifold.pointCount = 0;
+        const float sumRadii = circleA.radius + circleB.radius;
+        const Vec2 distanceVec = positionB - positionA;
+        const float distance = distanceVec.Magnitude();
+        if (distance > sumRadii)
         {
-            info.collisionNormal = -info.collisionNormal;
+            return false;
         }
 
-        // A simple (but not perfect) way to find contact point
-        info.contactPoint = info.a->position; // Placeholder
+        // Two circles on top of each other: any direction will do
+        manifold.normal = distance > 1e-5f ? distanceVec / distance : Vec2(0.0f, 1.0f);
 
+        const Vec2 surfaceA = positionA + manifold.normal * circleA.radius;
+        const Vec2 surfaceB = positionB - manifold.normal * circleB.radius;
+        ManifoldPoint &point = manifold.points[manifold.pointCount++];
+        point.point = (surfaceA + surfaceB) * 0.5f;
+        point.separation = distance - sumRadii;
+        point.id = 0;
+        point.normalImpulse = 0.0f;
+        point.tangentImpulse = 0.0f;
         return true;
     }
-    // Section 17: Coding the Circle-Circle Collision Information
-    // This is the "Narrow Phase" of collision detection for two circles.
-    static bool CircleCircleCollision(CollisionInfo &info)
-    {
-        Body *a = info.a;
-        Body *b = info.b;
-        CircleShape *circleA = static_cast<CircleShape *>(a->shape.get());
-        CircleShape *circleB = static_cast<CircleShape *>(b->shape.get());
 
-        const float sumRadii = circleA->radius + circleB->radius;
-        const Vec2 distanceVec = b->position - a->position;
-        const float distance = distanceVec.Magnitude();
-
-        // If the distance is greater than the sum of radii, there is no collision.
-        if (distance > sumRadii)
+    // Any two convex shapes, through GJK and EPA (see Distance.h): one
+    // contact point, between the closest points of the two surfaces. The
+    // simplex cache lets a pair that hardly moved finish GJK in an iteration
+    // or two.
+    static bool ConvexConvex(const Shape &shapeA, const Vec2 &positionA,
+                             const Shape &shapeB, const Vec2 &positionB, Manifold &manifold, SimplexCache &cache)
+    {
+        manifold.pointCount = 0;
+        const DistanceOutput output = Distance::ComputeSigned(shapeA, positionA, shapeB, positionB, cache);
+        if (output.distance > 0.0f)
         {
             return false;
         }
 
-        // Collision has occurred. Populate the rest of the info struct.
-        info.penetrationDepth = sumRadii - distance;
-        info.collisionNormal = distanceVec.Normalized();
+        manifold.normal = output.normal;
+        ManifoldPoint &point = manifold.points[manifold.pointCount++];
+        point.point = (output.pointA + output.pointB) * 0.5f;
+        point.separation = output.distance;
+        point.id = 0;
+        point.normalImpulse = 0.0f;
+        point.tangentImpulse = 0.0f;
         return true;
     }
 
-    static bool CirclePolygonCollision(CollisionInfo &info)
+    // A circle against a polygon is GJK between the centre and the polygon,
+    // less the radius; EPA takes over once the centre is inside
+    static bool CirclePolygon(const CircleShape &circle, const Vec2 &circlePosition,
+                              const PolygonShape &polygon, const Vec2 &polygonPosition,
+                              Manifold &manifold, SimplexCache &cache)
     {
-        // ... (This is complex, we can add it later. For now, we return false) ...
-        return false;
+        return ConvexConvex(circle, circlePosition, polygon, polygonPosition, manifold, cache);
     }
 
-    // Section 18: Coding the Linear Impulse Function
-    // This function resolves a collision by applying an impulse.
-    static void ResolveCollision(CollisionInfo &info)
+    // The entries of the GetCollideFunction table
+    static bool CollideCircles(const Shape &shapeA, const Vec2 &positionA, const Shape &shapeB,
+                               const Vec2 &positionB, Manifold &manifold, NarrowPhaseCache &)
+    {
+        return CircleCircle(static_cast<const CircleShape &>(shapeA), positionA,
+                            static_cast<const CircleShape &>(shapeB), positionB, manifold);
+    }
+    static bool CollidePolygons(const Shape &shapeA, const Vec2 &, const Shape &shapeB, const Vec2 &,
+                                Manifold &manifold, NarrowPhaseCache &cache)
+    {
+        return PolygonPolygon(static_cast<const PolygonShape &>(shapeA), static_cast<const PolygonShape &>(shapeB),
+                              manifold, cache.axis);
+    }
+    static bool CollideConvex(const Shape &shapeA, const Vec2 &positionA, const Shape &shapeB,
+                              const Vec2 &positionB, Manifold &manifold, NarrowPhaseCache &cache)
     {
-        // Separate the colliding bodies
-        const float percent = 0.8f;
-        Vec2 separation = info.collisionNormal * (info.penetrationDepth / (info.a->inverseMass + info.b->inverseMass)) * percent;
-        if (info.a->inverseMass != 0)
-            info.a->position -= separation * info.a->inverseMass;
-        if (info.b->inverseMass != 0)
-            info.b->position += separation * info.b->inverseMass;
-
-        // For now, we will use the old linear impulse resolution.
-        // Implementing the full angular resolution is the next step.
-        const Vec2 relativeVelocity = info.b->velocity - info.a->velocity;
-        const float relativeSpeed = relativeVelocity.Dot(info.collisionNormal);
-        const float e = 0.5f; // Bounciness
-
-        float numerator = -(1.0f + e) * relativeSpeed;
-        float denominator = info.a->inverseMass + info.b->inverseMass;
-        float j = (denominator == 0) ? 0 : numerator / denominator;
-
-        Vec2 impulse = info.collisionNormal * j;
-        if (info.a->inverseMass != 0)
-            info.a->velocity -= impulse * info.a->inverseMass;
-        if (info.b->inverseMass != 0)
-            info.b->velocity += impulse * info.b->inverseMass;
+        return ConvexConvex(shapeA, positionA, shapeB, positionB, manifold, cache.simplex);
     }
 
-    static void DetectAndResolveCollisions(std::vector<std::unique_ptr<Body>> &bodies)
+    static bool Collide(const Shape &shapeA, const Vec2 &positionA,
+                        const Shape &shapeB, const Vec2 &positionB, Manifold &manifold)
     {
-        for (size_t i = 0; i < bodies.size(); ++i)
-        {
-            for (size_t j = i + 1; j < bodies.size(); ++j)
-            {
-                Body *a = bodies[i].get();
-                Body *b = bodies[j].get();
-                CollisionInfo info = {a, b};
+        NarrowPhaseCache cache;
+        return Collide(shapeA, positionA, shapeB, positionB, manifold, cache);
+    }
 
-                bool collided = false;
-                if (a->shape->GetType() == Shape::CIRCLE && b->shape->GetType() == Shape::CIRCLE)
-                {
-                    collided = CircleCircleCollision(info);
-                }
-                else if (a->shape->GetType() == Shape::POLYGON && b->shape->GetType() == Shape::POLYGON)
-                {
-                    collided = PolygonPolygonCollision(info);
-                }
-                else
-                {
-                    // collided = CirclePolygonCollision(info);
-                }
+    // A manifold function for shapes already known to be of the types it
+    // was picked for
+    using CollideFunction = bool (*)(const Shape &shapeA, const Vec2 &positionA,
+                                     const Shape &shapeB, const Vec2 &positionB,
+                                     Manifold &manifold, NarrowPhaseCache &cache);
 
-                if (collided)
-                {
-                    ResolveCollision(info);
-                }
-            }
-        }
+    // The manifold function for a pair of shape types, from a table indexed
+    // by both. Circle and polygon pairs have their own, the rest go through
+    // GJK/EPA.
+    static CollideFunction GetCollideFunction(Shape::Type typeA, Shape::Type typeB)
+    {
+        static constexpr CollideFunction functions[Shape::TYPE_COUNT][Shape::TYPE_COUNT] = {
+            {&CollideCircles, &CollideConvex},
+            {&CollideConvex, &CollidePolygons},
+        };
+        return functions[typeA][typeB];
+    }
+
+    static bool Collide(const Shape &shapeA, const Vec2 &positionA,
+                        const Shape &shapeB, const Vec2 &positionB, Manifold &manifold, NarrowPhaseCache &cache)
+    {
+        return GetCollideFunction(shapeA.GetType(), shapeB.GetType())(shapeA, positionA, shapeB, positionB,
+                                                                       manifold, cache);
     }
 };
\ No newline at end of file
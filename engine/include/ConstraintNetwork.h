@@ -0,0 +1,89 @@
+#pragma once
+
+#include <JobSystem.h>
+#include <Snapshot.h>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Links between pairs of particles (cloth, ropes, soft bodies), kept as
+// compact arrays: both ends, the rest length and the stiffness of each link.
+//
+// Two solvers share the same links:
+//   Springs - Hooke's law forces, k * (length - restLength) on both ends,
+//             integrated explicitly like any other force. Cheap, but stiff
+//             springs blow up unless the step is small.
+//   XPBD    - extended position based dynamics: after integration, each link
+//             moves its two ends back towards the rest length, as far as its
+//             compliance (1 / stiffness) allows for this step. Stable at any
+//             stiffness and step size; an infinite stiffness gives a rigid
+//             link. Velocities are then taken from how far particles moved.
+//             Long chains converge slowly: more substeps help far more than
+//             more iterations.
+//
+// The links are split into colours such that no two links of one colour
+// share a particle. Links of one colour can then be solved in parallel with
+// no locks, and the colours one after the other (Gauss-Seidel between
+// colours). Links are reordered by colour the first time they are solved
+// after a change.
+class ConstraintNetwork
+{
+public:
+    enum class Solver
+    {
+        Springs,
+        XPBD,
+    };
+
+    static constexpr float rigid = std::numeric_limits<float>::infinity();
+
+    Solver solver = Solver::Springs;
+    // XPBD: the step is cut into substeps (by the ParticleSystem), each with
+    // this many passes over all links
+    int substeps = 8;
+    int iterations = 1;
+
+    void AddLink(std::uint32_t a, std::uint32_t b, float restLength, float stiffness);
+    // Removes every link with particle at either end. The other links keep
+    // their order and colours.
+    void RemoveLinks(std::uint32_t particle);
+    void Clear();
+    size_t GetLinkCount() const { return linkA.size(); }
+    size_t GetColorCount();
+
+    // Springs: adds the spring forces of every link
+    void ApplyForces(const float *positionX, const float *positionY, float *forceX, float *forceY,
+                     JobSystem &jobSystem);
+
+    // XPBD: moves the ends of every link towards its rest length
+    void SolvePositions(float *positionX, float *positionY, const float *inverseMasses, float dt,
+                        JobSystem &jobSystem);
+
+    // The links and their colouring, as sections of a particle snapshot (see
+    // ParticleSystem::Save). Restore leaves the network untouched and returns
+    // false if the sections are missing, or link particles that are not
+    // below particleCount.
+    void Save(Snapshot &snapshot) const;
+    bool Restore(const SnapshotReader &reader, size_t particleCount);
+
+    // Link state, one entry per link
+    std::vector<std::uint32_t> linkA;
+    std::vector<std::uint32_t> linkB;
+    std::vector<float> restLengths;
+    std::vector<float> stiffnesses;
+
+private:
+    void Color();
+
+    // Runs fn(link) for every link, colour by colour, in parallel within one
+    template <typename Fn>
+    void ForEachLink(JobSystem &jobSystem, Fn &&fn);
+
+    std::vector<float> lambdas; // XPBD: the impulse each link applied so far this step
+
+    // Links [colorOffsets[c], colorOffsets[c + 1]) have colour c. The last
+    // range holds the links that found no free colour, solved on one thread.
+    std::vector<std::uint32_t> colorOffsets = {0, 0};
+    bool colored = true;
+};
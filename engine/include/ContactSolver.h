@@ -0,0 +1,117 @@
+#pragma once
+
+#include <Broadphase.h>
+#include <Collision.h>
+#include <Island.h>
+#include <Vec2.h>
+#include <cstddef>
+#include <vector>
+
+struct SolverSettings
+{
+    // More iterations converge tall stacks better, at a linear cost
+    int velocityIterations = 8;
+    int positionIterations = 3;
+
+    // Start from last frame's impulses instead of from zero
+    bool warmStarting = true;
+
+    float friction = 0.4f;
+    float restitution = 0.5f;            // Bounciness
+    float restitutionThreshold = 60.0f;  // pixels/s: slower impacts do not bounce
+    float linearSlop = 0.5f;             // pixels of overlap left alone, so resting contacts stay touching
+    float baumgarte = 0.2f;              // Fraction of the overlap removed per position iteration
+    float maxCorrection = 5.0f;          // pixels a position iteration may move a contact
+};
+
+// Sequential impulse solver for contact manifolds.
+//
+// Velocity pass: every contact point gets a friction impulse and a normal
+// impulse, one point after the other, over several iterations. The impulses
+// are accumulated and clamped (the normal one never pulls, friction never
+// exceeds friction * normal), and the totals are kept in the manifold so the
+// next frame can start from them (warm starting). A resting stack then only
+// needs a few iterations to settle instead of rebuilding its impulses from
+// zero every frame.
+//
+// The World integrates positions before the solve, with the velocities from
+// before it. The solver moves each body by the velocity change it made, which
+// gives the same positions as integrating after the solve; otherwise gravity
+// would push a resting stack gravity * dt^2 into the floor every step.
+//
+// Position pass: overlap beyond linearSlop is removed by moving the bodies
+// directly, without adding velocity, so resolving penetration does not make
+// bodies bounce.
+class ContactSolver
+{
+public:
+    // The body arrays the solver reads and writes, indexed by body index
+    struct Bodies
+    {
+        float *positionX;
+        float *positionY;
+        float *angles;
+        float *velocityX;
+        float *velocityY;
+        float *angularVelocities;
+        const float *inverseMasses;
+        const float *inverseInertias;
+    };
+
+    // Makes room for one constraint per pair and one entry per body. Call
+    // once per step, before solving any island.
+    void Reset(size_t pairCount, size_t bodyCount);
+
+    // Solves the contacts of one island, whose manifolds are indexed like
+    // pairs. Islands share no dynamic bodies, and static bodies (shared by
+    // many islands) are only ever read, so several islands can be solved at
+    // the same time.
+    void SolveIsland(const Bodies &bodies, const SolverSettings &settings, float dt, const IslandBuilder &islands,
+                     size_t island, const std::vector<BroadphasePair> &pairs, std::vector<Manifold> &manifolds);
+
+private:
+    struct Point
+    {
+        Vec2 rA; // From the body positions to the contact point
+        Vec2 rB;
+        float normalMass;
+        float tangentMass;
+        float velocityBias; // Target separating speed, from restitution
+        float separation;
+        float normalImpulse;
+        float tangentImpulse;
+    };
+
+    struct Constraint
+    {
+        int a;
+        int b;
+        Vec2 normal;
+        float invMassA, invMassB;
+        float invInertiaA, invInertiaB;
+        Vec2 startPositionA, startPositionB; // To measure how far the position pass moved the bodies
+        float startAngleA, startAngleB;
+        int pointCount;
+        Point points[2];
+
+        // Two-point normal system K and its inverse, both symmetric
+        bool blockSolve;
+        float k11, k12, k22;
+        float inverse11, inverse12, inverse22;
+    };
+
+    void Prepare(const Bodies &bodies, const SolverSettings &settings, const BroadphasePair &pair,
+                 const Manifold &manifold, Constraint &constraint) const;
+    void WarmStart(const Bodies &bodies, const Constraint &constraint) const;
+    void SolveVelocity(const Bodies &bodies, const SolverSettings &settings, Constraint &constraint) const;
+    void SolveNormalBlock(Constraint &constraint, Vec2 &velocityA, float &angularVelocityA,
+                          Vec2 &velocityB, float &angularVelocityB) const;
+    void SolvePosition(const Bodies &bodies, const SolverSettings &settings, const Constraint &constraint) const;
+
+    std::vector<Constraint> constraints;
+
+    // Body velocities before the solve
+    std::vector<float> startVelocityX;
+    std::vector<float> startVelocityY;
+    std::vector<float> startAngularVelocity;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <AABB.h>
+#include <Vec2.h>
+#include <cstdint>
+
+struct Color
+{
+    std::uint8_t r = 255;
+    std::uint8_t g = 255;
+    std::uint8_t b = 255;
+    std::uint8_t a = 255;
+
+    Color() = default;
+    Color(std::uint8_t r, std::uint8_t g, std::uint8_t b, std::uint8_t a = 255) : r(r), g(g), b(b), a(a) {}
+};
+
+// Rendering interface for debug visualisation.
+// The engine only describes what to draw; an adapter outside the engine
+// (like SDLDebugDraw in engine/sdl) turns it into actual draw calls. This
+// keeps the engine itself free of any graphics dependency.
+//
+// An adapter may buffer what it is given and only draw it in Flush, e.g. to
+// send a whole frame to the GPU in one call (SDLDebugDraw does).
+class DebugDraw
+{
+public:
+    // What the engine's Draw functions draw (World::Draw)
+    enum Flags : unsigned
+    {
+        SHAPES = 1,
+        AABBS = 2,
+        CONTACTS = 4,
+    };
+    unsigned flags = SHAPES;
+
+    virtual ~DebugDraw() = default;
+
+    // The region being looked at, in world units. The engine's Draw
+    // functions skip whatever lies entirely outside it. Until it is set
+    // nothing is skipped.
+    void SetViewport(const AABB &view)
+    {
+        viewport = view;
+        culling = true;
+    }
+    void ClearViewport() { culling = false; }
+    bool IsVisible(const AABB &box) const { return !culling || viewport.Overlaps(box); }
+
+    // Closed outline through count vertices
+    virtual void DrawPolygon(const Vec2 *vertices, int count, const Color &color) = 0;
+
+    // Outline of a circle, plus a radius line showing its angle
+    virtual void DrawCircle(const Vec2 &center, float radius, float angle, const Color &color) = 0;
+
+    virtual void DrawSegment(const Vec2 &a, const Vec2 &b, const Color &color) = 0;
+
+    // Draws whatever has been buffered since the last Flush
+    virtual void Flush() {}
+
+private:
+    AABB viewport;
+    bool culling = false;
+};
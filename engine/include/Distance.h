@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Shape.h>
+#include <Transform.h>
+#include <Vec2.h>
+#include <cstdint>
+
+// The simplex a GJK query ended with, stored as the vertex indices of both
+// shapes. Shapes hardly move between frames, so the next query of the same
+// pair starting from it usually finishes in an iteration or two.
+struct SimplexCache
+{
+    std::uint8_t count = 0; // 0: start from scratch
+    std::uint16_t indexA[3];
+    std::uint16_t indexB[3];
+};
+
+struct DistanceOutput
+{
+    Vec2 pointA;      // Closest point on the surface of A
+    Vec2 pointB;      // Closest point on the surface of B
+    Vec2 normal;      // Unit direction from A to B
+    float distance;   // Between the surfaces; negative when they overlap (ComputeSigned only)
+    int iterations;   // GJK iterations, to check how well the cache works
+};
+
+// The motion of a body over one step: from pose 0 at t = 0 to pose 1 at
+// t = 1, in a straight line and turning at a constant rate
+struct Sweep
+{
+    Vec2 position0;
+    Vec2 position1;
+    float angle0;
+    float angle1;
+
+    Transform GetTransform(float t) const
+    {
+        return Transform(position0 + (position1 - position0) * t, angle0 + (angle1 - angle0) * t);
+    }
+};
+
+struct TimeOfImpactOutput
+{
+    enum State
+    {
+        SEPARATED,  // No impact during the sweep
+        HIT,        // The shapes come within the target distance at t
+        OVERLAPPED, // They already were at t = 0 (t, normal and point are for t = 0)
+    };
+
+    State state;
+    float t;     // In [0, 1]: how far into the sweep
+    Vec2 normal; // From A to B at t
+    Vec2 point;  // Halfway between the closest points at t
+};
+
+// Distance queries between any two convex shapes, through the support
+// functions on Shape.
+//
+// GJK (Gilbert-Johnson-Keerthi) looks for the point of the Minkowski
+// difference B - A closest to the origin, growing a simplex of at most three
+// points of it, each found with one support query per shape. That closest
+// point is the shortest vector from A to B. GJK works on the cores of the
+// shapes (see Shape::GetVertex); the radii are taken off at the end.
+//
+// When the cores overlap the origin is inside the Minkowski difference and
+// GJK can only say so. EPA (expanding polytope algorithm) then grows the GJK
+// triangle towards the boundary of the difference until it finds the edge
+// closest to the origin: its distance is the penetration depth and its
+// normal the direction that separates the shapes fastest.
+namespace Distance
+{
+    // Distance between the surfaces, with the closest points. Overlapping
+    // shapes report a distance of 0 and no normal. Cheap enough for
+    // proximity sensors and continuous collision.
+    DistanceOutput Compute(const Shape &shapeA, const Vec2 &positionA,
+                           const Shape &shapeB, const Vec2 &positionB, SimplexCache &cache);
+
+    // Like Compute, but overlapping shapes get a negative distance (minus the
+    // penetration depth), with the normal and the deepest points from EPA
+    DistanceOutput ComputeSigned(const Shape &shapeA, const Vec2 &positionA,
+                                 const Shape &shapeB, const Vec2 &positionB, SimplexCache &cache);
+
+    bool TestOverlap(const Shape &shapeA, const Vec2 &positionA, const Shape &shapeB, const Vec2 &positionB);
+
+    // First time in the sweeps at which the shapes come within
+    // targetDistance of each other, by conservative advancement: GJK gives
+    // the distance at t, and no point of A gains on B faster than the
+    // relative motion plus the turn times the reach of each shape, so
+    // moving t ahead by distance / that bound can never step past the
+    // impact. Repeats until the distance reaches the target.
+    //
+    // The shapes are posed along the sweeps (polygons get their world
+    // vertices updated) and left at the last pose tried.
+    TimeOfImpactOutput TimeOfImpact(Shape &shapeA, const Sweep &sweepA, Shape &shapeB, const Sweep &sweepB,
+                                    float targetDistance);
+} // namespace Distance
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <AABB.h>
+#include <Vec2.h>
+#include <cmath>
+#include <vector>
+
+// Dynamic AABB tree (bounding volume hierarchy).
+// Every leaf holds a "fat" box: the body's box grown by a margin. As long as
+// the body stays inside its fat box the tree is left untouched, so bodies
+// that barely move cost nothing. The tree adapts to any mix of body sizes,
+// which a uniform grid cannot do.
+class DynamicTree
+{
+public:
+    static constexpr int nullNode = -1;
+
+    explicit DynamicTree(float margin = 10.0f);
+
+    // Creates a leaf for the box and returns its proxy id
+    int CreateProxy(const AABB &aabb, int userData);
+    void DestroyProxy(int proxyId);
+
+    // Re-inserts the leaf only if the new box left its fat box.
+    // Returns true when the leaf was moved.
+    bool MoveProxy(int proxyId, const AABB &aabb);
+
+    const AABB &GetFatAABB(int proxyId) const { return nodes[proxyId].aabb; }
+    int GetUserData(int proxyId) const { return nodes[proxyId].userData; }
+    int GetHeight() const { return root == nullNode ? 0 : nodes[root].height; }
+    int GetProxyCount() const { return proxyCount; }
+
+    // Calls callback(proxyId) for every leaf whose fat box overlaps aabb.
+    // The callback returns false to stop the query early.
+    template <typename Callback>
+    void Query(const AABB &aabb, Callback &&callback) const
+    {
+        Stack stack;
+        stack.Push(root);
+        while (!stack.Empty())
+        {
+            const int nodeId = stack.Pop();
+            if (nodeId == nullNode)
+                continue;
+
+            const Node &node = nodes[nodeId];
+            if (!node.aabb.Overlaps(aabb))
+                continue;
+
+            if (node.IsLeaf())
+            {
+                if (!callback(nodeId))
+                    return;
+            }
+            else
+            {
+                stack.Push(node.child1);
+                stack.Push(node.child2);
+            }
+        }
+    }
+
+    // Casts the segment p1 -> p2 against the fat boxes.
+    // callback(proxyId, p1, p2, maxFraction) returns the new max fraction:
+    // 0 stops the cast, the current fraction clips the ray, and maxFraction
+    // leaves it unchanged. This lets the caller run an exact shape test and
+    // shorten the ray to the closest hit so far.
+    template <typename Callback>
+    void RayCast(const Vec2 &p1, const Vec2 &p2, Callback &&callback) const
+    {
+        Vec2 d = p2 - p1;
+        if (d.MagnitudeSq() <= 0.0f)
+            return;
+        d.Normalize();
+
+        // Separating axis for the segment
+        const Vec2 v = Vec2(-d.y, d.x);
+        const Vec2 absV = Vec2(std::abs(v.x), std::abs(v.y));
+
+        float maxFraction = 1.0f;
+        AABB segmentAABB = SegmentAABB(p1, p2, maxFraction);
+
+        Stack stack;
+        stack.Push(root);
+        while (!stack.Empty())
+        {
+            const int nodeId = stack.Pop();
+            if (nodeId == nullNode)
+                continue;
+
+            const Node &node = nodes[nodeId];
+            if (!node.aabb.Overlaps(segmentAABB))
+                continue;
+
+            // |dot(v, p1 - c)| > dot(|v|, h) means the segment misses the box
+            const Vec2 c = node.aabb.Center();
+            const Vec2 h = node.aabb.Extents();
+            if (std::abs(v.Dot(p1 - c)) - absV.Dot(h) > 0.0f)
+                continue;
+
+            if (node.IsLeaf())
+            {
+                const float value = callback(nodeId, p1, p2, maxFraction);
+                if (value == 0.0f)
+                    return;
+                if (value > 0.0f && value < maxFraction)
+                {
+                    maxFraction = value;
+                    segmentAABB = SegmentAABB(p1, p2, maxFraction);
+                }
+            }
+            else
+            {
+                stack.Push(node.child1);
+                stack.Push(node.child2);
+            }
+        }
+    }
+
+    float margin;
+
+private:
+    struct Node
+    {
+        AABB aabb;
+        int parent = nullNode; // Doubles as the "next" link while the node is free
+        int child1 = nullNode;
+        int child2 = nullNode;
+        int height = -1;       // Leaf = 0, free node = -1
+        int userData = -1;
+
+        bool IsLeaf() const { return child1 == nullNode; }
+    };
+
+    // Traversal stack that lives on the call stack for any reasonable tree
+    // depth and only falls back to the heap for pathological ones
+    class Stack
+    {
+    public:
+        void Push(int value)
+        {
+            if (count < fixedCapacity)
+                fixed[count] = value;
+            else
+                overflow.push_back(value);
+            ++count;
+        }
+        int Pop()
+        {
+            --count;
+            if (count < fixedCapacity)
+                return fixed[count];
+            const int value = overflow.back();
+            overflow.pop_back();
+            return value;
+        }
+        bool Empty() const { return count == 0; }
+
+    private:
+        static constexpr int fixedCapacity = 256;
+        int fixed[fixedCapacity];
+        int count = 0;
+        std::vector<int> overflow;
+    };
+
+    static AABB SegmentAABB(const Vec2 &p1, const Vec2 &p2, float fraction)
+    {
+        const Vec2 t = p1 + (p2 - p1) * fraction;
+        return AABB(Vec2(std::min(p1.x, t.x), std::min(p1.y, t.y)),
+                    Vec2(std::max(p1.x, t.x), std::max(p1.y, t.y)));
+    }
+
+    int AllocateNode();
+    void FreeNode(int nodeId);
+    void InsertLeaf(int leaf);
+    void RemoveLeaf(int leaf);
+    int Balance(int nodeId);
+
+    std::vector<Node> nodes;
+    int root = nullNode;
+    int freeList = nullNode;
+    int proxyCount = 0;
+};
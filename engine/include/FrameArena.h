@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Scratch memory for data that only lives for a short while, such as one step
+// or one draw call. Allocating just moves an offset forward, and everything
+// is freed at once by rewinding to an earlier marker (or resetting).
+// Blocks are kept when rewound, so once the arena has grown to what a step
+// needs it stops touching the heap.
+//
+// Nothing is constructed or destroyed: only for trivially destructible
+// types, and the memory starts uninitialised.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+
+    template <typename T>
+    T *Allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "the arena never runs destructors");
+        return static_cast<T *>(AllocateBytes(count * sizeof(T), alignof(T)));
+    }
+
+    struct Marker
+    {
+        size_t block = 0;
+        size_t offset = 0;
+    };
+
+    // Everything allocated after GetMarker is freed by Rewind
+    Marker GetMarker() const { return {currentBlock, offset}; }
+    void Rewind(Marker marker)
+    {
+        currentBlock = marker.block;
+        offset = marker.offset;
+    }
+    void Reset() { Rewind(Marker()); }
+
+    // Bytes held, used or not
+    size_t GetCapacity() const;
+
+private:
+    void *AllocateBytes(size_t size, size_t alignment);
+
+    struct Block
+    {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+
+    size_t blockSize;
+    std::vector<Block> blocks;
+    size_t currentBlock = 0;
+    size_t offset = 0;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+// Batch integration kernels.
+// Semi-implicit Euler over structure-of-arrays state, one axis at a time:
+//
+//     velocity += (acceleration + force * inverseMass) * dt
+//     position += velocity * dt
+//
+// Entries with inverseMass == 0 (static objects) are left untouched. The SIMD
+// kernels handle them by masking instead of branching, and perform exactly the
+// same float operations in the same order as the scalar kernel, so every
+// backend produces bit-for-bit identical results.
+namespace Integrator
+{
+    enum class Backend
+    {
+        Scalar,
+        SSE,
+        AVX2
+    };
+
+    // The best backend this CPU supports (checked once with CPUID)
+    Backend DetectBackend();
+
+    // The backend used by IntegrateAxis. Defaults to DetectBackend(); set it to
+    // Scalar to validate the SIMD paths against the reference loop.
+    Backend GetBackend();
+    void SetBackend(Backend backend);
+    const char *GetBackendName(Backend backend);
+
+    // Integrates count entries of one axis. For a body's angle, pass the torques
+    // as force, the inverse inertias as inverseMass and 0 as acceleration.
+    void IntegrateAxis(float *position, float *velocity, const float *force, const float *inverseMass,
+                       float acceleration, float dt, size_t count);
+} // namespace Integrator
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Broadphase.h>
+#include <cstddef>
+#include <vector>
+
+// Splits the bodies into islands: groups of dynamic bodies connected by
+// touching contacts. Two islands never write to the same body, so they can
+// be solved in parallel. Static bodies do not join islands (nothing ever
+// writes to them), which keeps two boxes resting on the same floor apart.
+// Any body passed with a zero inverse mass counts as static here; the World
+// uses this to leave sleeping bodies out.
+//
+// The result only depends on the body count and the contact list, never on
+// thread timing: islands are numbered by their lowest body index, and each
+// island keeps its contacts in the original pair order.
+class IslandBuilder
+{
+public:
+    // touching[k] tells whether pairs[k] is an actual contact
+    void Build(size_t bodyCount, const std::vector<float> &inverseMasses,
+               const std::vector<BroadphasePair> &pairs, const std::vector<char> &touching);
+
+    size_t GetIslandCount() const { return islandBodyStarts.empty() ? 0 : islandBodyStarts.size() - 1; }
+
+    // Island of a body, or -1 for static (and sleeping) bodies
+    int GetIsland(size_t body) const { return bodyIslands[body]; }
+
+    // Bodies of island i are islandBodies[islandBodyStarts[i] .. islandBodyStarts[i + 1])
+    std::vector<int> islandBodyStarts;
+    std::vector<int> islandBodies;
+
+    // Contacts (indices into pairs) of island i are
+    // islandContacts[islandContactStarts[i] .. islandContactStarts[i + 1])
+    std::vector<int> islandContactStarts;
+    std::vector<int> islandContacts;
+
+private:
+    int FindRoot(int body);
+
+    std::vector<int> parents;
+    std::vector<int> bodyIslands;
+    std::vector<int> cursor;
+};
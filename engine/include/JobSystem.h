@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// A fixed pool of worker threads with one work-stealing deque per thread.
+// Work is submitted as ParallelFor batches: the range is cut into chunks that
+// are spread over the deques. Each thread pops chunks from the back of its own
+// deque, and steals from the front of the others' when it runs dry, so uneven
+// chunks (big islands next to tiny ones) still keep every core busy.
+//
+// The thread that calls ParallelFor works on the batch too and only returns
+// once every chunk is done. With a thread count of 1 there are no workers and
+// ParallelFor simply runs the chunks in order on the calling thread.
+class JobSystem
+{
+public:
+    // threadCount includes the calling thread; 0 means one per hardware thread
+    explicit JobSystem(int threadCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    int GetThreadCount() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Stops the workers and starts threadCount - 1 new ones
+    void SetThreadCount(int threadCount);
+
+    // Calls fn(begin, end) for consecutive chunks of at most grainSize items
+    // covering [0, count). Chunks may run on any thread and in any order, so fn
+    // must only write data that belongs to its own chunk.
+    template <typename Fn>
+    void ParallelFor(size_t count, size_t grainSize, Fn &&fn)
+    {
+        if (count == 0)
+            return;
+        if (grainSize == 0)
+            grainSize = 1;
+
+        if (workers.empty() || count <= grainSize)
+        {
+            for (size_t begin = 0; begin < count; begin += grainSize)
+                fn(begin, begin + grainSize < count ? begin + grainSize : count);
+            return;
+        }
+
+        Batch batch;
+        batch.context = &fn;
+        batch.run = [](void *context, size_t begin, size_t end)
+        { (*static_cast<std::remove_reference_t<Fn> *>(context))(begin, end); };
+        Run(batch, count, grainSize);
+    }
+
+private:
+    struct Batch
+    {
+        void *context = nullptr;
+        void (*run)(void *context, size_t begin, size_t end) = nullptr;
+        std::atomic<size_t> remaining{0};
+    };
+
+    struct Job
+    {
+        Batch *batch;
+        size_t begin;
+        size_t end;
+    };
+
+    // A ring buffer of jobs, used as a deque: the owner pushes and pops at
+    // the back, thieves take from the front. The storage is allocated up
+    // front and only grows when a batch deals out more jobs than fit, so a
+    // warm step does not allocate. Guarded by mutex.
+    struct Queue
+    {
+        std::mutex mutex;
+        std::vector<Job> jobs; // Capacity is a power of two
+        size_t head = 0;       // Index of the front job
+        size_t count = 0;
+
+        Queue() : jobs(64) {}
+        void PushBack(const Job &job);
+        Job PopBack();
+        Job PopFront();
+    };
+
+    void Run(Batch &batch, size_t count, size_t grainSize);
+    void StartWorkers(int threadCount);
+    void StopWorkers();
+    void WorkerLoop(size_t queueIndex);
+    bool PopOrSteal(size_t queueIndex, Job &job);
+    void Execute(const Job &job);
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue>> queues; // queues[0] belongs to the calling thread
+
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    std::atomic<size_t> pendingJobs{0};
+    bool stopping = false;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Hands out objects of one type from blocks of blockSize, instead of one heap
+// allocation each.
+//
+// Released objects are not destroyed: they wait on a free list, and the next
+// Create assigns the new value over one of them. Members that own memory
+// (the world vertices of a polygon, say) keep it, so creating and destroying
+// the same kinds of objects over and over stops touching the heap once the
+// pool has grown to the largest number alive at once. Objects never move:
+// pointers stay valid until the object is released.
+template <typename T, size_t blockSize = 256>
+class ObjectPool
+{
+public:
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    ~ObjectPool()
+    {
+        for (size_t i = 0; i < constructedCount; ++i)
+        {
+            std::destroy_at(GetObject(i));
+        }
+    }
+
+    T *Create(const T &value)
+    {
+        ++liveCount;
+        if (!freeList.empty())
+        {
+            T *object = freeList.back();
+            freeList.pop_back();
+            *object = value;
+            return object;
+        }
+        if (constructedCount == blocks.size() * blockSize)
+        {
+            blocks.push_back(std::make_unique<Block>());
+        }
+        return std::construct_at(GetObject(constructedCount++), value);
+    }
+
+    void Release(T *object)
+    {
+        freeList.push_back(object);
+        --liveCount;
+    }
+
+    // Makes room for count live objects without further allocations, except
+    // for what the objects themselves allocate when first constructed
+    void Reserve(size_t count)
+    {
+        while (blocks.size() * blockSize < count)
+        {
+            blocks.push_back(std::make_unique<Block>());
+        }
+        freeList.reserve(count);
+    }
+
+    size_t GetLiveCount() const { return liveCount; }
+    size_t GetFreeCount() const { return freeList.size(); }
+
+private:
+    // Raw storage: objects are constructed in it on first use
+    struct Block
+    {
+        alignas(T) unsigned char storage[sizeof(T) * blockSize];
+    };
+
+    T *GetObject(size_t i) const
+    {
+        return std::launder(reinterpret_cast<T *>(blocks[i / blockSize]->storage + (i % blockSize) * sizeof(T)));
+    }
+
+    std::vector<std::unique_ptr<Block>> blocks;
+    size_t constructedCount = 0;
+    size_t liveCount = 0;
+    std::vector<T *> freeList;
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <AABB.h>
+#include <BarnesHut.h>
+#include <ConstraintNetwork.h>
+#include <JobSystem.h>
+#include <Profiler.h>
+#include <Snapshot.h>
+#include <Vec2.h>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Emits particles from a box at a steady rate
+struct ParticleEmitter
+{
+    AABB region;            // Particles appear anywhere in here
+    Vec2 velocity;          // Starting velocity...
+    float spread = 0.0f;    // ...plus up to this much in any direction
+    float rate = 0.0f;      // Particles per second
+    float lifetime = 1.0f;  // Seconds before a particle is removed
+    float mass = 1.0f;
+    bool enabled = true;
+
+    float pending = 0.0f; // Fraction of a particle carried over to the next step
+};
+
+// Pulls the particles inside a region towards the wind velocity, with a
+// force of strength * (windVelocity - particleVelocity)
+struct WindField
+{
+    AABB region;
+    Vec2 velocity;
+    float strength;
+};
+
+// Owns a large number of particles, stored as a structure of arrays like the
+// bodies of a World.
+//
+// Forces are applied as batch passes over the whole arrays, one kind of force
+// at a time: weight becomes the acceleration handed to the integrator (no
+// 1 / inverseMass per particle), drag is -k |v| v (no normalize), then the
+// wind fields, the links between particles and the attraction between them.
+// Integration uses the same SIMD kernels as the World.
+//
+// Dead particles keep their slot with an inverse mass of 0, so every pass
+// skips them without a branch; their slots go on a free list and are handed
+// out again by the next Spawn. Particle indices are stable while a particle
+// lives. Killing a particle removes its links.
+class ParticleSystem
+{
+public:
+    static constexpr float forever = std::numeric_limits<float>::infinity();
+
+    ParticleSystem();
+
+    // Returns the index of the new particle. A mass of 0 pins it in place.
+    std::uint32_t Spawn(const Vec2 &position, const Vec2 &velocity, float mass, float lifetime = forever);
+    void Kill(std::uint32_t index);
+    bool IsAlive(std::uint32_t index) const { return alive[index] != 0; }
+
+    // Live particles, and live plus free slots
+    size_t GetParticleCount() const { return aliveCount; }
+    size_t GetCapacity() const { return positionX.size(); }
+    void Reserve(size_t capacity);
+
+    Vec2 GetPosition(std::uint32_t index) const { return Vec2(positionX[index], positionY[index]); }
+    Vec2 GetVelocity(std::uint32_t index) const { return Vec2(velocityX[index], velocityY[index]); }
+    void AddForce(std::uint32_t index, const Vec2 &force)
+    {
+        forceX[index] += force.x;
+        forceY[index] += force.y;
+    }
+
+    void AddEmitter(const ParticleEmitter &emitter) { emitters.push_back(emitter); }
+    // A spring or distance constraint, depending on links.solver
+    void AddSpring(std::uint32_t a, std::uint32_t b, float restLength, float stiffness)
+    {
+        links.AddLink(a, b, restLength, stiffness);
+    }
+    void AddWind(const WindField &wind) { winds.push_back(wind); }
+
+    // Snapshots of the whole state, like World::Save and World::Restore:
+    // particles, free slots, emitters, wind fields, links, settings and the
+    // random engine of the emitters
+    void Save(Snapshot &snapshot) const;
+    bool Restore(const SnapshotReader &reader);
+
+    // Same as World::ComputeStateHash: positions, velocities and ages
+    std::uint64_t ComputeStateHash() const;
+
+    // Same as World::SetThreadCount
+    void SetThreadCount(int threadCount) { jobSystem->SetThreadCount(threadCount); }
+    int GetThreadCount() const { return jobSystem->GetThreadCount(); }
+
+    // Advances every particle by dt seconds
+    void Step(float dt);
+
+    // Same as World::GetProfiler: one frame per Step, one scope per phase,
+    // and the particle and link counts
+    Profiler &GetProfiler() { return profiler; }
+
+    // The phases of Step, public so tools can drive and time them one by one
+    void Emit(float dt);
+    void ApplyForces();
+    void ApplySprings();
+    void ApplyAttraction();
+    void Integrate(float dt);
+    void Age(float dt);
+
+    // Weight, as an acceleration (pixels/s^2, +y is down)
+    Vec2 gravity = Vec2(0.0f, 980.0f);
+    // Drag coefficient k of the -k |v| v drag force
+    float drag = 0.0f;
+    // Gravitational attraction between the particles, through a Barnes-Hut
+    // tree with this opening angle (see BarnesHutTree). 0 turns it off.
+    float gravitationalConstant = 0.0f;
+    float openingAngle = 0.5f;
+
+    std::vector<ParticleEmitter> emitters;
+    ConstraintNetwork links;
+    std::vector<WindField> winds;
+
+    // Particle state, one entry per slot
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> velocityX;
+    std::vector<float> velocityY;
+    std::vector<float> forceX;
+    std::vector<float> forceY;
+    std::vector<float> inverseMasses; // 0 for pinned and dead particles
+    std::vector<float> ages;          // Seconds since spawned
+    std::vector<float> lifetimes;
+
+private:
+    std::vector<char> alive;
+    size_t aliveCount = 0;
+    std::vector<std::uint32_t> freeSlots;
+
+    void SolveConstraints(float dt);
+
+    // Positions before the substep, for the velocities after an XPBD solve
+    std::vector<float> previousX;
+    std::vector<float> previousY;
+
+    BarnesHutTree attractionTree;
+    Profiler profiler;
+
+    std::unique_ptr<JobSystem> jobSystem;
+    std::minstd_rand random;
+};
@@ -1,35 +1,180 @@
 #pragma once
 #include <Shape.h>
 #include <Vec2.h>
+#include <Transform.h>
+#include <bit>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
+// The part of a polygon that never changes: its outline in body space.
+// Every body with the same outline can share one (see ShapeRegistry).
+struct PolygonGeometry
+{
+    std::vector<Vec2> vertices;
+    // Outward unit normal of each edge: normal i belongs to the edge from
+    // vertex i to vertex i + 1
+    std::vector<Vec2> normals;
+    // Of the vertices, to find equal geometries quickly
+    std::uint64_t hash = 0;
+
+    explicit PolygonGeometry(const std::vector<Vec2> &vertices) : vertices(vertices), hash(Hash(vertices))
+    {
+        // The vertices may wind either way; the sign of the area tells which
+        // side of an edge is the outside
+        float doubleArea = 0.0f;
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            doubleArea += vertices[i].Cross(vertices[(i + 1) % vertices.size()]);
+        }
+        const float side = doubleArea >= 0.0f ? 1.0f : -1.0f;
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            const Vec2 edge = vertices[(i + 1) % vertices.size()] - vertices[i];
+            normals.push_back(Vec2(edge.y, -edge.x).Normalized() * side);
+        }
+    }
+
+    // FNV-1a over the bits of the coordinates
+    static std::uint64_t Hash(const std::vector<Vec2> &vertices)
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (const Vec2 &vertex : vertices)
+        {
+            for (float coordinate : {vertex.x, vertex.y})
+            {
+                hash ^= std::bit_cast<std::uint32_t>(coordinate);
+                hash *= 1099511628211ull;
+            }
+        }
+        return hash;
+    }
+};
+
+// A polygon body's shape: a shared, immutable geometry, and the world
+// vertices and normals of this body, moved with it every step.
+// Copying one shares the geometry; only the world arrays are copied.
 class PolygonShape : public Shape
 {
 public:
-    std::vector<Vec2> localVertices;
+    std::shared_ptr<const PolygonGeometry> geometry;
     std::vector<Vec2> worldVertices;
+    std::vector<Vec2> worldNormals;
 
     PolygonShape(const std::vector<Vec2> &vertices, float mass)
+        : PolygonShape(std::make_shared<const PolygonGeometry>(vertices), mass)
+    {
+    }
+
+    PolygonShape(std::shared_ptr<const PolygonGeometry> geometry, float mass)
+        : Shape(POLYGON), geometry(std::move(geometry))
     {
         this->mass = mass;
-        localVertices = vertices;
+        // Sized once here; from now on the world vertices are only overwritten
+        worldVertices.resize(GetLocalVertices().size());
+        worldNormals.resize(GetLocalVertices().size());
     }
 
-    float GetMomentOfInertia() const override
+    const std::vector<Vec2> &GetLocalVertices() const { return geometry->vertices; }
+    const std::vector<Vec2> &GetLocalNormals() const { return geometry->normals; }
+
+    // Transforms the local vertices and normals into the preallocated world ones
+    void UpdateWorldVertices(const Transform &transform) override
     {
-        // For simplicity, we'll approximate the moment of inertia for a box.
-        // A more accurate calculation would involve complex polygon integration.
-        // Let's assume the vertices define a box-like shape.
-        return 100000.0f; // A placeholder value.
+        const Vec2 *localVertices = geometry->vertices.data();
+        const Vec2 *localNormals = geometry->normals.data();
+        Vec2 *vertices = worldVertices.data();
+        Vec2 *normals = worldNormals.data();
+        const size_t count = worldVertices.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            vertices[i] = transform.Apply(localVertices[i]);
+            normals[i] = transform.Rotate(localNormals[i]);
+        }
     }
 
-    Type GetType() const override
+    // Index of the world vertex furthest along direction (the support point).
+    // Around a convex polygon the dot product with a direction rises once and
+    // falls once, so instead of testing every vertex this climbs from start
+    // to the nearest neighbour that is further along, until neither is.
+    // Starting next to the answer (the last support point, say) costs only a
+    // couple of dot products, whatever the vertex count.
+    int FindSupport(const Vec2 &direction, int start = 0) const
+    {
+        const int count = static_cast<int>(worldVertices.size());
+        if (count <= 8)
+        {
+            // Few enough vertices that testing them all is cheaper than climbing
+            int best = 0;
+            float bestDot = direction.Dot(worldVertices[0]);
+            for (int i = 1; i < count; ++i)
+            {
+                const float dot = direction.Dot(worldVertices[i]);
+                if (dot > bestDot)
+                {
+                    best = i;
+                    bestDot = dot;
+                }
+            }
+            return best;
+        }
+
+        int best = start;
+        float bestDot = direction.Dot(worldVertices[best]);
+
+        // Pick the uphill side first, then keep walking that way
+        int step = 1;
+        const float nextDot = direction.Dot(worldVertices[(best + 1) % count]);
+        const float previousDot = direction.Dot(worldVertices[(best + count - 1) % count]);
+        if (previousDot > nextDot)
+        {
+            step = count - 1;
+        }
+        for (int i = 1; i < count; ++i)
+        {
+            const int candidate = (best + step) % count;
+            const float dot = direction.Dot(worldVertices[candidate]);
+            if (dot <= bestDot)
+            {
+                break;
+            }
+            best = candidate;
+            bestDot = dot;
+        }
+        return best;
+    }
+
+    // The core of a polygon is its world vertices, which already include the
+    // body position
+    int GetVertexCount() const override { return static_cast<int>(worldVertices.size()); }
+    Vec2 GetVertex(int index, const Vec2 &) const override { return worldVertices[index]; }
+    int GetSupport(const Vec2 &direction, const Vec2 &) const override { return FindSupport(direction); }
+
+    // Moment of inertia about the body position (the local origin), for a
+    // polygon of uniform density: the sum over the triangles the origin makes
+    // with each edge.
+    float GetMomentOfInertia() const
     {
-        return POLYGON;
+        const std::vector<Vec2> &localVertices = geometry->vertices;
+        float numerator = 0.0f;
+        float denominator = 0.0f;
+        for (size_t i = 0; i < localVertices.size(); ++i)
+        {
+            const Vec2 &a = localVertices[i];
+            const Vec2 &b = localVertices[(i + 1) % localVertices.size()];
+            const float cross = a.Cross(b);
+            numerator += cross * (a.Dot(a) + a.Dot(b) + b.Dot(b));
+            denominator += cross;
+        }
+        if (denominator == 0.0f)
+        {
+            return 0.0f;
+        }
+        return mass * numerator / (6.0f * denominator);
     }
 
     std::unique_ptr<Shape> Clone() const override
     {
-        return std::make_unique<PolygonShape>(localVertices, mass);
+        return std::make_unique<PolygonShape>(*this);
     }
 };
\ No newline at end of file
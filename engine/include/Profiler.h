@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Set by the ENGINE_PROFILING CMake option. With it off, the ENGINE_PROFILE_*
+// macros below expand to nothing: no clock reads, and the counter values are
+// not even computed.
+#ifndef ENGINE_PROFILING
+#define ENGINE_PROFILING 1
+#endif
+
+// One timed scope of a frame. Times are in nanoseconds since the profiler
+// was created.
+struct ProfileScope
+{
+    const char *name;
+    std::int64_t start;
+    std::int64_t duration;
+    int depth; // 0 for the outermost scopes of the frame
+};
+
+struct ProfileCounter
+{
+    const char *name;
+    std::int64_t value;
+};
+
+// Everything recorded between BeginFrame and EndFrame, usually one step
+struct ProfileFrame
+{
+    std::uint64_t index = 0;
+    std::int64_t start = 0;
+    std::int64_t duration = 0;
+    std::vector<ProfileScope> scopes; // In the order they were opened
+    std::vector<ProfileCounter> counters;
+
+    // Nanoseconds spent in the scopes with this name, 0 if there were none
+    std::int64_t GetScopeTime(const char *name) const;
+    // Value of a counter, or fallback if it was not set this frame
+    std::int64_t GetCounter(const char *name, std::int64_t fallback = 0) const;
+};
+
+// Records where the time of each frame goes: scoped timers, and counters
+// such as how many pairs were tested. The last few frames are kept in a ring
+// buffer that tools read back, or export as a Chrome trace.
+//
+// Scope and counter names must be string literals (or otherwise outlive the
+// profiler): only the pointers are stored. Once the ring buffer has wrapped
+// around, a frame allocates nothing. Not thread safe: open scopes from the
+// thread that runs the frame, around the parallel passes rather than inside
+// them.
+class Profiler
+{
+public:
+    explicit Profiler(size_t frameCapacity = 300);
+
+    // Recording can also be paused at run time; scopes then cost one branch
+    bool enabled = true;
+
+    void BeginFrame();
+    void EndFrame();
+    void BeginScope(const char *name);
+    void EndScope();
+    // Ignored outside a frame. Setting a counter twice keeps the last value.
+    void SetCounter(const char *name, std::int64_t value);
+
+    // Source of an "allocations" counter: the number of heap allocations made
+    // so far, e.g. from a counting operator new. The profiler records how
+    // much it grew during each frame. Null (the default) records nothing.
+    using AllocationCounter = long long (*)();
+    void SetAllocationCounter(AllocationCounter counter) { allocationCounter = counter; }
+
+    // Completed frames held in the ring buffer; age 0 is the latest
+    size_t GetFrameCount() const;
+    const ProfileFrame &GetFrame(size_t age) const;
+    void Clear();
+
+    // Writes the frames held as Chrome trace events (JSON), for
+    // chrome://tracing or https://ui.perfetto.dev. Returns false if the
+    // file could not be written.
+    bool ExportChromeTrace(const char *path) const;
+
+private:
+    std::int64_t Now() const;
+
+    std::vector<ProfileFrame> frames;
+    std::uint64_t frameCount = 0; // Completed frames since the last Clear
+    bool recording = false;       // Between BeginFrame and EndFrame
+    std::vector<size_t> openScopes;
+    AllocationCounter allocationCounter = nullptr;
+    long long allocationsAtBegin = 0;
+    std::int64_t epoch;
+};
+
+// Times the enclosing C++ scope
+class ProfileScopeTimer
+{
+public:
+    ProfileScopeTimer(Profiler &profiler, const char *name) : profiler(profiler) { profiler.BeginScope(name); }
+    ~ProfileScopeTimer() { profiler.EndScope(); }
+    ProfileScopeTimer(const ProfileScopeTimer &) = delete;
+    ProfileScopeTimer &operator=(const ProfileScopeTimer &) = delete;
+
+private:
+    Profiler &profiler;
+};
+
+// Records the enclosing C++ scope as one frame
+class ProfileFrameTimer
+{
+public:
+    explicit ProfileFrameTimer(Profiler &profiler) : profiler(profiler) { profiler.BeginFrame(); }
+    ~ProfileFrameTimer() { profiler.EndFrame(); }
+    ProfileFrameTimer(const ProfileFrameTimer &) = delete;
+    ProfileFrameTimer &operator=(const ProfileFrameTimer &) = delete;
+
+private:
+    Profiler &profiler;
+};
+
+#define ENGINE_PROFILE_CONCAT_INNER(a, b) a##b
+#define ENGINE_PROFILE_CONCAT(a, b) ENGINE_PROFILE_CONCAT_INNER(a, b)
+
+#if ENGINE_PROFILING
+#define ENGINE_PROFILE_FRAME(profiler) ProfileFrameTimer ENGINE_PROFILE_CONCAT(profileFrame, __LINE__)(profiler)
+#define ENGINE_PROFILE_SCOPE(profiler, name) ProfileScopeTimer ENGINE_PROFILE_CONCAT(profileScope, __LINE__)(profiler, name)
+#define ENGINE_PROFILE_COUNTER(profiler, name, value) \
+    do                                                \
+    {                                                 \
+        if ((profiler).enabled)                       \
+        {                                             \
+            (profiler).SetCounter(name, value);       \
+        }                                             \
+    } while (0)
+#else
+#define ENGINE_PROFILE_FRAME(profiler) ((void)0)
+#define ENGINE_PROFILE_SCOPE(profiler, name) ((void)0)
+#define ENGINE_PROFILE_COUNTER(profiler, name, value) ((void)0)
+#endif
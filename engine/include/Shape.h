@@ -1,4 +1,6 @@
 #pragma once
+#include <Transform.h>
+#include <Vec2.h>
 #include <memory>
 
 // Forward declare the Body class
@@ -10,17 +12,44 @@ public:
     enum Type
     {
         CIRCLE,
-        POLYGON
+        POLYGON,
+        TYPE_COUNT
     };
 
     virtual ~Shape() = default;
 
-    // Pure virtual functions that all derived shapes MUST implement
-    virtual float GetMomentOfInertia() const = 0;
-    virtual Type GetType() const = 0;
+    // The type is a tag stored in the shape rather than a virtual call: the
+    // narrow phase reads it for every pair, to pick its function from a table
+    // (see Collision::GetCollideFunction), and can then cast to the derived
+    // class without looking anything else up.
+    Type GetType() const { return type; }
+
+    // Dispatched on the type tag too, to the derived class's formula
+    float GetMomentOfInertia() const;
+
+    // Moves the shape's world space data (the world vertices of a polygon)
+    // to a body transform. Shapes without any have nothing to do.
+    virtual void UpdateWorldVertices(const Transform &) {}
+
+    // Support function for the GJK/EPA narrow phase (see Distance.h).
+    // GJK sees a shape as the convex hull of a few world space vertices
+    // (its core), grown by a radius: a circle is its centre grown by its
+    // radius, a polygon is its world vertices grown by nothing, and a
+    // capsule would be a segment grown by its radius.
+    virtual int GetVertexCount() const = 0;
+    virtual Vec2 GetVertex(int index, const Vec2 &position) const = 0;
+    // Index of the core vertex furthest along direction
+    virtual int GetSupport(const Vec2 &direction, const Vec2 &position) const = 0;
+    virtual float GetRadius() const { return 0.0f; }
 
     // The "virtual constructor" pattern is a very useful C++ trick
     virtual std::unique_ptr<Shape> Clone() const = 0;
 
     float mass; // The shape is responsible for its mass
+
+protected:
+    explicit Shape(Type type) : type(type) {}
+
+private:
+    Type type;
 };
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <PolygonShape.h>
+#include <Vec2.h>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Keeps one shared PolygonGeometry per distinct outline, so that a thousand
+// identical boxes reference a single set of local vertices and normals
+// instead of a thousand copies. A World interns the geometry of every polygon
+// body it creates; games can also build their shapes from here up front.
+//
+// Geometries are immutable, so sharing them is safe. They stay registered
+// until Prune or Release finds no shape using them any more; a World
+// releases the geometry of every polygon body it destroys.
+class ShapeRegistry
+{
+public:
+    // The geometry with exactly these vertices, created on first use
+    std::shared_ptr<const PolygonGeometry> GetPolygon(const std::vector<Vec2> &vertices);
+
+    // The registered geometry equal to this one. An unknown geometry is
+    // registered as it is.
+    std::shared_ptr<const PolygonGeometry> Intern(const std::shared_ptr<const PolygonGeometry> &geometry);
+
+    size_t GetPolygonCount() const { return polygons.size(); }
+
+    // Forgets the geometries only the registry still holds. Returns how many.
+    size_t Prune();
+    // Forgets geometry if only the registry and the caller still hold it.
+    // The same as Prune for one geometry, without walking them all.
+    void Release(const std::shared_ptr<const PolygonGeometry> &geometry);
+
+private:
+    // Keyed by PolygonGeometry::hash; equal hashes are told apart by vertices
+    std::unordered_multimap<std::uint64_t, std::shared_ptr<const PolygonGeometry>> polygons;
+};
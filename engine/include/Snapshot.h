@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Flat binary snapshots of a simulation (see World::Save and
+// ParticleSystem::Save), in memory or in a file.
+//
+// A snapshot is a header, the state as a list of raw arrays (sections), and
+// a table saying where each section starts:
+//
+//   SnapshotHeader     magic "P2DS", format version, kind, section count,
+//                      offset of the section table, total size
+//   section data       each section 16 byte aligned, exactly the bytes of
+//                      the array it was written from
+//   SnapshotSection[]  id, element size, offset and element count
+//
+// The arrays of a World are already flat (structure of arrays), so saving is
+// one memcpy per array and loading needs no parsing: a section can be used in
+// place, straight from a memory mapped file. Numbers are stored in the
+// machine's own layout, so a snapshot is meant to be read back by the same
+// build on the same kind of machine (checkpoints, forks, rollback), not as an
+// exchange format.
+struct SnapshotHeader
+{
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t kind; // SnapshotKind
+    std::uint32_t sectionCount;
+    std::uint64_t tableOffset;
+    std::uint64_t size;
+};
+
+struct SnapshotSection
+{
+    std::uint32_t id;
+    std::uint32_t elementSize;
+    std::uint64_t offset;
+    std::uint64_t count;
+};
+
+// FNV-1a over 32 bit words (and any bytes left over), continuing from hash.
+// For hashes of the simulation state: see World::ComputeStateHash.
+constexpr std::uint64_t stateHashSeed = 14695981039346656037ull;
+std::uint64_t HashStateBytes(const void *data, size_t size, std::uint64_t hash = stateHashSeed);
+
+template <typename T>
+std::uint64_t HashState(const std::vector<T> &array, std::uint64_t hash = stateHashSeed)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "hashes the bytes");
+    return HashStateBytes(array.data(), array.size() * sizeof(T), hash);
+}
+
+enum class SnapshotKind : std::uint32_t
+{
+    World = 1,
+    Particles = 2,
+};
+
+// The bytes of one snapshot, in the file format.
+// Saving into the same Snapshot again reuses its buffer, so a game that
+// keeps a rollback snapshot every frame does not allocate once it is warm.
+class Snapshot
+{
+public:
+    static constexpr std::uint32_t version = 1;
+
+    const unsigned char *GetData() const { return bytes.data(); }
+    size_t GetSize() const { return bytes.size(); }
+
+    bool SaveToFile(const char *path) const;
+
+    // Writing, for the Save functions of the simulation classes
+    void Begin(SnapshotKind kind);
+    template <typename T>
+    void Write(std::uint32_t id, const T *data, size_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "sections are raw bytes");
+        WriteBytes(id, sizeof(T), data, count);
+    }
+    template <typename T>
+    void Write(std::uint32_t id, const std::vector<T> &array)
+    {
+        Write(id, array.data(), array.size());
+    }
+    template <typename T>
+    void WriteValue(std::uint32_t id, const T &value)
+    {
+        Write(id, &value, 1);
+    }
+    // Adds a section of count elements and returns them to be filled in
+    // place. The pointer is only good until the next section is added.
+    template <typename T>
+    T *Add(std::uint32_t id, size_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "sections are raw bytes");
+        return static_cast<T *>(WriteBytes(id, sizeof(T), nullptr, count));
+    }
+    void End();
+
+private:
+    // Copies data in, unless it is null. Returns where the section starts.
+    void *WriteBytes(std::uint32_t id, size_t elementSize, const void *data, size_t count);
+
+    std::vector<unsigned char> bytes;
+    std::vector<SnapshotSection> sections;
+};
+
+// Reads the sections of a snapshot in place, from a Snapshot, a
+// MappedSnapshotFile or any other bytes. The bytes must outlive the reader.
+class SnapshotReader
+{
+public:
+    SnapshotReader(const unsigned char *data, size_t size);
+    explicit SnapshotReader(const Snapshot &snapshot) : SnapshotReader(snapshot.GetData(), snapshot.GetSize()) {}
+
+    // False if the bytes are not a snapshot of this version and kind, or are
+    // cut short or damaged
+    bool IsValid(SnapshotKind kind) const;
+
+    // The elements of a section, used in place. Null (and count 0) if the
+    // section is missing, holds another type or is not aligned for it (bytes
+    // that do not start on a 16 byte boundary).
+    template <typename T>
+    const T *Get(std::uint32_t id, size_t &count) const
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "sections are raw bytes");
+        const SnapshotSection *section = Find(id);
+        if (!section || section->elementSize != sizeof(T) ||
+            reinterpret_cast<std::uintptr_t>(data + section->offset) % alignof(T) != 0)
+        {
+            count = 0;
+            return nullptr;
+        }
+        count = static_cast<size_t>(section->count);
+        return reinterpret_cast<const T *>(data + section->offset);
+    }
+
+    // Copies a section into array, reusing its capacity
+    template <typename T>
+    bool Read(std::uint32_t id, std::vector<T> &array) const
+    {
+        size_t count;
+        const T *elements = Get<T>(id, count);
+        if (!elements)
+        {
+            return false;
+        }
+        array.resize(count);
+        if (count > 0)
+        {
+            std::memcpy(static_cast<void *>(array.data()), elements, count * sizeof(T));
+        }
+        return true;
+    }
+
+    template <typename T>
+    bool ReadValue(std::uint32_t id, T &value) const
+    {
+        size_t count;
+        const T *elements = Get<T>(id, count);
+        if (!elements || count != 1)
+        {
+            return false;
+        }
+        std::memcpy(static_cast<void *>(&value), elements, sizeof(T));
+        return true;
+    }
+
+private:
+    const SnapshotSection *Find(std::uint32_t id) const;
+
+    const unsigned char *data;
+    size_t size;
+};
+
+// A snapshot file mapped into memory (mmap), read only. Loading a snapshot
+// then costs what the restore copies out of it, not a read of the whole file
+// up front. Where mmap is not available the file is read into memory instead.
+class MappedSnapshotFile
+{
+public:
+    explicit MappedSnapshotFile(const char *path);
+    ~MappedSnapshotFile();
+    MappedSnapshotFile(const MappedSnapshotFile &) = delete;
+    MappedSnapshotFile &operator=(const MappedSnapshotFile &) = delete;
+
+    bool IsOpen() const { return data != nullptr; }
+    SnapshotReader GetReader() const { return SnapshotReader(data, size); }
+
+private:
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    std::vector<unsigned char> fallback; // The file's bytes, without mmap
+};
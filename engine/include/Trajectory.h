@@ -0,0 +1,243 @@
+#pragma once
+
+#include <DebugDraw.h>
+#include <Shape.h>
+#include <Vec2.h>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class World;
+struct PolygonGeometry;
+
+// Trajectory files: the position and angle of every body after every
+// recorded step, for offline analysis and replay.
+//
+//   TrajectoryFileHeader  magic "P2DT", format version, quantization steps,
+//                         time between frames
+//   chunks                a few dozen frames each, compressed
+//   shape table           every shape a recorded body had
+//   chunk index           first frame and file offset of each chunk
+//   TrajectoryFileFooter  where the shape table and index start, frame count
+//
+// A frame stores, for each body in World order, its slot (the stable part of
+// its BodyHandle), shape, static/awake flags and pose. Positions and angles
+// are quantized to fixed steps (TrajectorySettings) and predicted from the
+// frames before: while a body keeps its place in the arrays the stored value
+// is the error of a constant velocity guess, a small integer written as a
+// variable length number. The first frame of every chunk is predicted from
+// nothing (a keyframe), so a reader can start decoding at any chunk: seeking
+// to a frame decodes at most one chunk's worth of frames.
+//
+// The index and shape table are written last, when the recording is closed,
+// so a recording that was never closed cannot be read.
+struct TrajectoryFileHeader
+{
+    char magic[4];
+    std::uint32_t version;
+    float positionStep;
+    float angleStep;
+    float frameTime;
+    std::uint32_t reserved;
+};
+
+struct TrajectoryFileFooter
+{
+    std::uint64_t shapeTableOffset;
+    std::uint64_t indexOffset;
+    std::uint64_t frameCount;
+    std::uint32_t chunkCount;
+    char magic[4];
+};
+
+struct TrajectoryChunkEntry
+{
+    std::uint64_t firstFrame;
+    std::uint64_t offset;
+};
+
+struct TrajectorySettings
+{
+    float positionStep = 1.0f / 64.0f; // Pixels; the most a position is off by is half this
+    float angleStep = 1.0f / 4096.0f;  // Radians
+    float frameTime = 1.0f / 60.0f;    // Seconds between recorded frames, for playback
+    int framesPerChunk = 60;           // Frames between keyframes
+};
+
+// One decoded frame, in the World's body order at the time
+struct TrajectoryFrame
+{
+    enum Flags : std::uint8_t
+    {
+        STATIC = 1,
+        AWAKE = 2,
+    };
+
+    std::vector<std::uint32_t> slots;
+    std::vector<std::uint32_t> shapes; // Index into the shape table
+    std::vector<std::uint8_t> flags;
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> angles;
+
+    size_t GetBodyCount() const { return slots.size(); }
+};
+
+struct TrajectoryShape
+{
+    Shape::Type type;
+    float radius;               // Circles
+    std::vector<Vec2> vertices; // Polygons, local space
+    float extent = 0.0f;        // Furthest any point is from the body origin, for culling
+};
+
+// The frames the next frame is predicted from, by body index. Both ends of
+// the format keep one and update it the same way.
+struct TrajectoryHistory
+{
+    // [0] the last frame, [1] the one before. Indices without a body have
+    // slot invalidSlot.
+    std::vector<std::uint32_t> slots[2];
+    std::vector<std::int32_t> values[2][3]; // Quantized x, y and angle
+    std::vector<std::uint32_t> shapes;
+    std::vector<std::uint8_t> flags;
+
+    void Clear();
+};
+
+// Streams the bodies of a World to a trajectory file.
+// Record copies the frame into a buffer and returns; compressing and writing
+// happen on a background thread, one chunk at a time. The step loop only
+// ever waits for that thread in Close. If the disk falls behind, the frames
+// keep collecting in the current chunk until the thread is free to take it.
+class TrajectoryRecorder
+{
+public:
+    TrajectoryRecorder() = default;
+    ~TrajectoryRecorder();
+    TrajectoryRecorder(const TrajectoryRecorder &) = delete;
+    TrajectoryRecorder &operator=(const TrajectoryRecorder &) = delete;
+
+    bool Open(const char *path, const TrajectorySettings &settings = TrajectorySettings());
+    // Writes what is left, the shape table and the index. False if any
+    // write failed along the way.
+    bool Close();
+    bool IsOpen() const { return file != nullptr; }
+
+    // Appends the current state of world as the next frame
+    void Record(const World &world);
+
+    std::uint64_t GetFrameCount() const { return frameCount; }
+    // Bytes written to the file so far
+    std::uint64_t GetBytesWritten() const;
+
+private:
+    // Raw frames, as copied out of the World
+    struct Chunk
+    {
+        std::uint64_t firstFrame = 0;
+        std::vector<std::uint32_t> bodyCounts;
+        std::vector<std::uint32_t> slots;
+        std::vector<std::uint32_t> shapes;
+        std::vector<std::uint8_t> flags;
+        std::vector<float> positionX;
+        std::vector<float> positionY;
+        std::vector<float> angles;
+
+        void Clear();
+    };
+
+    // The shape id of each slot's current body, remembered by generation so
+    // a steady state frame does not look any shape up
+    struct SlotShape
+    {
+        std::uint32_t generation = 0;
+        std::uint32_t shape = 0;
+        bool known = false;
+    };
+
+    std::uint32_t FindShape(const Shape *shape);
+    void WriterLoop();
+    void Submit(); // Hands the front chunk to the writer, if it is idle
+
+    std::FILE *file = nullptr;
+    TrajectorySettings settings;
+    std::uint64_t frameCount = 0;
+
+    // Owned by the recording thread
+    Chunk front;
+    std::vector<SlotShape> slotShapes;
+    std::vector<TrajectoryShape> shapeTable;
+    std::unordered_map<const PolygonGeometry *, std::uint32_t> polygonShapes;
+    std::vector<std::shared_ptr<const PolygonGeometry>> geometries; // Keeps those addresses theirs
+    std::unordered_map<std::uint32_t, std::uint32_t> circleShapes; // By radius bits
+
+    // Shared with the writer thread
+    std::thread writer;
+    mutable std::mutex mutex;
+    std::condition_variable condition;
+    Chunk back;
+    bool backPending = false;
+    bool stopping = false;
+    bool writeFailed = false;
+    std::uint64_t bytesWritten = 0;
+    std::vector<TrajectoryChunkEntry> index;
+
+    // Owned by the writer thread
+    void Encode(const Chunk &chunk);
+    std::vector<unsigned char> encoded;
+    TrajectoryHistory history;
+};
+
+// Reads frames back from a trajectory file, in any order
+class TrajectoryReader
+{
+public:
+    TrajectoryReader() = default;
+    ~TrajectoryReader();
+    TrajectoryReader(const TrajectoryReader &) = delete;
+    TrajectoryReader &operator=(const TrajectoryReader &) = delete;
+
+    // False if the file is missing, not a finished recording, or damaged
+    bool Open(const char *path);
+    void Close();
+    bool IsOpen() const { return file != nullptr; }
+
+    std::uint64_t GetFrameCount() const { return frameCount; }
+    float GetFrameTime() const { return header.frameTime; }
+    const std::vector<TrajectoryShape> &GetShapes() const { return shapes; }
+
+    // Decodes frame into out. Reading the frame after the last one read is
+    // cheap; anything else decodes from the start of the frame's chunk.
+    bool ReadFrame(std::uint64_t frame, TrajectoryFrame &out);
+
+    // Draws a frame the way World::Draw draws bodies
+    void Draw(const TrajectoryFrame &frame, DebugDraw &draw) const;
+
+private:
+    bool LoadChunk(size_t chunk);
+    bool DecodeNext(TrajectoryFrame &out);
+
+    std::FILE *file = nullptr;
+    TrajectoryFileHeader header = {};
+    std::uint64_t frameCount = 0;
+    std::uint64_t shapeTableOffset = 0; // Where the last chunk ends
+    std::vector<TrajectoryChunkEntry> index;
+    std::vector<TrajectoryShape> shapes;
+
+    // Decoding position: the loaded chunk and the frame it decodes next
+    std::vector<unsigned char> chunkBytes;
+    size_t loadedChunk = SIZE_MAX;
+    size_t cursor = 0;
+    std::uint64_t nextFrame = 0;
+    std::uint64_t chunkEnd = 0;
+
+    TrajectoryHistory history;
+
+    mutable std::vector<Vec2> drawVertices;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Trig.h>
+#include <Vec2.h>
+
+// Position plus rotation, with the rotation stored as its cosine and sine.
+// Computing cos/sin once per body and step is enough to transform all of its
+// vertices, instead of once per vertex like Vec2::Rotated does.
+struct Transform
+{
+    Vec2 position;
+    float angle = 0.0f;
+    float c = 1.0f; // cos(angle)
+    float s = 0.0f; // sin(angle)
+
+    Transform() = default;
+    Transform(const Vec2 &position, float angle)
+        : position(position), angle(angle)
+    {
+        Trig::SinCos(angle, s, c);
+    }
+
+    // Moves the transform, recomputing cos/sin only if the angle changed.
+    // Returns false if nothing changed at all.
+    bool Set(const Vec2 &newPosition, float newAngle)
+    {
+        // Exact compares on purpose: any change must reach the vertices
+        const bool moved = newPosition.x != position.x || newPosition.y != position.y;
+        const bool rotated = newAngle != angle;
+        if (rotated)
+        {
+            angle = newAngle;
+            Trig::SinCos(newAngle, s, c);
+        }
+        position = newPosition;
+        return moved || rotated;
+    }
+
+    Vec2 Rotate(const Vec2 &v) const { return Vec2(v.x * c - v.y * s, v.x * s + v.y * c); }
+    Vec2 Apply(const Vec2 &v) const { return position + Rotate(v); }
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cmath>
+
+// Set by the ENGINE_DETERMINISTIC CMake option (see World.h for what the
+// deterministic mode covers).
+#ifndef ENGINE_DETERMINISTIC
+#define ENGINE_DETERMINISTIC 0
+#endif
+
+// Sine and cosine for the simulation.
+// std::sin and std::cos are not required to be correctly rounded, and the
+// standard libraries of different platforms (and versions) disagree in the
+// last bit. That is enough for two machines running the same steps to drift
+// apart. The deterministic mode uses SinCosPortable instead: a range
+// reduction and two polynomials made of nothing but float adds and
+// multiplies, which IEEE 754 defines to the bit, compiled without FMA
+// contraction.
+namespace Trig
+{
+    // Within about 1e-7 of the exact values for angles of a few thousand
+    // radians, a little less accurate beyond, and the same bits everywhere
+    void SinCosPortable(float angle, float &sine, float &cosine);
+
+    inline void SinCos(float angle, float &sine, float &cosine)
+    {
+#if ENGINE_DETERMINISTIC
+        SinCosPortable(angle, sine, cosine);
+#else
+        sine = std::sin(angle);
+        cosine = std::cos(angle);
+#endif
+    }
+} // namespace Trig
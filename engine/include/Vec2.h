@@ -1,5 +1,6 @@
 #pragma once
 
+#include <Trig.h>
 #include <cmath>
 #include <iostream>
 
@@ -82,8 +83,8 @@ struct Vec2
     // Rotate the vector by an angle in radians
     void Rotate(float angleRadians)
     {
-        const float cosAngle = std::cos(angleRadians);
-        const float sinAngle = std::sin(angleRadians);
+        float sinAngle, cosAngle;
+        Trig::SinCos(angleRadians, sinAngle, cosAngle);
         const float newX = x * cosAngle - y * sinAngle;
         const float newY = x * sinAngle + y * cosAngle;
         x = newX;
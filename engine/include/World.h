@@ -0,0 +1,381 @@
+#pragma once
+
+#include <AABB.h>
+#include <Broadphase.h>
+#include <CircleShape.h>
+#include <Collision.h>
+#include <ContactSolver.h>
+#include <DebugDraw.h>
+#include <FrameArena.h>
+#include <Island.h>
+#include <JobSystem.h>
+#include <ObjectPool.h>
+#include <PolygonShape.h>
+#include <Profiler.h>
+#include <Shape.h>
+#include <ShapeRegistry.h>
+#include <Snapshot.h>
+#include <Transform.h>
+#include <Vec2.h>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class World;
+class TrajectoryRecorder;
+
+// A stable reference to a body in a World.
+// Bodies move around inside the World's arrays when other bodies are
+// destroyed; a handle keeps pointing at the same body, and stops being valid
+// once that body is destroyed (the generation no longer matches).
+struct BodyHandle
+{
+    static constexpr std::uint32_t invalidSlot = 0xFFFFFFFFu;
+
+    std::uint32_t slot = invalidSlot;
+    std::uint32_t generation = 0;
+
+    bool operator==(const BodyHandle &other) const { return slot == other.slot && generation == other.generation; }
+    bool operator!=(const BodyHandle &other) const { return !(*this == other); }
+};
+
+// A short-lived view of one body, with the same feel as the Body class.
+// Do not keep a BodyRef across CreateBody/DestroyBody calls; keep the
+// BodyHandle instead and ask the World for a fresh BodyRef.
+// Setting the state or adding a force through a BodyRef wakes the body up.
+class BodyRef
+{
+public:
+    BodyRef(World *world, size_t index) : world(world), index(index) {}
+
+    Vec2 GetPosition() const;
+    void SetPosition(const Vec2 &position);
+    Vec2 GetVelocity() const;
+    void SetVelocity(const Vec2 &velocity);
+    float GetAngle() const;
+    void SetAngle(float angle);
+    float GetAngularVelocity() const;
+    void SetAngularVelocity(float angularVelocity);
+
+    float GetInverseMass() const;
+    float GetInverseInertia() const;
+    bool IsStatic() const { return GetInverseMass() == 0.0f; }
+
+    Shape &GetShape() const;
+    Shape::Type GetShapeType() const;
+
+    void AddForce(const Vec2 &force);
+    void AddTorque(float torque);
+
+    bool IsAwake() const;
+    void SetAwake(bool awake);
+
+    bool IsBullet() const;
+    void SetBullet(bool bullet);
+
+    BodyHandle GetHandle() const;
+    size_t GetIndex() const { return index; }
+
+private:
+    World *world;
+    size_t index;
+};
+
+// Owns every body of a simulation.
+// Body state is stored as a structure of arrays: all x positions are next to
+// each other, then all y positions, and so on. The passes of a step
+// (integration, vertex transforms, collision) walk these arrays front to back
+// instead of chasing one heap pointer per body.
+class World
+{
+public:
+    // Steps on threadCount threads (see SetThreadCount); 0 uses every
+    // hardware thread
+    explicit World(int threadCount = 0);
+
+    // The World keeps its own copy of shape, from a pool. Polygon bodies
+    // with the same outline share one geometry from the shape registry.
+    BodyHandle CreateBody(const Shape &shape, float x, float y);
+    void DestroyBody(BodyHandle handle);
+    // Destroys many bodies at once, in about the time of a single
+    // DestroyBody. Invalid and repeated handles are skipped.
+    void DestroyBodies(const std::vector<BodyHandle> &handles);
+    bool IsValid(BodyHandle handle) const;
+
+    BodyRef GetBody(BodyHandle handle) { return BodyRef(this, GetIndex(handle)); }
+    BodyRef GetBodyAt(size_t index) { return BodyRef(this, index); }
+    size_t GetIndex(BodyHandle handle) const { return slots[handle.slot].index; }
+    BodyHandle GetHandle(size_t index) const;
+    size_t GetBodyCount() const { return shapes.size(); }
+
+    // Makes room for bodyCount bodies, so that creating them does not grow
+    // any array. Destroyed bodies leave their room (and their shape) behind
+    // for the next ones: a world that spawns and destroys bodies at a steady
+    // rate stops allocating once it has reached its largest body count.
+    void Reserve(size_t bodyCount);
+
+    ShapeRegistry &GetShapeRegistry() { return shapeRegistry; }
+
+    // Snapshots of the whole state: every body, its shape, the contact cache
+    // and the settings. Restoring one and stepping gives exactly the same
+    // results as stepping the world it was saved from. Restore returns false,
+    // leaving the world untouched, if the snapshot is not a valid World
+    // snapshot. Handles saved with the state stay valid after a restore.
+    // The broadphase kind and the thread count are not part of it.
+    void Save(Snapshot &snapshot) const;
+    bool Restore(const SnapshotReader &reader);
+
+    // An independent copy of the world, e.g. to try a move and throw it away.
+    // Copies the arrays directly, without going through a snapshot.
+    std::unique_ptr<World> Clone() const;
+
+    // Scratch memory for data that only lives until the next step, reset at
+    // the start of each Step
+    FrameArena &GetFrameArena() { return frameArena; }
+
+    // Replaces the broadphase (a BruteForceBroadphase gives the all-pairs path)
+    void SetBroadphase(std::unique_ptr<Broadphase> newBroadphase);
+    Broadphase &GetBroadphase() { return *broadphase; }
+
+    // Determinism. Stepping the same world the same way always gives the same
+    // bits, for any thread count and broadphase: pairs come out of the
+    // broadphase sorted, and every pass visits them, the islands and the
+    // bodies in that order. Across compilers, standard libraries and CPUs the
+    // default build can still drift by the last bit: std::sin/std::cos
+    // differ between libraries, and a compiler may fuse a multiply and an
+    // add into one FMA. The ENGINE_DETERMINISTIC CMake option turns that off
+    // (portable sin/cos from Trig.h, no FMA contraction, SSE2 floats on
+    // 32 bit x86), so that lockstep peers only need to exchange inputs, and
+    // compare state hashes to detect a desync.
+    //
+    // A hash of the body state: positions, velocities, angles, sleep state.
+    // Equal hashes step after step mean the runs are (all but surely)
+    // identical.
+    std::uint64_t ComputeStateHash() const;
+    // When set, each Step ends by hashing the state, read by GetStateHash
+    bool hashEachStep = false;
+    std::uint64_t GetStateHash() const { return stateHash; }
+
+    // When set, each Step ends by appending the bodies to this recording
+    // (see Trajectory.h). The World does not own it, and a Clone does not
+    // record.
+    TrajectoryRecorder *recorder = nullptr;
+
+    // Number of threads a step runs on, including the calling thread.
+    // 1 runs everything on the calling thread. The results are the same
+    // for every thread count.
+    void SetThreadCount(int threadCount) { jobSystem->SetThreadCount(threadCount); }
+    int GetThreadCount() const { return jobSystem->GetThreadCount(); }
+    JobSystem &GetJobSystem() { return *jobSystem; }
+
+    // Each Step is recorded as a profiler frame: one scope per phase, and
+    // counters for the bodies, bodies awake, pairs, pairs tested, pairs
+    // colliding, contacts and islands. Compiled out with ENGINE_PROFILING off.
+    Profiler &GetProfiler() { return profiler; }
+    const Profiler &GetProfiler() const { return profiler; }
+
+    // Advances the simulation by dt seconds
+    void Step(float dt);
+
+    // Fixed timestep stepping: advances by the real time that passed since
+    // the last call, in whole steps of fixedTimeStep. The time left over is
+    // kept for the next call. Returns the number of steps taken.
+    // At most maxStepsPerUpdate steps are taken; when the simulation cannot
+    // keep up, the time it is behind by is dropped instead of piling up
+    // (each update taking longer and owing even more steps).
+    int Update(float elapsedTime);
+
+    // How far the time left over by Update is into the next step, from 0 to 1
+    float GetInterpolationAlpha() const { return accumulator / fixedTimeStep; }
+
+    // Pose between the last two steps taken by Update, alpha of the way:
+    // what to render so that motion looks smooth whatever the step rate
+    Transform GetInterpolatedTransform(size_t index) const;
+
+    // The phases of Step, public so tools can drive and time them one by one
+    void Integrate(float dt);
+    void UpdateWorldVertices();
+    void UpdateAABBs();
+    void FindPairs();
+    void DetectCollisions();
+    void BuildIslands();
+    void ResolveCollisions(float dt);
+    void SolveContinuous(float dt);
+    void UpdateSleep(float dt);
+
+    // Sleeping bodies are frozen: they are not integrated, their vertices and
+    // AABBs are not updated, and pairs between two of them are not tested.
+    // A body wakes up when an awake body touches it or when it is edited
+    // through a BodyRef. Static bodies are always awake.
+    bool IsAwake(size_t index) const { return awake[index] != 0; }
+    void SetAwake(size_t index, bool isAwake);
+    size_t GetAwakeBodyCount() const;
+
+    // Contact points between the touching pairs of the last step
+    size_t GetContactCount() const;
+
+    // Bullets are small fast bodies that would pass through thin ones
+    // between two steps. Each step they are swept from where they started to
+    // where they ended up, and stopped at the first impact (continuous
+    // collision detection). Only bullets pay for it, the rest of the world
+    // keeps taking one step.
+    bool IsBullet(size_t index) const { return bullets[index] != 0; }
+    void SetBullet(size_t index, bool isBullet);
+
+    // Draws every body: static ones in green, dynamic ones in white and
+    // sleeping ones in grey
+    void Draw(DebugDraw &draw) const;
+    // Same, at the interpolated poses
+    void DrawInterpolated(DebugDraw &draw) const;
+
+    const std::vector<AABB> &GetAABBs() const { return aabbs; }
+    const std::vector<BroadphasePair> &GetPairs() const { return pairs; }
+    // manifolds[k] is only meaningful where touching[k] is set
+    const std::vector<Manifold> &GetManifolds() const { return manifolds; }
+    const std::vector<char> &GetTouching() const { return touching; }
+    const IslandBuilder &GetIslands() const { return islands; }
+
+    // Acceleration applied to every dynamic body (pixels/s^2, +y is down)
+    Vec2 gravity = Vec2(0.0f, 980.0f);
+
+    // Step length and catch-up limit of Update
+    float fixedTimeStep = 1.0f / 60.0f;
+    int maxStepsPerUpdate = 5;
+    // Update takes each fixed step as this many Steps of a fraction of it.
+    // Stacks get stiffer and fast bodies tunnel less, for the price of the
+    // extra Steps; the pace of the simulation is unchanged.
+    int substeps = 1;
+
+    // Iterations, friction, bounciness and the like of the contact solver
+    SolverSettings solverSettings;
+
+    // A body is resting while its speeds stay under these tolerances. An
+    // island falls asleep once all of its bodies have rested for timeToSleep
+    // seconds.
+    bool allowSleep = true;
+    float sleepLinearTolerance = 5.0f;   // pixels/s
+    float sleepAngularTolerance = 0.05f; // radians/s
+    float timeToSleep = 0.5f;           // seconds
+
+    // A bullet bouncing between bodies is swept again after each impact,
+    // at most this many times per step
+    int maxBulletSubsteps = 4;
+
+    // Body state, one entry per body, indexed by body index
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> velocityX;
+    std::vector<float> velocityY;
+    std::vector<float> forceX;
+    std::vector<float> forceY;
+    std::vector<float> angles;
+    std::vector<float> angularVelocities;
+    std::vector<float> torques;
+    std::vector<float> inverseMasses;
+    std::vector<float> inverseInertias;
+    std::vector<Shape::Type> shapeTypes;
+    std::vector<Shape *> shapes; // Owned by the shape pools
+
+    // Position/rotation each body's world vertices were last computed with
+    std::vector<Transform> transforms;
+
+private:
+    Shape *CreateShape(const Shape &shape);
+    void ReleaseShape(Shape *shape);
+    void RemoveBody(BodyHandle handle);
+    AABB ComputeAABB(size_t index) const;
+    float ComputeReach(size_t index) const;
+    void WakeTouchingBodies();
+    void TestPair(size_t k, Collision::CollideFunction collide);
+    std::uint64_t GetPairKey(size_t k) const;
+    void UpdatePairCache();
+
+    // Calls fn(sectionId, world.array...) for every saved array, of each
+    // world passed (see WorldSnapshot.cpp)
+    template <typename Fn, typename... Worlds>
+    static void ForEachStateArray(Fn &&fn, Worlds &...worlds);
+
+    // Dynamic and awake: the body takes part in the step
+    bool IsActive(size_t index) const { return activeInverseMasses[index] != 0.0f; }
+
+    struct Slot
+    {
+        std::uint32_t index = 0;      // Where the body currently lives in the arrays
+        std::uint32_t generation = 0; // Bumped every time the slot is freed
+    };
+
+    std::vector<Slot> slots;
+    std::vector<std::uint32_t> freeSlots;
+    std::vector<std::uint32_t> indexToSlot;
+
+    // Sleep state, one entry per body. The active inverse masses are the
+    // inverse masses with sleeping bodies zeroed out, so that the passes of a
+    // step treat them like static bodies.
+    std::vector<char> awake;
+    std::vector<float> sleepTimes;
+    std::vector<float> activeInverseMasses;
+    std::vector<float> activeInverseInertias;
+
+    // Bullet flags, one entry per body, and where this step's bullets
+    // started, recorded by Integrate
+    struct BulletStart
+    {
+        std::uint32_t index;
+        Vec2 position;
+        float angle;
+    };
+    std::vector<char> bullets;
+    size_t bulletCount = 0;
+    std::vector<BulletStart> bulletStarts;
+
+    // Time not yet stepped by Update, and the poses before its last step
+    float accumulator = 0.0f;
+    std::vector<float> previousPositionX;
+    std::vector<float> previousPositionY;
+    std::vector<float> previousAngles;
+
+    std::unique_ptr<JobSystem> jobSystem;
+    Profiler profiler;
+    std::uint64_t stateHash = 0; // Of the last step, when hashEachStep is set
+
+    // Shapes of the bodies, and the geometry they share
+    ObjectPool<CircleShape> circlePool;
+    ObjectPool<PolygonShape> polygonPool;
+    ShapeRegistry shapeRegistry;
+
+    // Mutable: drawing borrows it too, and leaves it as it found it
+    mutable FrameArena frameArena;
+
+    std::unique_ptr<Broadphase> broadphase;
+    std::vector<AABB> aabbs;
+    std::vector<BroadphasePair> pairs;
+
+    // Narrow phase results, one entry per pair
+    std::vector<Manifold> manifolds;
+    std::vector<char> touching;
+    std::vector<char> tested; // False for pairs skipped because neither body was active
+    std::vector<NarrowPhaseCache> narrowPhaseCaches;
+
+    // The pairs to test this step, bucketed by the shape types of the pair:
+    // pairOrder[pairBucketOffsets[c], pairBucketOffsets[c + 1]) are the pair
+    // indices of type combination c = typeA * TYPE_COUNT + typeB
+    std::vector<std::uint32_t> pairOrder;
+    std::array<std::uint32_t, Shape::TYPE_COUNT * Shape::TYPE_COUNT + 1> pairBucketOffsets = {};
+
+    IslandBuilder islands;
+    ContactSolver contactSolver;
+
+    // Last step's narrow phase results, sorted by key. Pairs are keyed by
+    // the slots of their bodies, which do not change when other bodies are
+    // destroyed (body indices do), so a pair finds its impulses, its
+    // separating axis and its GJK simplex from the last step.
+    struct CachedPair
+    {
+        std::uint64_t key;
+        std::uint32_t slotA; // The normal points away from this body
+        NarrowPhaseCache cache;
+        Manifold manifold;   // Empty unless the pair was touching
+    };
+    std::vector<CachedPair> pairCache;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <DebugDraw.h>
+#include <SDL.h>
+#include <vector>
+
+// Draws DebugDraw primitives with an SDL_Renderer.
+// Nothing is drawn until Flush: every outline of the frame is turned into
+// thin quads (two triangles per line) in one vertex buffer, and the whole
+// buffer goes to the GPU in a single SDL_RenderGeometry call. The buffers
+// are kept from frame to frame, so a warm frame does not allocate.
+class SDLDebugDraw : public DebugDraw
+{
+public:
+    explicit SDLDebugDraw(SDL_Renderer *renderer);
+
+    void DrawPolygon(const Vec2 *vertices, int count, const Color &color) override;
+    void DrawCircle(const Vec2 &center, float radius, float angle, const Color &color) override;
+    void DrawSegment(const Vec2 &a, const Vec2 &b, const Color &color) override;
+    void Flush() override;
+
+    // Size of the last batch sent by Flush
+    int GetFlushedVertexCount() const { return flushedVertexCount; }
+
+    float lineWidth = 1.0f; // Pixels
+
+private:
+    static constexpr int circleSegments = 24;
+
+    void AddLine(const Vec2 &a, const Vec2 &b, const SDL_Color &color);
+
+    SDL_Renderer *renderer;
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+    int flushedVertexCount = 0;
+
+    // The unit circle, so drawing a circle costs one sin/cos for its angle
+    Vec2 unitCircle[circleSegments];
+};
@@ -0,0 +1,75 @@
+#include <SDLDebugDraw.h>
+#include <cmath>
+
+SDLDebugDraw::SDLDebugDraw(SDL_Renderer *renderer) : renderer(renderer)
+{
+    const float step = 2.0f * 3.14159265f / circleSegments;
+    for (int i = 0; i < circleSegments; ++i)
+    {
+        unitCircle[i] = Vec2(std::cos(i * step), std::sin(i * step));
+    }
+}
+
+// A line is a quad lineWidth wide, stretched half a width past each end so
+// the corners of an outline close
+void SDLDebugDraw::AddLine(const Vec2 &a, const Vec2 &b, const SDL_Color &color)
+{
+    Vec2 direction = b - a;
+    const float length = direction.Magnitude();
+    direction = length > 1e-6f ? direction * (0.5f * lineWidth / length) : Vec2(0.5f * lineWidth, 0.0f);
+    const Vec2 side(-direction.y, direction.x);
+    const Vec2 start = a - direction;
+    const Vec2 end = b + direction;
+
+    const int base = static_cast<int>(vertices.size());
+    for (const Vec2 &corner : {start + side, start - side, end - side, end + side})
+    {
+        vertices.push_back({{corner.x, corner.y}, color, {0.0f, 0.0f}});
+    }
+    for (int offset : {0, 1, 2, 0, 2, 3})
+    {
+        indices.push_back(base + offset);
+    }
+}
+
+void SDLDebugDraw::DrawPolygon(const Vec2 *polygon, int count, const Color &color)
+{
+    const SDL_Color sdlColor = {color.r, color.g, color.b, color.a};
+    for (int i = 0; i < count; ++i)
+    {
+        AddLine(polygon[i], polygon[(i + 1) % count], sdlColor);
+    }
+}
+
+void SDLDebugDraw::DrawCircle(const Vec2 &center, float radius, float angle, const Color &color)
+{
+    const SDL_Color sdlColor = {color.r, color.g, color.b, color.a};
+    const Vec2 rotation(std::cos(angle) * radius, std::sin(angle) * radius);
+    Vec2 previous = center + rotation;
+    for (int i = 1; i <= circleSegments; ++i)
+    {
+        const Vec2 &unit = unitCircle[i % circleSegments];
+        const Vec2 point = center + Vec2(unit.x * rotation.x - unit.y * rotation.y, unit.x * rotation.y + unit.y * rotation.x);
+        AddLine(previous, point, sdlColor);
+        previous = point;
+    }
+    // Radius line, so rotation is visible
+    AddLine(center, center + rotation, sdlColor);
+}
+
+void SDLDebugDraw::DrawSegment(const Vec2 &a, const Vec2 &b, const Color &color)
+{
+    AddLine(a, b, {color.r, color.g, color.b, color.a});
+}
+
+void SDLDebugDraw::Flush()
+{
+    flushedVertexCount = static_cast<int>(vertices.size());
+    if (!indices.empty())
+    {
+        SDL_RenderGeometry(renderer, nullptr, vertices.data(), static_cast<int>(vertices.size()), indices.data(),
+                           static_cast<int>(indices.size()));
+    }
+    vertices.clear();
+    indices.clear();
+}
@@ -0,0 +1,319 @@
+#include <BarnesHut.h>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Morton codes hold 16 bits per axis, so the tree is at most 16 levels deep
+    const int maxLevel = 16;
+    // The cells of this level are the subtrees built in parallel (4^2 = 16)
+    const int splitLevel = 2;
+    const size_t codeGrainSize = 16384;
+    const size_t forceGrainSize = 512;
+
+    // Spreads the low 16 bits of v out to the even bits
+    std::uint32_t SpreadBits(std::uint32_t v)
+    {
+        v = (v | (v << 8)) & 0x00FF00FFu;
+        v = (v | (v << 4)) & 0x0F0F0F0Fu;
+        v = (v | (v << 2)) & 0x33333333u;
+        v = (v | (v << 1)) & 0x55555555u;
+        return v;
+    }
+
+    // Which of the four children of a cell at this level the code falls in
+    std::uint32_t ChildOf(std::uint32_t code, int level)
+    {
+        return (code >> (32 - 2 * (level + 1))) & 3u;
+    }
+}
+
+void BarnesHutTree::Build(const float *positionX, const float *positionY, const float *inverseMasses, size_t count,
+                          JobSystem &jobSystem)
+{
+    // Only particles with mass take part
+    order.clear();
+    float minX = 0.0f, minY = 0.0f, maxX = 0.0f, maxY = 0.0f;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (inverseMasses[i] <= 0.0f)
+        {
+            continue;
+        }
+        if (order.empty())
+        {
+            minX = maxX = positionX[i];
+            minY = maxY = positionY[i];
+        }
+        minX = std::min(minX, positionX[i]);
+        minY = std::min(minY, positionY[i]);
+        maxX = std::max(maxX, positionX[i]);
+        maxY = std::max(maxY, positionY[i]);
+        order.push_back(static_cast<std::uint32_t>(i));
+    }
+
+    nodes.clear();
+    const size_t n = order.size();
+    if (n == 0)
+    {
+        return;
+    }
+
+    // A square root cell, a little larger than the particles so that none
+    // lands exactly on the far edge
+    rootSize = std::max(std::max(maxX - minX, maxY - minY), 1.0f) * 1.001f;
+    const float scale = 65536.0f / rootSize;
+    codes.resize(n);
+    jobSystem.ParallelFor(n, codeGrainSize, [&](size_t begin, size_t end)
+                          {
+        for (size_t s = begin; s < end; ++s)
+        {
+            const std::uint32_t i = order[s];
+            const std::uint32_t qx = std::min(static_cast<std::uint32_t>((positionX[i] - minX) * scale), 65535u);
+            const std::uint32_t qy = std::min(static_cast<std::uint32_t>((positionY[i] - minY) * scale), 65535u);
+            codes[s] = SpreadBits(qx) | (SpreadBits(qy) << 1);
+        } });
+    SortByCode();
+
+    sortedX.resize(n);
+    sortedY.resize(n);
+    sortedMass.resize(n);
+    jobSystem.ParallelFor(n, codeGrainSize, [&](size_t begin, size_t end)
+                          {
+        for (size_t s = begin; s < end; ++s)
+        {
+            const std::uint32_t i = order[s];
+            sortedX[s] = positionX[i];
+            sortedY[s] = positionY[i];
+            sortedMass[s] = 1.0f / inverseMasses[i];
+        } });
+
+    // The non-empty cells of the split level, in Morton order, each built on
+    // its own. The levels above them are only a handful of nodes. Subtrees
+    // keep their node arrays from step to step.
+    const int splitShift = 32 - 2 * splitLevel;
+    size_t subtreeCount = 0;
+    std::uint32_t begin = 0;
+    while (begin < n)
+    {
+        const std::uint32_t cell = codes[begin] >> splitShift;
+        const std::uint32_t end = static_cast<std::uint32_t>(
+            std::upper_bound(codes.begin() + begin, codes.end(), cell, [&](std::uint32_t value, std::uint32_t code)
+                             { return value < (code >> splitShift); }) -
+            codes.begin());
+        if (subtreeCount == subtrees.size())
+        {
+            subtrees.emplace_back();
+        }
+        subtrees[subtreeCount].begin = begin;
+        subtrees[subtreeCount].end = end;
+        ++subtreeCount;
+        begin = end;
+    }
+    jobSystem.ParallelFor(subtreeCount, 1, [&](size_t first, size_t last)
+                          {
+        for (size_t t = first; t < last; ++t)
+        {
+            subtrees[t].nodes.clear();
+            BuildNode(subtrees[t].begin, subtrees[t].end, splitLevel, subtrees[t].nodes);
+        } });
+
+    size_t subtree = 0;
+    BuildTop(0, static_cast<std::uint32_t>(n), 0, subtree);
+}
+
+// Least significant digit radix sort of the codes, carrying the particle
+// indices along, 8 bits per pass
+void BarnesHutTree::SortByCode()
+{
+    const size_t n = codes.size();
+    scratchCodes.resize(n);
+    scratchOrder.resize(n);
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        size_t offsets[256] = {};
+        for (size_t s = 0; s < n; ++s)
+        {
+            ++offsets[(codes[s] >> shift) & 0xFFu];
+        }
+        size_t total = 0;
+        for (size_t &offset : offsets)
+        {
+            const size_t bucket = offset;
+            offset = total;
+            total += bucket;
+        }
+        for (size_t s = 0; s < n; ++s)
+        {
+            const size_t to = offsets[(codes[s] >> shift) & 0xFFu]++;
+            scratchCodes[to] = codes[s];
+            scratchOrder[to] = order[s];
+        }
+        codes.swap(scratchCodes);
+        order.swap(scratchOrder);
+    }
+}
+
+// Appends the subtree of the cell holding sorted particles [begin, end),
+// depth first. Its next indices are relative to the start of out.
+void BarnesHutTree::BuildNode(std::uint32_t begin, std::uint32_t end, int level, std::vector<Node> &out) const
+{
+    const size_t index = out.size();
+    out.push_back(Node());
+    float mass = 0.0f, x = 0.0f, y = 0.0f;
+
+    const bool leaf = static_cast<int>(end - begin) <= leafCapacity || level == maxLevel;
+    if (leaf)
+    {
+        for (std::uint32_t s = begin; s < end; ++s)
+        {
+            mass += sortedMass[s];
+            x += sortedX[s] * sortedMass[s];
+            y += sortedY[s] * sortedMass[s];
+        }
+    }
+    else
+    {
+        std::uint32_t first = begin;
+        for (std::uint32_t child = 0; child < 4 && first < end; ++child)
+        {
+            const std::uint32_t last = static_cast<std::uint32_t>(
+                std::partition_point(codes.begin() + first, codes.begin() + end, [&](std::uint32_t code)
+                                     { return ChildOf(code, level) <= child; }) -
+                codes.begin());
+            if (last == first)
+            {
+                continue;
+            }
+            const size_t childIndex = out.size();
+            BuildNode(first, last, level + 1, out);
+            const Node &childNode = out[childIndex];
+            mass += childNode.mass;
+            x += childNode.x * childNode.mass;
+            y += childNode.y * childNode.mass;
+            first = last;
+        }
+    }
+
+    Node &node = out[index];
+    node.x = x / mass;
+    node.y = y / mass;
+    node.mass = mass;
+    node.size = rootSize / static_cast<float>(1u << level);
+    node.next = static_cast<std::uint32_t>(out.size());
+    node.begin = begin;
+    node.end = end;
+    node.leaf = leaf;
+}
+
+// The levels above the split level, with the parallel built subtrees
+// spliced in where their cells are
+void BarnesHutTree::BuildTop(std::uint32_t begin, std::uint32_t end, int level, size_t &subtree)
+{
+    if (level == splitLevel)
+    {
+        const std::uint32_t offset = static_cast<std::uint32_t>(nodes.size());
+        for (Node node : subtrees[subtree++].nodes)
+        {
+            node.next += offset;
+            nodes.push_back(node);
+        }
+        return;
+    }
+
+    const size_t index = nodes.size();
+    nodes.push_back(Node());
+    float mass = 0.0f, x = 0.0f, y = 0.0f;
+    std::uint32_t first = begin;
+    for (std::uint32_t child = 0; child < 4 && first < end; ++child)
+    {
+        const std::uint32_t last = static_cast<std::uint32_t>(
+            std::partition_point(codes.begin() + first, codes.begin() + end, [&](std::uint32_t code)
+                                 { return ChildOf(code, level) <= child; }) -
+            codes.begin());
+        if (last == first)
+        {
+            continue;
+        }
+        const size_t childIndex = nodes.size();
+        BuildTop(first, last, level + 1, subtree);
+        mass += nodes[childIndex].mass;
+        x += nodes[childIndex].x * nodes[childIndex].mass;
+        y += nodes[childIndex].y * nodes[childIndex].mass;
+        first = last;
+    }
+
+    Node &node = nodes[index];
+    node.x = x / mass;
+    node.y = y / mass;
+    node.mass = mass;
+    node.size = rootSize / static_cast<float>(1u << level);
+    node.next = static_cast<std::uint32_t>(nodes.size());
+    node.begin = begin;
+    node.end = end;
+    node.leaf = false;
+}
+
+// Walks the tree once per particle. Particles next to each other in Morton
+// order are close in space and walk nearly the same cells, so the threads
+// take consecutive runs of them.
+void BarnesHutTree::ApplyForces(float gravitationalConstant, float theta, float *forceX, float *forceY,
+                                JobSystem &jobSystem) const
+{
+    const float thetaSquared = theta * theta;
+    const std::uint32_t nodeCount = static_cast<std::uint32_t>(nodes.size());
+
+    jobSystem.ParallelFor(order.size(), forceGrainSize, [&](size_t begin, size_t end)
+                          {
+        for (size_t s = begin; s < end; ++s)
+        {
+            const float px = sortedX[s];
+            const float py = sortedY[s];
+            float ax = 0.0f, ay = 0.0f;
+
+            // Pull of mass m at distance (dx, dy): G m / max(d^2, 1) along the unit direction
+            auto attract = [&](float dx, float dy, float m)
+            {
+                const float distanceSquared = dx * dx + dy * dy;
+                if (distanceSquared == 0.0f)
+                {
+                    return;
+                }
+                const float scale = m / (std::sqrt(distanceSquared) * std::max(distanceSquared, 1.0f));
+                ax += dx * scale;
+                ay += dy * scale;
+            };
+
+            std::uint32_t k = 0;
+            while (k < nodeCount)
+            {
+                const Node &node = nodes[k];
+                const float dx = node.x - px;
+                const float dy = node.y - py;
+                if (node.leaf)
+                {
+                    for (std::uint32_t other = node.begin; other < node.end; ++other)
+                    {
+                        if (other != s)
+                        {
+                            attract(sortedX[other] - px, sortedY[other] - py, sortedMass[other]);
+                        }
+                    }
+                    k = node.next;
+                }
+                else if (node.size * node.size < thetaSquared * (dx * dx + dy * dy))
+                {
+                    attract(dx, dy, node.mass); // Far enough: the whole cell at once
+                    k = node.next;
+                }
+                else
+                {
+                    ++k; // Open the cell: its first child comes next
+                }
+            }
+
+            const float strength = gravitationalConstant * sortedMass[s];
+            forceX[order[s]] += ax * strength;
+            forceY[order[s]] += ay * strength;
+        } });
+}
@@ -1,5 +1,6 @@
 #include <Body.h>
 #include <PolygonShape.h> // We need the full definition here
+#include <CircleShape.h>
 #include <iostream>
 
 Body::Body(const Shape &shape, float x, float y)
@@ -36,7 +37,8 @@ Body::Body(const Shape &shape, float x, float y)
     // If it's a polygon, initialize world vertices
     if (this->shape->GetType() == Shape::POLYGON)
     {
-        UpdateWorldVertices();
+        this->transform = Transform(this->position, this->angle);
+        static_cast<PolygonShape *>(this->shape.get())->UpdateWorldVertices(this->transform);
     }
 }
 
@@ -90,10 +92,10 @@ void Body::Integrate(float dt)
 
 void Body::UpdateWorldVertices()
 {
-    PolygonShape *polygonShape = static_cast<PolygonShape *>(shape.get());
-    polygonShape->worldVertices.clear();
-    for (const auto &v : polygonShape->localVertices)
+    // Static and resting bodies keep last step's vertices
+    if (!transform.Set(position, angle))
     {
-        polygonShape->worldVertices.push_back(position + v.Rotated(angle));
+        return;
     }
-}
\ No newline at end of file
+    static_cast<PolygonShape *>(shape.get())->UpdateWorldVertices(transform);
+}
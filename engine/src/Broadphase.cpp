@@ -0,0 +1,246 @@
+#include <Broadphase.h>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+void BruteForceBroadphase::FindPairs(const std::vector<AABB> &aabbs, std::vector<BroadphasePair> &pairs)
+{
+    pairs.clear();
+    const int count = static_cast<int>(aabbs.size());
+    for (int i = 0; i < count; ++i)
+    {
+        for (int j = i + 1; j < count; ++j)
+        {
+            if (aabbs[i].Overlaps(aabbs[j]))
+            {
+                pairs.push_back({i, j});
+            }
+        }
+    }
+}
+
+namespace
+{
+    // Packs a signed cell coordinate pair into one sortable key
+    std::uint64_t CellKey(int cx, int cy)
+    {
+        return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(cx)) << 32) |
+               static_cast<std::uint32_t>(cy);
+    }
+
+    int CellCoord(float value, float inverseCellSize)
+    {
+        return static_cast<int>(std::floor(value * inverseCellSize));
+    }
+}
+
+void UniformGridBroadphase::FindPairs(const std::vector<AABB> &aabbs, std::vector<BroadphasePair> &pairs)
+{
+    pairs.clear();
+    entries.clear();
+    oversized.clear();
+
+    const int count = static_cast<int>(aabbs.size());
+    if (count < 2)
+    {
+        return;
+    }
+
+    // Pick a cell about twice the size of an average box, so a typical box
+    // touches between one and four cells.
+    float size = cellSize;
+    if (size <= 0.0f)
+    {
+        float sum = 0.0f;
+        for (const auto &aabb : aabbs)
+        {
+            sum += std::max(aabb.max.x - aabb.min.x, aabb.max.y - aabb.min.y);
+        }
+        size = std::max(2.0f * sum / count, 1e-3f);
+    }
+    const float inverseCellSize = 1.0f / size;
+
+    // 1. Insert every box into the cells it covers
+    for (int i = 0; i < count; ++i)
+    {
+        const AABB &aabb = aabbs[i];
+        const int minX = CellCoord(aabb.min.x, inverseCellSize);
+        const int minY = CellCoord(aabb.min.y, inverseCellSize);
+        const int maxX = CellCoord(aabb.max.x, inverseCellSize);
+        const int maxY = CellCoord(aabb.max.y, inverseCellSize);
+
+        const long long cells = static_cast<long long>(maxX - minX + 1) * (maxY - minY + 1);
+        if (cells > maxCellsPerBox)
+        {
+            oversized.push_back(i);
+            continue;
+        }
+
+        for (int cy = minY; cy <= maxY; ++cy)
+        {
+            for (int cx = minX; cx <= maxX; ++cx)
+            {
+                entries.push_back({CellKey(cx, cy), i});
+            }
+        }
+    }
+
+    // 2. Sorting groups the entries of each cell together
+    std::sort(entries.begin(), entries.end());
+
+    // 3. Test the boxes that share a cell
+    const size_t entryCount = entries.size();
+    size_t runStart = 0;
+    while (runStart < entryCount)
+    {
+        size_t runEnd = runStart + 1;
+        while (runEnd < entryCount && entries[runEnd].cell == entries[runStart].cell)
+        {
+            ++runEnd;
+        }
+
+        const std::uint64_t cell = entries[runStart].cell;
+        for (size_t p = runStart; p < runEnd; ++p)
+        {
+            for (size_t q = p + 1; q < runEnd; ++q)
+            {
+                const int a = entries[p].index;
+                const int b = entries[q].index;
+                const AABB &boxA = aabbs[a];
+                const AABB &boxB = aabbs[b];
+                if (!boxA.Overlaps(boxB))
+                {
+                    continue;
+                }
+
+                // Two boxes can share several cells. Only report the pair from
+                // the cell that holds the min corner of their intersection.
+                const int ownerX = CellCoord(std::max(boxA.min.x, boxB.min.x), inverseCellSize);
+                const int ownerY = CellCoord(std::max(boxA.min.y, boxB.min.y), inverseCellSize);
+                if (CellKey(ownerX, ownerY) == cell)
+                {
+                    pairs.push_back({a, b}); // entries are sorted by index within a cell, so a < b
+                }
+            }
+        }
+        runStart = runEnd;
+    }
+
+    // 4. Oversized boxes are tested against everything
+    for (size_t k = 0; k < oversized.size(); ++k)
+    {
+        const int big = oversized[k];
+        for (int i = 0; i < count; ++i)
+        {
+            if (i == big || !aabbs[big].Overlaps(aabbs[i]))
+            {
+                continue;
+            }
+            // Two oversized boxes would otherwise report their pair twice
+            if (std::binary_search(oversized.begin(), oversized.end(), i) && i < big)
+            {
+                continue;
+            }
+            pairs.push_back({std::min(big, i), std::max(big, i)});
+        }
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+}
+
+void TreeBroadphase::Clear()
+{
+    for (const int proxy : proxies)
+    {
+        tree.DestroyProxy(proxy);
+    }
+    proxies.clear();
+    moved.clear();
+    pairCache.clear();
+}
+
+void TreeBroadphase::FindPairs(const std::vector<AABB> &aabbs, std::vector<BroadphasePair> &pairs)
+{
+    pairs.clear();
+    newPairs.clear();
+
+    const int count = static_cast<int>(aabbs.size());
+    const int previousCount = static_cast<int>(proxies.size());
+
+    // 1. Bodies that went away lose their proxy and their cached pairs
+    if (count < previousCount)
+    {
+        for (int i = count; i < previousCount; ++i)
+        {
+            tree.DestroyProxy(proxies[i]);
+        }
+        proxies.resize(count);
+        pairCache.erase(std::remove_if(pairCache.begin(), pairCache.end(),
+                                       [count](const BroadphasePair &pair)
+                                       { return pair.b >= count; }),
+                        pairCache.end());
+    }
+
+    // 2. Move the proxies of bodies that left their fat box, create new ones
+    moved.assign(count, 0);
+    for (int i = 0; i < count; ++i)
+    {
+        if (i < previousCount)
+        {
+            moved[i] = tree.MoveProxy(proxies[i], aabbs[i]) ? 1 : 0;
+        }
+        else
+        {
+            proxies.push_back(tree.CreateProxy(aabbs[i], i));
+            moved[i] = 1;
+        }
+    }
+
+    // 3. Only moved proxies look for new overlaps
+    for (int i = 0; i < count; ++i)
+    {
+        if (!moved[i])
+        {
+            continue;
+        }
+
+        tree.Query(tree.GetFatAABB(proxies[i]), [&](int proxyId)
+                   {
+                       const int other = tree.GetUserData(proxyId);
+                       // When both moved, only the lower index reports the pair
+                       if (other != i && !(moved[other] && other < i))
+                       {
+                           newPairs.push_back({std::min(i, other), std::max(i, other)});
+                       }
+                       return true; });
+    }
+
+    // 4. Pairs involving a moved proxy may have stopped overlapping
+    pairCache.erase(std::remove_if(pairCache.begin(), pairCache.end(),
+                                   [&](const BroadphasePair &pair)
+                                   {
+                                       if (!moved[pair.a] && !moved[pair.b])
+                                           return false;
+                                       return !tree.GetFatAABB(proxies[pair.a]).Overlaps(tree.GetFatAABB(proxies[pair.b]));
+                                   }),
+                    pairCache.end());
+
+    // 5. Merge the new pairs into the cache, which stays sorted and unique
+    if (!newPairs.empty())
+    {
+        std::sort(newPairs.begin(), newPairs.end());
+        merged.clear();
+        std::merge(pairCache.begin(), pairCache.end(), newPairs.begin(), newPairs.end(), std::back_inserter(merged));
+        merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+        pairCache.swap(merged);
+    }
+
+    // 6. The narrow phase only gets the pairs whose tight boxes overlap
+    for (const auto &pair : pairCache)
+    {
+        if (aabbs[pair.a].Overlaps(aabbs[pair.b]))
+        {
+            pairs.push_back(pair);
+        }
+    }
+}
@@ -0,0 +1,321 @@
+#include <ConstraintNetwork.h>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace
+{
+    // Links per job
+    const size_t linkGrainSize = 2048;
+    // Colours are tracked as bits of a 64 bit mask per particle
+    const int maxColors = 64;
+
+    // Section ids, above those of the ParticleSystem in the same snapshot
+    enum Section : std::uint32_t
+    {
+        LinkA = 128,
+        LinkB,
+        RestLengths,
+        Stiffnesses,
+        ColorOffsets,
+        Settings,
+    };
+
+    struct SettingsRecord
+    {
+        std::int32_t solver;
+        std::int32_t substeps;
+        std::int32_t iterations;
+        std::uint8_t colored;
+    };
+}
+
+void ConstraintNetwork::AddLink(std::uint32_t a, std::uint32_t b, float restLength, float stiffness)
+{
+    linkA.push_back(a);
+    linkB.push_back(b);
+    restLengths.push_back(restLength);
+    stiffnesses.push_back(stiffness);
+    colored = false;
+}
+
+void ConstraintNetwork::RemoveLinks(std::uint32_t particle)
+{
+    auto touches = [&](size_t i)
+    { return linkA[i] == particle || linkB[i] == particle; };
+    size_t i = 0;
+    const size_t linkCount = GetLinkCount();
+    while (i < linkCount && !touches(i))
+    {
+        ++i;
+    }
+    if (i == linkCount)
+    {
+        return;
+    }
+
+    // Compacts links [begin, end) to the front, keeping their order
+    size_t kept = 0;
+    auto compact = [&](size_t begin, size_t end)
+    {
+        for (size_t link = begin; link < end; ++link)
+        {
+            if (!touches(link))
+            {
+                linkA[kept] = linkA[link];
+                linkB[kept] = linkB[link];
+                restLengths[kept] = restLengths[link];
+                stiffnesses[kept] = stiffnesses[link];
+                ++kept;
+            }
+        }
+    };
+    if (colored)
+    {
+        // Every colour range shrinks in place
+        for (size_t color = 0; color + 1 < colorOffsets.size(); ++color)
+        {
+            const size_t begin = colorOffsets[color];
+            colorOffsets[color] = static_cast<std::uint32_t>(kept);
+            compact(begin, colorOffsets[color + 1]);
+        }
+        colorOffsets.back() = static_cast<std::uint32_t>(kept);
+    }
+    else
+    {
+        compact(0, linkCount);
+    }
+    linkA.resize(kept);
+    linkB.resize(kept);
+    restLengths.resize(kept);
+    stiffnesses.resize(kept);
+}
+
+void ConstraintNetwork::Clear()
+{
+    linkA.clear();
+    linkB.clear();
+    restLengths.clear();
+    stiffnesses.clear();
+    colored = false;
+}
+
+size_t ConstraintNetwork::GetColorCount()
+{
+    Color();
+    size_t count = colorOffsets.size() - 2;
+    if (colorOffsets[count] != GetLinkCount())
+    {
+        ++count; // The links solved on one thread
+    }
+    return count;
+}
+
+// Greedy colouring: each link takes the lowest colour neither of its ends has
+// yet. A particle with n links needs at most 2n - 1 colours this way, so a
+// cloth grid gets by with a handful.
+void ConstraintNetwork::Color()
+{
+    if (colored)
+    {
+        return;
+    }
+    colored = true;
+
+    const size_t linkCount = GetLinkCount();
+    std::uint32_t particleCount = 0;
+    for (size_t i = 0; i < linkCount; ++i)
+    {
+        particleCount = std::max(particleCount, std::max(linkA[i], linkB[i]) + 1);
+    }
+
+    std::vector<std::uint64_t> used(particleCount, 0);
+    std::vector<int> colors(linkCount);
+    int colorCount = 0;
+    size_t counts[maxColors + 1] = {};
+    for (size_t i = 0; i < linkCount; ++i)
+    {
+        const std::uint64_t taken = used[linkA[i]] | used[linkB[i]];
+        int color = maxColors; // No colour left: solved on one thread
+        if (taken != ~std::uint64_t(0))
+        {
+            color = std::countr_one(taken);
+            used[linkA[i]] |= std::uint64_t(1) << color;
+            used[linkB[i]] |= std::uint64_t(1) << color;
+            colorCount = std::max(colorCount, color + 1);
+        }
+        colors[i] = color;
+        ++counts[color];
+    }
+
+    // Reorder the links by colour (counting sort, stable)
+    colorOffsets.assign(colorCount + 2, 0);
+    size_t offsets[maxColors + 1];
+    size_t total = 0;
+    for (int color = 0; color <= maxColors; ++color)
+    {
+        offsets[color] = total;
+        total += counts[color];
+    }
+    for (int color = 0; color < colorCount; ++color)
+    {
+        colorOffsets[color] = static_cast<std::uint32_t>(offsets[color]);
+    }
+    colorOffsets[colorCount] = static_cast<std::uint32_t>(offsets[maxColors]);
+    colorOffsets[colorCount + 1] = static_cast<std::uint32_t>(linkCount);
+
+    auto reorder = [&](auto &array)
+    {
+        auto sorted = array;
+        size_t next[maxColors + 1];
+        std::copy(offsets, offsets + maxColors + 1, next);
+        for (size_t i = 0; i < linkCount; ++i)
+        {
+            sorted[next[colors[i]]++] = array[i];
+        }
+        array.swap(sorted);
+    };
+    reorder(linkA);
+    reorder(linkB);
+    reorder(restLengths);
+    reorder(stiffnesses);
+}
+
+template <typename Fn>
+void ConstraintNetwork::ForEachLink(JobSystem &jobSystem, Fn &&fn)
+{
+    Color();
+    const size_t colorCount = colorOffsets.size() - 2;
+    for (size_t color = 0; color < colorCount; ++color)
+    {
+        const size_t first = colorOffsets[color];
+        jobSystem.ParallelFor(colorOffsets[color + 1] - first, linkGrainSize, [&](size_t begin, size_t end)
+                              {
+            for (size_t i = first + begin; i < first + end; ++i)
+            {
+                fn(i);
+            } });
+    }
+    for (size_t i = colorOffsets[colorCount]; i < colorOffsets[colorCount + 1]; ++i)
+    {
+        fn(i);
+    }
+}
+
+void ConstraintNetwork::ApplyForces(const float *positionX, const float *positionY, float *forceX, float *forceY,
+                                    JobSystem &jobSystem)
+{
+    ForEachLink(jobSystem, [&](size_t i)
+                {
+        const std::uint32_t a = linkA[i];
+        const std::uint32_t b = linkB[i];
+        const float dx = positionX[b] - positionX[a];
+        const float dy = positionY[b] - positionY[a];
+        const float length = std::sqrt(dx * dx + dy * dy);
+        if (length == 0.0f)
+        {
+            return;
+        }
+        // k * (length - restLength) along the unit direction from a to b, one sqrt
+        const float scale = stiffnesses[i] * (length - restLengths[i]) / length;
+        forceX[a] += dx * scale;
+        forceY[a] += dy * scale;
+        forceX[b] -= dx * scale;
+        forceY[b] -= dy * scale; });
+}
+
+// Each link's constraint is C = length - restLength, with a compliance of
+// 1 / stiffness. lambda is the total it pushed this step: each pass adds
+//     dLambda = (-C - alpha * lambda) / (wA + wB + alpha),  alpha = compliance / dt^2
+// and moves the ends by their inverse mass times dLambda along the link.
+void ConstraintNetwork::SolvePositions(float *positionX, float *positionY, const float *inverseMasses, float dt,
+                                       JobSystem &jobSystem)
+{
+    lambdas.assign(GetLinkCount(), 0.0f);
+    const float inverseDtSquared = 1.0f / (dt * dt);
+
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        ForEachLink(jobSystem, [&](size_t i)
+                    {
+            const std::uint32_t a = linkA[i];
+            const std::uint32_t b = linkB[i];
+            const float wA = inverseMasses[a];
+            const float wB = inverseMasses[b];
+            const float dx = positionX[b] - positionX[a];
+            const float dy = positionY[b] - positionY[a];
+            const float length = std::sqrt(dx * dx + dy * dy);
+            if (wA + wB == 0.0f || length == 0.0f)
+            {
+                return;
+            }
+
+            const float alpha = inverseDtSquared / stiffnesses[i]; // 0 for rigid links
+            const float deltaLambda = (restLengths[i] - length - alpha * lambdas[i]) / (wA + wB + alpha);
+            lambdas[i] += deltaLambda;
+
+            const float scale = deltaLambda / length;
+            positionX[a] -= dx * scale * wA;
+            positionY[a] -= dy * scale * wA;
+            positionX[b] += dx * scale * wB;
+            positionY[b] += dy * scale * wB; });
+    }
+}
+
+// The colouring is saved with the links it reordered: colouring the
+// reordered links again could give another order, and with it other results.
+// Links added since the last solve are saved uncoloured, in the order they
+// were added, and coloured on the first solve after Restore exactly as they
+// would have been without the round trip.
+void ConstraintNetwork::Save(Snapshot &snapshot) const
+{
+    snapshot.Write(LinkA, linkA);
+    snapshot.Write(LinkB, linkB);
+    snapshot.Write(RestLengths, restLengths);
+    snapshot.Write(Stiffnesses, stiffnesses);
+    snapshot.Write(ColorOffsets, colorOffsets);
+    snapshot.WriteValue(Settings, SettingsRecord{static_cast<std::int32_t>(solver), substeps, iterations,
+                                                 static_cast<std::uint8_t>(colored ? 1 : 0)});
+}
+
+bool ConstraintNetwork::Restore(const SnapshotReader &reader, size_t particleCount)
+{
+    size_t linkCount, count, offsetCount;
+    const std::uint32_t *a = reader.Get<std::uint32_t>(LinkA, linkCount);
+    const std::uint32_t *b = reader.Get<std::uint32_t>(LinkB, count);
+    bool valid = a && b && count == linkCount;
+    valid = valid && reader.Get<float>(RestLengths, count) && count == linkCount;
+    valid = valid && reader.Get<float>(Stiffnesses, count) && count == linkCount;
+    const std::uint32_t *offsets = reader.Get<std::uint32_t>(ColorOffsets, offsetCount);
+    SettingsRecord settings;
+    valid = valid && offsets && reader.ReadValue(Settings, settings);
+    // The offsets of uncoloured links are stale, and not used
+    valid = valid && (settings.colored == 0 || (offsetCount >= 2 && offsets[offsetCount - 1] == linkCount &&
+                                                std::is_sorted(offsets, offsets + offsetCount)));
+    for (size_t i = 0; valid && i < linkCount; ++i)
+    {
+        valid = a[i] < particleCount && b[i] < particleCount;
+    }
+    if (!valid)
+    {
+        return false;
+    }
+
+    reader.Read(LinkA, linkA);
+    reader.Read(LinkB, linkB);
+    reader.Read(RestLengths, restLengths);
+    reader.Read(Stiffnesses, stiffnesses);
+    solver = static_cast<Solver>(settings.solver);
+    substeps = settings.substeps;
+    iterations = settings.iterations;
+    colored = settings.colored != 0;
+    if (colored)
+    {
+        reader.Read(ColorOffsets, colorOffsets);
+    }
+    else
+    {
+        colorOffsets.assign({0, 0});
+    }
+    return true;
+}
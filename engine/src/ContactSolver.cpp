@@ -0,0 +1,413 @@
+#include <ContactSolver.h>
+#include <algorithm>
+
+namespace
+{
+    // Velocity of a point at offset r on a body spinning at w: w x r
+    Vec2 CrossScalar(float w, const Vec2 &r) { return Vec2(-w * r.y, w * r.x); }
+
+    // Tangent of a contact, the direction friction works in
+    Vec2 Tangent(const Vec2 &normal) { return Vec2(normal.y, -normal.x); }
+
+    // A static body (the floor) touches many islands, which are solved on
+    // different threads. Nothing changes it anyway, so it is never written:
+    // only dynamic bodies, which belong to a single island, are.
+    void StoreVelocity(const ContactSolver::Bodies &bodies, int body, float inverseMass, const Vec2 &velocity,
+                       float angularVelocity)
+    {
+        if (inverseMass != 0.0f)
+        {
+            bodies.velocityX[body] = velocity.x;
+            bodies.velocityY[body] = velocity.y;
+            bodies.angularVelocities[body] = angularVelocity;
+        }
+    }
+
+    void StorePosition(const ContactSolver::Bodies &bodies, int body, float inverseMass, const Vec2 &position,
+                       float angle)
+    {
+        if (inverseMass != 0.0f)
+        {
+            bodies.positionX[body] = position.x;
+            bodies.positionY[body] = position.y;
+            bodies.angles[body] = angle;
+        }
+    }
+}
+
+void ContactSolver::Reset(size_t pairCount, size_t bodyCount)
+{
+    constraints.resize(pairCount);
+    startVelocityX.resize(bodyCount);
+    startVelocityY.resize(bodyCount);
+    startAngularVelocity.resize(bodyCount);
+}
+
+void ContactSolver::SolveIsland(const Bodies &bodies, const SolverSettings &settings, float dt,
+                                const IslandBuilder &islands, size_t island,
+                                const std::vector<BroadphasePair> &pairs, std::vector<Manifold> &manifolds)
+{
+    const int *contacts = islands.islandContacts.data() + islands.islandContactStarts[island];
+    const int count = islands.islandContactStarts[island + 1] - islands.islandContactStarts[island];
+    const int bodyBegin = islands.islandBodyStarts[island];
+    const int bodyEnd = islands.islandBodyStarts[island + 1];
+    if (count == 0)
+    {
+        return;
+    }
+
+    // The island's own bodies only: the static ones its contacts touch are
+    // shared with other islands (see StoreVelocity)
+    for (int i = bodyBegin; i < bodyEnd; ++i)
+    {
+        const int body = islands.islandBodies[i];
+        if (bodies.inverseMasses[body] == 0.0f)
+        {
+            continue;
+        }
+        startVelocityX[body] = bodies.velocityX[body];
+        startVelocityY[body] = bodies.velocityY[body];
+        startAngularVelocity[body] = bodies.angularVelocities[body];
+    }
+
+    for (int c = 0; c < count; ++c)
+    {
+        const int k = contacts[c];
+        Prepare(bodies, settings, pairs[k], manifolds[k], constraints[k]);
+    }
+
+    if (settings.warmStarting)
+    {
+        for (int c = 0; c < count; ++c)
+        {
+            WarmStart(bodies, constraints[contacts[c]]);
+        }
+    }
+
+    for (int iteration = 0; iteration < settings.velocityIterations; ++iteration)
+    {
+        for (int c = 0; c < count; ++c)
+        {
+            SolveVelocity(bodies, settings, constraints[contacts[c]]);
+        }
+    }
+
+    for (int i = bodyBegin; i < bodyEnd; ++i)
+    {
+        const int body = islands.islandBodies[i];
+        if (bodies.inverseMasses[body] == 0.0f)
+        {
+            continue;
+        }
+        bodies.positionX[body] += (bodies.velocityX[body] - startVelocityX[body]) * dt;
+        bodies.positionY[body] += (bodies.velocityY[body] - startVelocityY[body]) * dt;
+        bodies.angles[body] += (bodies.angularVelocities[body] - startAngularVelocity[body]) * dt;
+    }
+
+    for (int iteration = 0; iteration < settings.positionIterations; ++iteration)
+    {
+        for (int c = 0; c < count; ++c)
+        {
+            SolvePosition(bodies, settings, constraints[contacts[c]]);
+        }
+    }
+
+    // Keep the impulses for warm starting the next frame
+    for (int c = 0; c < count; ++c)
+    {
+        const int k = contacts[c];
+        for (int p = 0; p < constraints[k].pointCount; ++p)
+        {
+            manifolds[k].points[p].normalImpulse = constraints[k].points[p].normalImpulse;
+            manifolds[k].points[p].tangentImpulse = constraints[k].points[p].tangentImpulse;
+        }
+    }
+}
+
+void ContactSolver::Prepare(const Bodies &bodies, const SolverSettings &settings, const BroadphasePair &pair,
+                            const Manifold &manifold, Constraint &constraint) const
+{
+    const int a = pair.a;
+    const int b = pair.b;
+    constraint.a = a;
+    constraint.b = b;
+    constraint.normal = manifold.normal;
+    constraint.invMassA = bodies.inverseMasses[a];
+    constraint.invMassB = bodies.inverseMasses[b];
+    constraint.invInertiaA = bodies.inverseInertias[a];
+    constraint.invInertiaB = bodies.inverseInertias[b];
+    constraint.startPositionA = Vec2(bodies.positionX[a], bodies.positionY[a]);
+    constraint.startPositionB = Vec2(bodies.positionX[b], bodies.positionY[b]);
+    constraint.startAngleA = bodies.angles[a];
+    constraint.startAngleB = bodies.angles[b];
+    constraint.pointCount = manifold.pointCount;
+
+    const Vec2 velocityA(bodies.velocityX[a], bodies.velocityY[a]);
+    const Vec2 velocityB(bodies.velocityX[b], bodies.velocityY[b]);
+    const float angularVelocityA = bodies.angularVelocities[a];
+    const float angularVelocityB = bodies.angularVelocities[b];
+    const Vec2 tangent = Tangent(manifold.normal);
+
+    for (int p = 0; p < manifold.pointCount; ++p)
+    {
+        const ManifoldPoint &manifoldPoint = manifold.points[p];
+        Point &point = constraint.points[p];
+        point.rA = manifoldPoint.point - constraint.startPositionA;
+        point.rB = manifoldPoint.point - constraint.startPositionB;
+        point.separation = manifoldPoint.separation;
+        point.normalImpulse = settings.warmStarting ? manifoldPoint.normalImpulse : 0.0f;
+        point.tangentImpulse = settings.warmStarting ? manifoldPoint.tangentImpulse : 0.0f;
+
+        // Effective mass along the normal and the tangent, including rotation
+        const float rnA = point.rA.Cross(manifold.normal);
+        const float rnB = point.rB.Cross(manifold.normal);
+        const float normalK = constraint.invMassA + constraint.invMassB +
+                              constraint.invInertiaA * rnA * rnA + constraint.invInertiaB * rnB * rnB;
+        point.normalMass = normalK > 0.0f ? 1.0f / normalK : 0.0f;
+
+        const float rtA = point.rA.Cross(tangent);
+        const float rtB = point.rB.Cross(tangent);
+        const float tangentK = constraint.invMassA + constraint.invMassB +
+                               constraint.invInertiaA * rtA * rtA + constraint.invInertiaB * rtB * rtB;
+        point.tangentMass = tangentK > 0.0f ? 1.0f / tangentK : 0.0f;
+
+        // Bounce off fast impacts only; slow ones would keep a resting body
+        // hopping forever
+        const Vec2 relativeVelocity = velocityB + CrossScalar(angularVelocityB, point.rB) -
+                                      velocityA - CrossScalar(angularVelocityA, point.rA);
+        const float normalSpeed = relativeVelocity.Dot(manifold.normal);
+        point.velocityBias = normalSpeed < -settings.restitutionThreshold ? -settings.restitution * normalSpeed : 0.0f;
+    }
+
+    // Two points are solved together when the system is well conditioned.
+    // When it is not (the points are nearly on top of each other), one point
+    // is enough.
+    constraint.blockSolve = false;
+    if (manifold.pointCount == 2)
+    {
+        const Point &p1 = constraint.points[0];
+        const Point &p2 = constraint.points[1];
+        const float rn1A = p1.rA.Cross(manifold.normal);
+        const float rn1B = p1.rB.Cross(manifold.normal);
+        const float rn2A = p2.rA.Cross(manifold.normal);
+        const float rn2B = p2.rB.Cross(manifold.normal);
+        const float invMass = constraint.invMassA + constraint.invMassB;
+        const float k11 = invMass + constraint.invInertiaA * rn1A * rn1A + constraint.invInertiaB * rn1B * rn1B;
+        const float k22 = invMass + constraint.invInertiaA * rn2A * rn2A + constraint.invInertiaB * rn2B * rn2B;
+        const float k12 = invMass + constraint.invInertiaA * rn1A * rn2A + constraint.invInertiaB * rn1B * rn2B;
+        const float determinant = k11 * k22 - k12 * k12;
+
+        const float maxConditionNumber = 1000.0f;
+        if (k11 * k11 < maxConditionNumber * determinant)
+        {
+            constraint.blockSolve = true;
+            constraint.k11 = k11;
+            constraint.k12 = k12;
+            constraint.k22 = k22;
+            constraint.inverse11 = k22 / determinant;
+            constraint.inverse12 = -k12 / determinant;
+            constraint.inverse22 = k11 / determinant;
+        }
+        else
+        {
+            constraint.pointCount = 1;
+        }
+    }
+}
+
+void ContactSolver::WarmStart(const Bodies &bodies, const Constraint &constraint) const
+{
+    const int a = constraint.a;
+    const int b = constraint.b;
+    const Vec2 tangent = Tangent(constraint.normal);
+    Vec2 velocityA(bodies.velocityX[a], bodies.velocityY[a]);
+    Vec2 velocityB(bodies.velocityX[b], bodies.velocityY[b]);
+    float angularVelocityA = bodies.angularVelocities[a];
+    float angularVelocityB = bodies.angularVelocities[b];
+    for (int p = 0; p < constraint.pointCount; ++p)
+    {
+        const Point &point = constraint.points[p];
+        const Vec2 impulse = constraint.normal * point.normalImpulse + tangent * point.tangentImpulse;
+        velocityA -= impulse * constraint.invMassA;
+        angularVelocityA -= constraint.invInertiaA * point.rA.Cross(impulse);
+        velocityB += impulse * constraint.invMassB;
+        angularVelocityB += constraint.invInertiaB * point.rB.Cross(impulse);
+    }
+    StoreVelocity(bodies, a, constraint.invMassA, velocityA, angularVelocityA);
+    StoreVelocity(bodies, b, constraint.invMassB, velocityB, angularVelocityB);
+}
+
+void ContactSolver::SolveVelocity(const Bodies &bodies, const SolverSettings &settings, Constraint &constraint) const
+{
+    const int a = constraint.a;
+    const int b = constraint.b;
+    const Vec2 normal = constraint.normal;
+    const Vec2 tangent = Tangent(normal);
+
+    Vec2 velocityA(bodies.velocityX[a], bodies.velocityY[a]);
+    Vec2 velocityB(bodies.velocityX[b], bodies.velocityY[b]);
+    float angularVelocityA = bodies.angularVelocities[a];
+    float angularVelocityB = bodies.angularVelocities[b];
+
+    auto apply = [&](const Point &point, const Vec2 &impulse)
+    {
+        velocityA -= impulse * constraint.invMassA;
+        angularVelocityA -= constraint.invInertiaA * point.rA.Cross(impulse);
+        velocityB += impulse * constraint.invMassB;
+        angularVelocityB += constraint.invInertiaB * point.rB.Cross(impulse);
+    };
+    auto relativeVelocity = [&](const Point &point)
+    {
+        return velocityB + CrossScalar(angularVelocityB, point.rB) - velocityA - CrossScalar(angularVelocityA, point.rA);
+    };
+
+    // Friction first: the normal impulses are the more important ones, so
+    // they get the last word
+    for (int p = 0; p < constraint.pointCount; ++p)
+    {
+        Point &point = constraint.points[p];
+        const float tangentSpeed = relativeVelocity(point).Dot(tangent);
+        const float maxFriction = settings.friction * point.normalImpulse;
+        const float newImpulse = std::clamp(point.tangentImpulse - point.tangentMass * tangentSpeed, -maxFriction, maxFriction);
+        const float lambda = newImpulse - point.tangentImpulse;
+        point.tangentImpulse = newImpulse;
+        apply(point, tangent * lambda);
+    }
+
+    if (constraint.blockSolve)
+    {
+        SolveNormalBlock(constraint, velocityA, angularVelocityA, velocityB, angularVelocityB);
+    }
+    for (int p = 0; p < constraint.pointCount && !constraint.blockSolve; ++p)
+    {
+        Point &point = constraint.points[p];
+        const float normalSpeed = relativeVelocity(point).Dot(normal);
+        const float newImpulse = std::max(point.normalImpulse - point.normalMass * (normalSpeed - point.velocityBias), 0.0f);
+        const float lambda = newImpulse - point.normalImpulse;
+        point.normalImpulse = newImpulse;
+        apply(point, normal * lambda);
+    }
+
+    StoreVelocity(bodies, a, constraint.invMassA, velocityA, angularVelocityA);
+    StoreVelocity(bodies, b, constraint.invMassB, velocityB, angularVelocityB);
+}
+
+// Both normal impulses at once: the total impulses x must satisfy
+// K x + b = speeds, with x >= 0, speeds >= 0 and x * speeds = 0 (a point
+// either pushes or separates). With two points there are only four cases to
+// try: both push, only the first, only the second, or neither.
+void ContactSolver::SolveNormalBlock(Constraint &constraint, Vec2 &velocityA, float &angularVelocityA,
+                                     Vec2 &velocityB, float &angularVelocityB) const
+{
+    Point &p1 = constraint.points[0];
+    Point &p2 = constraint.points[1];
+    const Vec2 normal = constraint.normal;
+
+    const Vec2 dv1 = velocityB + CrossScalar(angularVelocityB, p1.rB) - velocityA - CrossScalar(angularVelocityA, p1.rA);
+    const Vec2 dv2 = velocityB + CrossScalar(angularVelocityB, p2.rB) - velocityA - CrossScalar(angularVelocityA, p2.rA);
+    const float a1 = p1.normalImpulse;
+    const float a2 = p2.normalImpulse;
+
+    // Speeds the current impulses would give if they were removed
+    const float b1 = dv1.Dot(normal) - p1.velocityBias - (constraint.k11 * a1 + constraint.k12 * a2);
+    const float b2 = dv2.Dot(normal) - p2.velocityBias - (constraint.k12 * a1 + constraint.k22 * a2);
+
+    float x1;
+    float x2;
+    for (;;)
+    {
+        // Both points push
+        x1 = -(constraint.inverse11 * b1 + constraint.inverse12 * b2);
+        x2 = -(constraint.inverse12 * b1 + constraint.inverse22 * b2);
+        if (x1 >= 0.0f && x2 >= 0.0f)
+            break;
+
+        // Only the first one
+        x1 = -b1 / constraint.k11;
+        x2 = 0.0f;
+        if (x1 >= 0.0f && constraint.k12 * x1 + b2 >= 0.0f)
+            break;
+
+        // Only the second one
+        x1 = 0.0f;
+        x2 = -b2 / constraint.k22;
+        if (x2 >= 0.0f && constraint.k12 * x2 + b1 >= 0.0f)
+            break;
+
+        // Neither
+        x1 = 0.0f;
+        x2 = 0.0f;
+        if (b1 >= 0.0f && b2 >= 0.0f)
+            break;
+
+        // No exact solution (numerical noise): keep the old impulses
+        return;
+    }
+
+    const Vec2 impulse1 = normal * (x1 - a1);
+    const Vec2 impulse2 = normal * (x2 - a2);
+    velocityA -= (impulse1 + impulse2) * constraint.invMassA;
+    angularVelocityA -= constraint.invInertiaA * (p1.rA.Cross(impulse1) + p2.rA.Cross(impulse2));
+    velocityB += (impulse1 + impulse2) * constraint.invMassB;
+    angularVelocityB += constraint.invInertiaB * (p1.rB.Cross(impulse1) + p2.rB.Cross(impulse2));
+    p1.normalImpulse = x1;
+    p2.normalImpulse = x2;
+}
+
+// The separation is not measured again from the shapes: the contact points
+// move with their bodies, so how far the bodies moved along the normal since
+// Prepare tells how much of the overlap is gone.
+//
+// Like the normal impulses, the two points of a manifold are corrected
+// together when possible. Correcting them one after the other tilts the body
+// a little every step, always the same way, until a stack falls over.
+void ContactSolver::SolvePosition(const Bodies &bodies, const SolverSettings &settings, const Constraint &constraint) const
+{
+    const int a = constraint.a;
+    const int b = constraint.b;
+    const Vec2 normal = constraint.normal;
+
+    Vec2 positionA(bodies.positionX[a], bodies.positionY[a]);
+    Vec2 positionB(bodies.positionX[b], bodies.positionY[b]);
+    float angleA = bodies.angles[a];
+    float angleB = bodies.angles[b];
+
+    auto correction = [&](const Point &point)
+    {
+        const Vec2 movedA = positionA - constraint.startPositionA + CrossScalar(angleA - constraint.startAngleA, point.rA);
+        const Vec2 movedB = positionB - constraint.startPositionB + CrossScalar(angleB - constraint.startAngleB, point.rB);
+        const float separation = point.separation + (movedB - movedA).Dot(normal);
+        return std::clamp(settings.baumgarte * (separation + settings.linearSlop), -settings.maxCorrection, 0.0f);
+    };
+    auto apply = [&](const Point &point, const Vec2 &impulse)
+    {
+        positionA -= impulse * constraint.invMassA;
+        angleA -= constraint.invInertiaA * point.rA.Cross(impulse);
+        positionB += impulse * constraint.invMassB;
+        angleB += constraint.invInertiaB * point.rB.Cross(impulse);
+    };
+
+    bool solved = false;
+    if (constraint.blockSolve)
+    {
+        const float c1 = correction(constraint.points[0]);
+        const float c2 = correction(constraint.points[1]);
+        const float x1 = -(constraint.inverse11 * c1 + constraint.inverse12 * c2);
+        const float x2 = -(constraint.inverse12 * c1 + constraint.inverse22 * c2);
+        if (x1 >= 0.0f && x2 >= 0.0f)
+        {
+            apply(constraint.points[0], normal * x1);
+            apply(constraint.points[1], normal * x2);
+            solved = true;
+        }
+    }
+
+    for (int p = 0; p < constraint.pointCount && !solved; ++p)
+    {
+        const Point &point = constraint.points[p];
+        apply(point, normal * (-correction(point) * point.normalMass));
+    }
+
+    StorePosition(bodies, a, constraint.invMassA, positionA, angleA);
+    StorePosition(bodies, b, constraint.invMassB, positionB, angleB);
+}
@@ -0,0 +1,659 @@
+#include <Distance.h>
+#include <CircleShape.h>
+#include <PolygonShape.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace
+{
+    const int maxIterations = 20;
+    const int maxPolytopeVertices = 32;
+    const int maxEpaIterations = 64;
+    const int maxTimeOfImpactIterations = 50;
+    const float epaTolerance = 1e-3f; // pixels
+    const float epsilon = std::numeric_limits<float>::epsilon();
+
+    // A shape placed in the world, as GJK sees it: its core vertices and its
+    // radius. Built once per query from the type tag, so that the support
+    // queries in the loops below are plain calls, not virtual ones.
+    struct Proxy
+    {
+        Proxy(const Shape &shape, const Vec2 &position) : position(position)
+        {
+            if (shape.GetType() == Shape::POLYGON)
+            {
+                polygon = static_cast<const PolygonShape *>(&shape);
+                count = static_cast<int>(polygon->worldVertices.size());
+            }
+            else
+            {
+                radius = static_cast<const CircleShape &>(shape).radius;
+            }
+        }
+
+        const PolygonShape *polygon = nullptr; // Null for a circle, whose core is its centre
+        Vec2 position;
+        int count = 1;
+        float radius = 0.0f;
+
+        int GetSupport(const Vec2 &direction) const { return polygon ? polygon->FindSupport(direction) : 0; }
+        Vec2 GetVertex(int index) const { return polygon ? polygon->worldVertices[index] : position; }
+    };
+
+    // A point of the Minkowski difference B - A, and the vertices it came from
+    struct SimplexVertex
+    {
+        Vec2 wA; // Vertex of A
+        Vec2 wB; // Vertex of B
+        Vec2 w;  // wB - wA
+        float a; // Weight of this vertex in the closest point
+        int indexA;
+        int indexB;
+    };
+
+    struct Simplex
+    {
+        SimplexVertex v[3];
+        int count;
+    };
+
+    SimplexVertex MakeVertex(const Proxy &proxyA, int indexA, const Proxy &proxyB, int indexB)
+    {
+        SimplexVertex vertex;
+        vertex.indexA = indexA;
+        vertex.indexB = indexB;
+        vertex.wA = proxyA.GetVertex(indexA);
+        vertex.wB = proxyB.GetVertex(indexB);
+        vertex.w = vertex.wB - vertex.wA;
+        vertex.a = 1.0f;
+        return vertex;
+    }
+
+    // The support point of B - A along direction
+    SimplexVertex Support(const Proxy &proxyA, const Proxy &proxyB, const Vec2 &direction)
+    {
+        return MakeVertex(proxyA, proxyA.GetSupport(-direction), proxyB, proxyB.GetSupport(direction));
+    }
+
+    void ReadCache(Simplex &simplex, const SimplexCache &cache, const Proxy &proxyA, const Proxy &proxyB)
+    {
+        simplex.count = 0;
+        const int countA = proxyA.count;
+        const int countB = proxyB.count;
+        const int cacheCount = std::min(static_cast<int>(cache.count), 3);
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            if (cache.indexA[i] >= countA || cache.indexB[i] >= countB)
+            {
+                simplex.count = 0; // The cache belongs to other shapes
+                break;
+            }
+            simplex.v[simplex.count++] = MakeVertex(proxyA, cache.indexA[i], proxyB, cache.indexB[i]);
+        }
+
+        // The shapes may have turned enough to flatten the old simplex;
+        // start over from one of its vertices then
+        if (simplex.count == 2 && (simplex.v[1].w - simplex.v[0].w).MagnitudeSq() < epsilon)
+        {
+            simplex.count = 1;
+        }
+        if (simplex.count == 3 &&
+            std::fabs((simplex.v[1].w - simplex.v[0].w).Cross(simplex.v[2].w - simplex.v[0].w)) < epsilon)
+        {
+            simplex.count = 1;
+        }
+
+        if (simplex.count == 0)
+        {
+            simplex.v[0] = MakeVertex(proxyA, 0, proxyB, 0);
+            simplex.count = 1;
+        }
+    }
+
+    void WriteCache(const Simplex &simplex, SimplexCache &cache)
+    {
+        cache.count = static_cast<std::uint8_t>(simplex.count);
+        for (int i = 0; i < simplex.count; ++i)
+        {
+            cache.indexA[i] = static_cast<std::uint16_t>(simplex.v[i].indexA);
+            cache.indexB[i] = static_cast<std::uint16_t>(simplex.v[i].indexB);
+        }
+    }
+
+    // Direction from the simplex towards the origin
+    Vec2 SearchDirection(const Simplex &simplex)
+    {
+        if (simplex.count == 1)
+        {
+            return -simplex.v[0].w;
+        }
+
+        // Perpendicular to the segment, on the side of the origin
+        const Vec2 edge = simplex.v[1].w - simplex.v[0].w;
+        const float side = edge.Cross(-simplex.v[0].w);
+        return side > 0.0f ? edge.Perpendicular() : -edge.Perpendicular();
+    }
+
+    // Closest points on A and B, from the weights of the simplex vertices
+    void WitnessPoints(const Simplex &simplex, Vec2 &pointA, Vec2 &pointB)
+    {
+        pointA = Vec2();
+        pointB = Vec2();
+        for (int i = 0; i < simplex.count; ++i)
+        {
+            pointA += simplex.v[i].wA * simplex.v[i].a;
+            pointB += simplex.v[i].wB * simplex.v[i].a;
+        }
+        if (simplex.count == 3)
+        {
+            pointB = pointA; // The origin is inside: both are the same point
+        }
+    }
+
+    // Closest point of a segment to the origin. Keeps only the vertex the
+    // origin is next to when it is past one end.
+    void Solve2(Simplex &simplex)
+    {
+        const Vec2 w1 = simplex.v[0].w;
+        const Vec2 w2 = simplex.v[1].w;
+        const Vec2 e12 = w2 - w1;
+
+        // Past w1
+        const float d12_2 = -w1.Dot(e12);
+        if (d12_2 <= 0.0f)
+        {
+            simplex.v[0].a = 1.0f;
+            simplex.count = 1;
+            return;
+        }
+
+        // Past w2
+        const float d12_1 = w2.Dot(e12);
+        if (d12_1 <= 0.0f)
+        {
+            simplex.v[1].a = 1.0f;
+            simplex.count = 1;
+            simplex.v[0] = simplex.v[1];
+            return;
+        }
+
+        const float inverse = 1.0f / (d12_1 + d12_2);
+        simplex.v[0].a = d12_1 * inverse;
+        simplex.v[1].a = d12_2 * inverse;
+        simplex.count = 2;
+    }
+
+    // Closest point of a triangle to the origin, by the region of the
+    // triangle (vertex, edge or inside) the origin falls in. Keeps only the
+    // vertices of that region.
+    void Solve3(Simplex &simplex)
+    {
+        const Vec2 w1 = simplex.v[0].w;
+        const Vec2 w2 = simplex.v[1].w;
+        const Vec2 w3 = simplex.v[2].w;
+
+        // Barycentric coordinates (unnormalized) on each edge
+        const Vec2 e12 = w2 - w1;
+        const float d12_1 = w2.Dot(e12);
+        const float d12_2 = -w1.Dot(e12);
+
+        const Vec2 e13 = w3 - w1;
+        const float d13_1 = w3.Dot(e13);
+        const float d13_2 = -w1.Dot(e13);
+
+        const Vec2 e23 = w3 - w2;
+        const float d23_1 = w3.Dot(e23);
+        const float d23_2 = -w2.Dot(e23);
+
+        // And in the triangle
+        const float n123 = e12.Cross(e13);
+        const float d123_1 = n123 * w2.Cross(w3);
+        const float d123_2 = n123 * w3.Cross(w1);
+        const float d123_3 = n123 * w1.Cross(w2);
+
+        if (d12_2 <= 0.0f && d13_2 <= 0.0f)
+        {
+            simplex.v[0].a = 1.0f;
+            simplex.count = 1;
+            return;
+        }
+
+        if (d12_1 > 0.0f && d12_2 > 0.0f && d123_3 <= 0.0f)
+        {
+            const float inverse = 1.0f / (d12_1 + d12_2);
+            simplex.v[0].a = d12_1 * inverse;
+            simplex.v[1].a = d12_2 * inverse;
+            simplex.count = 2;
+            return;
+        }
+
+        if (d13_1 > 0.0f && d13_2 > 0.0f && d123_2 <= 0.0f)
+        {
+            const float inverse = 1.0f / (d13_1 + d13_2);
+            simplex.v[0].a = d13_1 * inverse;
+            simplex.v[2].a = d13_2 * inverse;
+            simplex.count = 2;
+            simplex.v[1] = simplex.v[2];
+            return;
+        }
+
+        if (d12_1 <= 0.0f && d23_2 <= 0.0f)
+        {
+            simplex.v[1].a = 1.0f;
+            simplex.count = 1;
+            simplex.v[0] = simplex.v[1];
+            return;
+        }
+
+        if (d13_1 <= 0.0f && d23_1 <= 0.0f)
+        {
+            simplex.v[2].a = 1.0f;
+            simplex.count = 1;
+            simplex.v[0] = simplex.v[2];
+            return;
+        }
+
+        if (d23_1 > 0.0f && d23_2 > 0.0f && d123_1 <= 0.0f)
+        {
+            const float inverse = 1.0f / (d23_1 + d23_2);
+            simplex.v[1].a = d23_1 * inverse;
+            simplex.v[2].a = d23_2 * inverse;
+            simplex.count = 2;
+            simplex.v[0] = simplex.v[2];
+            return;
+        }
+
+        const float inverse = 1.0f / (d123_1 + d123_2 + d123_3);
+        simplex.v[0].a = d123_1 * inverse;
+        simplex.v[1].a = d123_2 * inverse;
+        simplex.v[2].a = d123_3 * inverse;
+        simplex.count = 3;
+    }
+
+    // GJK on the cores of the shapes. Ends with the simplex closest to the
+    // origin: a triangle around it when the cores overlap.
+    Simplex RunGJK(const Proxy &proxyA, const Proxy &proxyB, SimplexCache &cache, int &iterations)
+    {
+        Simplex simplex;
+        ReadCache(simplex, cache, proxyA, proxyB);
+
+        iterations = 0;
+        while (iterations < maxIterations)
+        {
+            int savedA[3];
+            int savedB[3];
+            const int savedCount = simplex.count;
+            for (int i = 0; i < savedCount; ++i)
+            {
+                savedA[i] = simplex.v[i].indexA;
+                savedB[i] = simplex.v[i].indexB;
+            }
+
+            if (simplex.count == 2)
+                Solve2(simplex);
+            else if (simplex.count == 3)
+                Solve3(simplex);
+
+            if (simplex.count == 3)
+            {
+                break; // The origin is inside the triangle: the cores overlap
+            }
+
+            const Vec2 direction = SearchDirection(simplex);
+            if (direction.MagnitudeSq() < epsilon * epsilon)
+            {
+                break; // The origin is on the simplex: the cores touch
+            }
+
+            SimplexVertex &vertex = simplex.v[simplex.count];
+            vertex = Support(proxyA, proxyB, direction);
+            ++iterations;
+
+            // A support point we already had: no closer point exists
+            bool duplicate = false;
+            for (int i = 0; i < savedCount; ++i)
+            {
+                if (vertex.indexA == savedA[i] && vertex.indexB == savedB[i])
+                {
+                    duplicate = true;
+                    break;
+                }
+            }
+            if (duplicate)
+            {
+                break;
+            }
+
+            ++simplex.count;
+        }
+
+        // Out of iterations right after adding a vertex: weigh it in too
+        if (iterations == maxIterations)
+        {
+            if (simplex.count == 2)
+                Solve2(simplex);
+            else if (simplex.count == 3)
+                Solve3(simplex);
+        }
+
+        WriteCache(simplex, cache);
+        return simplex;
+    }
+
+    // Turns a simplex that holds the origin on its boundary (a point or a
+    // segment through it) into a triangle, so EPA has a polytope to grow.
+    // Fails when the Minkowski difference itself is that flat.
+    bool CompleteTriangle(Simplex &simplex, const Proxy &proxyA, const Proxy &proxyB)
+    {
+        if (simplex.count == 1)
+        {
+            const Vec2 directions[4] = {Vec2(1.0f, 0.0f), Vec2(-1.0f, 0.0f), Vec2(0.0f, 1.0f), Vec2(0.0f, -1.0f)};
+            for (const Vec2 &direction : directions)
+            {
+                const SimplexVertex vertex = Support(proxyA, proxyB, direction);
+                if ((vertex.w - simplex.v[0].w).MagnitudeSq() > epsilon)
+                {
+                    simplex.v[simplex.count++] = vertex;
+                    break;
+                }
+            }
+        }
+        if (simplex.count == 2)
+        {
+            const Vec2 edge = simplex.v[1].w - simplex.v[0].w;
+            const Vec2 directions[2] = {edge.Perpendicular(), -edge.Perpendicular()};
+            for (const Vec2 &direction : directions)
+            {
+                const SimplexVertex vertex = Support(proxyA, proxyB, direction);
+                if (std::fabs(edge.Cross(vertex.w - simplex.v[0].w)) > epsilon)
+                {
+                    simplex.v[simplex.count++] = vertex;
+                    break;
+                }
+            }
+        }
+        return simplex.count == 3;
+    }
+
+    // EPA: grows the polytope around the origin until the edge closest to the
+    // origin is on the boundary of the Minkowski difference. normal points
+    // from A to B, and depth is how far B must move along it to stop
+    // overlapping.
+    void RunEPA(const Simplex &simplex, const Proxy &proxyA, const Proxy &proxyB,
+                Vec2 &normal, float &depth, Vec2 &pointA, Vec2 &pointB)
+    {
+        SimplexVertex polytope[maxPolytopeVertices];
+        int count = 3;
+        polytope[0] = simplex.v[0];
+        polytope[1] = simplex.v[1];
+        polytope[2] = simplex.v[2];
+
+        // Counter-clockwise (in a y-up frame), so the right-hand
+        // perpendicular of each edge points outwards
+        if ((polytope[1].w - polytope[0].w).Cross(polytope[2].w - polytope[0].w) < 0.0f)
+        {
+            std::swap(polytope[1], polytope[2]);
+        }
+
+        int bestEdge = 0;
+        Vec2 bestNormal(0.0f, 1.0f);
+        float bestDistance = 0.0f;
+        for (int iteration = 0; iteration < maxEpaIterations; ++iteration)
+        {
+            bestDistance = std::numeric_limits<float>::max();
+            for (int i = 0; i < count; ++i)
+            {
+                const Vec2 &a = polytope[i].w;
+                const Vec2 &b = polytope[(i + 1) % count].w;
+                const Vec2 edge = b - a;
+                const float length = edge.Magnitude();
+                if (length < epsilon)
+                {
+                    continue;
+                }
+                const Vec2 edgeNormal = Vec2(edge.y, -edge.x) / length;
+                const float distance = edgeNormal.Dot(a);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    bestEdge = i;
+                    bestNormal = edgeNormal;
+                }
+            }
+
+            // Done once the boundary does not reach past the closest edge
+            const SimplexVertex vertex = Support(proxyA, proxyB, bestNormal);
+            if (bestNormal.Dot(vertex.w) - bestDistance < epaTolerance || count == maxPolytopeVertices)
+            {
+                break;
+            }
+
+            int inserted = bestEdge + 1;
+            for (int i = count; i > inserted; --i)
+            {
+                polytope[i] = polytope[i - 1];
+            }
+            polytope[inserted] = vertex;
+            ++count;
+
+            // The GJK triangle may have corners inside the difference (a
+            // difference of two vertices is not always on its boundary). Drop
+            // the neighbours the new vertex leaves dented in, so the polytope
+            // stays convex.
+            auto isDented = [&](int i)
+            {
+                const Vec2 &previous = polytope[(i + count - 1) % count].w;
+                const Vec2 &next = polytope[(i + 1) % count].w;
+                return (polytope[i].w - previous).Cross(next - polytope[i].w) <= 0.0f;
+            };
+            auto erase = [&](int i)
+            {
+                for (int j = i; j < count - 1; ++j)
+                {
+                    polytope[j] = polytope[j + 1];
+                }
+                --count;
+            };
+            while (count > 3 && isDented((inserted + 1) % count))
+            {
+                const int next = (inserted + 1) % count;
+                erase(next);
+                if (next < inserted)
+                {
+                    --inserted;
+                }
+            }
+            while (count > 3 && isDented((inserted + count - 1) % count))
+            {
+                const int previous = (inserted + count - 1) % count;
+                erase(previous);
+                if (previous < inserted)
+                {
+                    --inserted;
+                }
+            }
+        }
+
+        // Where the origin projects onto the closest edge, on both shapes
+        const SimplexVertex &a = polytope[bestEdge];
+        const SimplexVertex &b = polytope[(bestEdge + 1) % count];
+        const Vec2 edge = b.w - a.w;
+        const float lengthSquared = edge.MagnitudeSq();
+        float t = lengthSquared > epsilon ? -a.w.Dot(edge) / lengthSquared : 0.0f;
+        t = std::fmin(std::fmax(t, 0.0f), 1.0f);
+        pointA = a.wA + (b.wA - a.wA) * t;
+        pointB = a.wB + (b.wB - a.wB) * t;
+
+        // The edge normal points out of B - A; B leaves A the other way
+        normal = -bestNormal;
+        depth = std::fmax(bestDistance, 0.0f);
+    }
+
+    // Core distance below which the cores count as touching
+    const float touchingDistance = 1e-4f; // pixels
+}
+
+namespace Distance
+{
+    DistanceOutput Compute(const Shape &shapeA, const Vec2 &positionA,
+                           const Shape &shapeB, const Vec2 &positionB, SimplexCache &cache)
+    {
+        const Proxy proxyA(shapeA, positionA);
+        const Proxy proxyB(shapeB, positionB);
+
+        DistanceOutput output;
+        const Simplex simplex = RunGJK(proxyA, proxyB, cache, output.iterations);
+        WitnessPoints(simplex, output.pointA, output.pointB);
+
+        const float coreDistance = (output.pointB - output.pointA).Magnitude();
+        const float radii = proxyA.radius + proxyB.radius;
+        if (simplex.count == 3 || coreDistance < touchingDistance)
+        {
+            output.normal = Vec2();
+            output.pointB = output.pointA;
+            output.distance = 0.0f;
+            return output;
+        }
+
+        output.normal = (output.pointB - output.pointA) / coreDistance;
+        if (coreDistance > radii)
+        {
+            output.pointA += output.normal * proxyA.radius;
+            output.pointB -= output.normal * proxyB.radius;
+            output.distance = coreDistance - radii;
+        }
+        else
+        {
+            // The rounded parts overlap: meet halfway
+            const Vec2 middle = output.pointA + output.normal * (0.5f * (coreDistance + proxyA.radius - proxyB.radius));
+            output.pointA = middle;
+            output.pointB = middle;
+            output.distance = 0.0f;
+        }
+        return output;
+    }
+
+    DistanceOutput ComputeSigned(const Shape &shapeA, const Vec2 &positionA,
+                                 const Shape &shapeB, const Vec2 &positionB, SimplexCache &cache)
+    {
+        const Proxy proxyA(shapeA, positionA);
+        const Proxy proxyB(shapeB, positionB);
+
+        DistanceOutput output;
+        Simplex simplex = RunGJK(proxyA, proxyB, cache, output.iterations);
+        WitnessPoints(simplex, output.pointA, output.pointB);
+
+        const float coreDistance = (output.pointB - output.pointA).Magnitude();
+        const float radiusA = proxyA.radius;
+        const float radiusB = proxyB.radius;
+        float coreSeparation = coreDistance;
+        if (simplex.count == 3 || coreDistance < touchingDistance)
+        {
+            float depth = 0.0f;
+            output.normal = Vec2(0.0f, 1.0f);
+            if (CompleteTriangle(simplex, proxyA, proxyB))
+            {
+                RunEPA(simplex, proxyA, proxyB, output.normal, depth, output.pointA, output.pointB);
+            }
+            coreSeparation = -depth;
+        }
+        else
+        {
+            output.normal = (output.pointB - output.pointA) / coreDistance;
+        }
+
+        output.pointA += output.normal * radiusA;
+        output.pointB -= output.normal * radiusB;
+        output.distance = coreSeparation - radiusA - radiusB;
+        return output;
+    }
+
+    bool TestOverlap(const Shape &shapeA, const Vec2 &positionA, const Shape &shapeB, const Vec2 &positionB)
+    {
+        SimplexCache cache;
+        return Compute(shapeA, positionA, shapeB, positionB, cache).distance <= 0.0f;
+    }
+
+    TimeOfImpactOutput TimeOfImpact(Shape &shapeA, const Sweep &sweepA, Shape &shapeB, const Sweep &sweepB,
+                                    float targetDistance)
+    {
+        // How far any core point of a shape lies from its body position
+        auto reach = [](const Shape &shape, const Vec2 &position)
+        {
+            float reachSquared = 0.0f;
+            for (int i = 0; i < shape.GetVertexCount(); ++i)
+            {
+                reachSquared = std::fmax(reachSquared, (shape.GetVertex(i, position) - position).MagnitudeSq());
+            }
+            return std::sqrt(reachSquared);
+        };
+
+        const float tolerance = 0.25f * targetDistance;
+        SimplexCache cache;
+        TimeOfImpactOutput output;
+        output.state = TimeOfImpactOutput::SEPARATED;
+        output.t = 1.0f;
+
+        float t = 0.0f;
+        float bound = 0.0f;
+        for (int iteration = 0; iteration < maxTimeOfImpactIterations; ++iteration)
+        {
+            const Transform transformA = sweepA.GetTransform(t);
+            const Transform transformB = sweepB.GetTransform(t);
+            shapeA.UpdateWorldVertices(transformA);
+            shapeB.UpdateWorldVertices(transformB);
+            const DistanceOutput distance = Compute(shapeA, transformA.position, shapeB, transformB.position, cache);
+
+            if (iteration == 0)
+            {
+                if (distance.distance < targetDistance + tolerance)
+                {
+                    // Already touching, maybe overlapping: only EPA has a normal then
+                    const DistanceOutput contact = ComputeSigned(shapeA, transformA.position, shapeB, transformB.position, cache);
+                    output.state = TimeOfImpactOutput::OVERLAPPED;
+                    output.t = 0.0f;
+                    output.normal = contact.normal;
+                    output.point = (contact.pointA + contact.pointB) * 0.5f;
+                    return output;
+                }
+                const Vec2 relativeMotion = (sweepA.position1 - sweepA.position0) - (sweepB.position1 - sweepB.position0);
+                bound = relativeMotion.Magnitude() +
+                        std::fabs(sweepA.angle1 - sweepA.angle0) * reach(shapeA, transformA.position) +
+                        std::fabs(sweepB.angle1 - sweepB.angle0) * reach(shapeB, transformB.position);
+                if (bound <= 0.0f)
+                {
+                    return output; // Neither moves
+                }
+            }
+
+            if (distance.distance < targetDistance + tolerance)
+            {
+                output.state = TimeOfImpactOutput::HIT;
+                output.t = t;
+                output.normal = distance.normal;
+                output.point = (distance.pointA + distance.pointB) * 0.5f;
+                return output;
+            }
+
+            t += (distance.distance - targetDistance) / bound;
+            if (t >= 1.0f)
+            {
+                return output;
+            }
+        }
+
+        // Out of iterations: t is still before the impact, so stopping there is safe
+        output.state = TimeOfImpactOutput::HIT;
+        output.t = t;
+        const Transform transformA = sweepA.GetTransform(t);
+        const Transform transformB = sweepB.GetTransform(t);
+        shapeA.UpdateWorldVertices(transformA);
+        shapeB.UpdateWorldVertices(transformB);
+        const DistanceOutput distance = Compute(shapeA, transformA.position, shapeB, transformB.position, cache);
+        output.normal = distance.normal;
+        output.point = (distance.pointA + distance.pointB) * 0.5f;
+        return output;
+    }
+} // namespace Distance
@@ -0,0 +1,297 @@
+#include <DynamicTree.h>
+#include <algorithm>
+
+DynamicTree::DynamicTree(float margin) : margin(margin)
+{
+}
+
+int DynamicTree::AllocateNode()
+{
+    if (freeList == nullNode)
+    {
+        nodes.emplace_back();
+        return static_cast<int>(nodes.size()) - 1;
+    }
+
+    const int nodeId = freeList;
+    freeList = nodes[nodeId].parent;
+    nodes[nodeId] = Node();
+    return nodeId;
+}
+
+void DynamicTree::FreeNode(int nodeId)
+{
+    nodes[nodeId].parent = freeList;
+    nodes[nodeId].height = -1;
+    freeList = nodeId;
+}
+
+int DynamicTree::CreateProxy(const AABB &aabb, int userData)
+{
+    const int proxyId = AllocateNode();
+    nodes[proxyId].aabb = aabb.Fattened(margin);
+    nodes[proxyId].userData = userData;
+    nodes[proxyId].height = 0;
+    InsertLeaf(proxyId);
+    ++proxyCount;
+    return proxyId;
+}
+
+void DynamicTree::DestroyProxy(int proxyId)
+{
+    RemoveLeaf(proxyId);
+    FreeNode(proxyId);
+    --proxyCount;
+}
+
+bool DynamicTree::MoveProxy(int proxyId, const AABB &aabb)
+{
+    if (nodes[proxyId].aabb.Contains(aabb))
+    {
+        return false;
+    }
+
+    RemoveLeaf(proxyId);
+    nodes[proxyId].aabb = aabb.Fattened(margin);
+    InsertLeaf(proxyId);
+    return true;
+}
+
+void DynamicTree::InsertLeaf(int leaf)
+{
+    if (root == nullNode)
+    {
+        root = leaf;
+        nodes[root].parent = nullNode;
+        return;
+    }
+
+    // 1. Walk down the tree looking for the cheapest sibling. The cost of a
+    //    node is its perimeter; a node "inherits" the growth of its ancestors.
+    const AABB leafAABB = nodes[leaf].aabb;
+    int index = root;
+    while (!nodes[index].IsLeaf())
+    {
+        const int child1 = nodes[index].child1;
+        const int child2 = nodes[index].child2;
+
+        const float area = nodes[index].aabb.Perimeter();
+        const float combinedArea = AABB::Combine(nodes[index].aabb, leafAABB).Perimeter();
+
+        // Cost of making a new parent for this node and the leaf
+        const float cost = 2.0f * combinedArea;
+        // Minimum cost of pushing the leaf further down the tree
+        const float inheritanceCost = 2.0f * (combinedArea - area);
+
+        auto descendCost = [&](int child)
+        {
+            const AABB combined = AABB::Combine(leafAABB, nodes[child].aabb);
+            if (nodes[child].IsLeaf())
+                return combined.Perimeter() + inheritanceCost;
+            return combined.Perimeter() - nodes[child].aabb.Perimeter() + inheritanceCost;
+        };
+        const float cost1 = descendCost(child1);
+        const float cost2 = descendCost(child2);
+
+        if (cost < cost1 && cost < cost2)
+            break;
+
+        index = cost1 < cost2 ? child1 : child2;
+    }
+    const int sibling = index;
+
+    // 2. Create a new parent for the sibling and the leaf
+    const int oldParent = nodes[sibling].parent;
+    const int newParent = AllocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].aabb = AABB::Combine(leafAABB, nodes[sibling].aabb);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent == nullNode)
+    {
+        root = newParent;
+    }
+    else if (nodes[oldParent].child1 == sibling)
+    {
+        nodes[oldParent].child1 = newParent;
+    }
+    else
+    {
+        nodes[oldParent].child2 = newParent;
+    }
+
+    // 3. Walk back up, refitting boxes and rebalancing
+    index = nodes[leaf].parent;
+    while (index != nullNode)
+    {
+        index = Balance(index);
+
+        const int child1 = nodes[index].child1;
+        const int child2 = nodes[index].child2;
+        nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+        nodes[index].aabb = AABB::Combine(nodes[child1].aabb, nodes[child2].aabb);
+
+        index = nodes[index].parent;
+    }
+}
+
+void DynamicTree::RemoveLeaf(int leaf)
+{
+    if (leaf == root)
+    {
+        root = nullNode;
+        return;
+    }
+
+    const int parent = nodes[leaf].parent;
+    const int grandParent = nodes[parent].parent;
+    const int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    if (grandParent == nullNode)
+    {
+        root = sibling;
+        nodes[sibling].parent = nullNode;
+        FreeNode(parent);
+        return;
+    }
+
+    // Replace the parent with the sibling
+    if (nodes[grandParent].child1 == parent)
+        nodes[grandParent].child1 = sibling;
+    else
+        nodes[grandParent].child2 = sibling;
+    nodes[sibling].parent = grandParent;
+    FreeNode(parent);
+
+    int index = grandParent;
+    while (index != nullNode)
+    {
+        index = Balance(index);
+
+        const int child1 = nodes[index].child1;
+        const int child2 = nodes[index].child2;
+        nodes[index].aabb = AABB::Combine(nodes[child1].aabb, nodes[child2].aabb);
+        nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+
+        index = nodes[index].parent;
+    }
+}
+
+// Performs a tree rotation if node A is imbalanced and returns the new root
+// of the subtree. Node names follow the layout
+//   A = (B, C),  B = (D, E),  C = (F, G)
+int DynamicTree::Balance(int iA)
+{
+    Node &A = nodes[iA];
+    if (A.IsLeaf() || A.height < 2)
+    {
+        return iA;
+    }
+
+    const int iB = A.child1;
+    const int iC = A.child2;
+    Node &B = nodes[iB];
+    Node &C = nodes[iC];
+
+    const int balance = C.height - B.height;
+
+    // Rotate C up
+    if (balance > 1)
+    {
+        const int iF = C.child1;
+        const int iG = C.child2;
+        Node &F = nodes[iF];
+        Node &G = nodes[iG];
+
+        C.child1 = iA;
+        C.parent = A.parent;
+        A.parent = iC;
+
+        if (C.parent != nullNode)
+        {
+            if (nodes[C.parent].child1 == iA)
+                nodes[C.parent].child1 = iC;
+            else
+                nodes[C.parent].child2 = iC;
+        }
+        else
+        {
+            root = iC;
+        }
+
+        if (F.height > G.height)
+        {
+            C.child2 = iF;
+            A.child2 = iG;
+            G.parent = iA;
+            A.aabb = AABB::Combine(B.aabb, G.aabb);
+            C.aabb = AABB::Combine(A.aabb, F.aabb);
+            A.height = 1 + std::max(B.height, G.height);
+            C.height = 1 + std::max(A.height, F.height);
+        }
+        else
+        {
+            C.child2 = iG;
+            A.child2 = iF;
+            F.parent = iA;
+            A.aabb = AABB::Combine(B.aabb, F.aabb);
+            C.aabb = AABB::Combine(A.aabb, G.aabb);
+            A.height = 1 + std::max(B.height, F.height);
+            C.height = 1 + std::max(A.height, G.height);
+        }
+        return iC;
+    }
+
+    // Rotate B up
+    if (balance < -1)
+    {
+        const int iD = B.child1;
+        const int iE = B.child2;
+        Node &D = nodes[iD];
+        Node &E = nodes[iE];
+
+        B.child1 = iA;
+        B.parent = A.parent;
+        A.parent = iB;
+
+        if (B.parent != nullNode)
+        {
+            if (nodes[B.parent].child1 == iA)
+                nodes[B.parent].child1 = iB;
+            else
+                nodes[B.parent].child2 = iB;
+        }
+        else
+        {
+            root = iB;
+        }
+
+        if (D.height > E.height)
+        {
+            B.child2 = iD;
+            A.child1 = iE;
+            E.parent = iA;
+            A.aabb = AABB::Combine(C.aabb, E.aabb);
+            B.aabb = AABB::Combine(A.aabb, D.aabb);
+            A.height = 1 + std::max(C.height, E.height);
+            B.height = 1 + std::max(A.height, D.height);
+        }
+        else
+        {
+            B.child2 = iE;
+            A.child1 = iD;
+            D.parent = iA;
+            A.aabb = AABB::Combine(C.aabb, D.aabb);
+            B.aabb = AABB::Combine(A.aabb, E.aabb);
+            A.height = 1 + std::max(C.height, D.height);
+            B.height = 1 + std::max(A.height, E.height);
+        }
+        return iB;
+    }
+
+    return iA;
+}
@@ -0,0 +1,45 @@
+#include <FrameArena.h>
+#include <algorithm>
+
+// Moves on to the next block when this one is full. When a request does not
+// fit in a whole block, a big enough one is inserted before it, so the
+// blocks are reused in the same order after a rewind. Offsets are aligned
+// from the start of a block, which new[] aligns for any fundamental type.
+void *FrameArena::AllocateBytes(size_t size, size_t alignment)
+{
+    while (true)
+    {
+        if (currentBlock < blocks.size())
+        {
+            Block &block = blocks[currentBlock];
+            const size_t start = (offset + alignment - 1) & ~(alignment - 1);
+            if (start + size <= block.size)
+            {
+                offset = start + size;
+                return block.data.get() + start;
+            }
+            if (offset == 0)
+            {
+                // Not even the whole block is enough
+                const size_t newSize = std::max(blockSize, size + alignment);
+                blocks.insert(blocks.begin() + currentBlock, {std::make_unique<unsigned char[]>(newSize), newSize});
+                continue;
+            }
+            ++currentBlock;
+            offset = 0;
+            continue;
+        }
+        const size_t newSize = std::max(blockSize, size + alignment);
+        blocks.push_back({std::make_unique<unsigned char[]>(newSize), newSize});
+    }
+}
+
+size_t FrameArena::GetCapacity() const
+{
+    size_t capacity = 0;
+    for (const Block &block : blocks)
+    {
+        capacity += block.size;
+    }
+    return capacity;
+}
@@ -0,0 +1,183 @@
+#include <Integrator.h>
+
+// x86-64 only: every x86-64 CPU has SSE2, which 32-bit x86 does not
+// guarantee. 32-bit builds use the scalar kernel.
+#if defined(__x86_64__) || defined(_M_X64)
+#define ENGINE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// The AVX2 kernel is compiled for AVX2 only, whatever the rest of the build
+// targets, and only ever called after CPUID says the CPU supports it.
+#if defined(ENGINE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define ENGINE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define ENGINE_TARGET_AVX2
+#endif
+
+namespace
+{
+    // Reference kernel. The SIMD kernels below must match it exactly.
+    void IntegrateScalar(float *position, float *velocity, const float *force, const float *inverseMass,
+                         float acceleration, float dt, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (inverseMass[i] > 0.0f)
+            {
+                const float v = velocity[i] + (acceleration + force[i] * inverseMass[i]) * dt;
+                velocity[i] = v;
+                position[i] = position[i] + v * dt;
+            }
+        }
+    }
+
+#if defined(ENGINE_X86)
+    // 4 entries per instruction. SSE2 is part of x86-64 (see ENGINE_X86), so
+    // no CPUID check is needed.
+    size_t IntegrateSSE(float *position, float *velocity, const float *force, const float *inverseMass,
+                        float acceleration, float dt, size_t count)
+    {
+        const __m128 a = _mm_set1_ps(acceleration);
+        const __m128 h = _mm_set1_ps(dt);
+        const __m128 zero = _mm_setzero_ps();
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128 m = _mm_loadu_ps(inverseMass + i);
+            const __m128 v = _mm_loadu_ps(velocity + i);
+            const __m128 p = _mm_loadu_ps(position + i);
+            const __m128 f = _mm_loadu_ps(force + i);
+
+            const __m128 newV = _mm_add_ps(v, _mm_mul_ps(_mm_add_ps(a, _mm_mul_ps(f, m)), h));
+            const __m128 newP = _mm_add_ps(p, _mm_mul_ps(newV, h));
+
+            // Static entries keep their old values
+            const __m128 dynamic = _mm_cmpgt_ps(m, zero);
+            _mm_storeu_ps(velocity + i, _mm_or_ps(_mm_and_ps(dynamic, newV), _mm_andnot_ps(dynamic, v)));
+            _mm_storeu_ps(position + i, _mm_or_ps(_mm_and_ps(dynamic, newP), _mm_andnot_ps(dynamic, p)));
+        }
+        return i;
+    }
+
+    // 8 entries per instruction
+    ENGINE_TARGET_AVX2 size_t IntegrateAVX2(float *position, float *velocity, const float *force,
+                                            const float *inverseMass, float acceleration, float dt, size_t count)
+    {
+        const __m256 a = _mm256_set1_ps(acceleration);
+        const __m256 h = _mm256_set1_ps(dt);
+        const __m256 zero = _mm256_setzero_ps();
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256 m = _mm256_loadu_ps(inverseMass + i);
+            const __m256 v = _mm256_loadu_ps(velocity + i);
+            const __m256 p = _mm256_loadu_ps(position + i);
+            const __m256 f = _mm256_loadu_ps(force + i);
+
+            // Separate mul and add (no FMA) to stay identical to the scalar kernel
+            const __m256 newV = _mm256_add_ps(v, _mm256_mul_ps(_mm256_add_ps(a, _mm256_mul_ps(f, m)), h));
+            const __m256 newP = _mm256_add_ps(p, _mm256_mul_ps(newV, h));
+
+            const __m256 dynamic = _mm256_cmp_ps(m, zero, _CMP_GT_OQ);
+            _mm256_storeu_ps(velocity + i, _mm256_blendv_ps(v, newV, dynamic));
+            _mm256_storeu_ps(position + i, _mm256_blendv_ps(p, newP, dynamic));
+        }
+        return i;
+    }
+
+    bool CpuHasAVX2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        const bool osUsesXSave = (info[2] & (1 << 27)) != 0;
+        const bool cpuHasAVX = (info[2] & (1 << 28)) != 0;
+        if (!osUsesXSave || !cpuHasAVX || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    Integrator::Backend &CurrentBackend()
+    {
+        static Integrator::Backend backend = Integrator::DetectBackend();
+        return backend;
+    }
+}
+
+namespace Integrator
+{
+    Backend DetectBackend()
+    {
+#if defined(ENGINE_X86)
+        static const Backend detected = CpuHasAVX2() ? Backend::AVX2 : Backend::SSE;
+        return detected;
+#else
+        return Backend::Scalar;
+#endif
+    }
+
+    Backend GetBackend()
+    {
+        return CurrentBackend();
+    }
+
+    void SetBackend(Backend backend)
+    {
+        // Never select a backend the CPU cannot run
+        if (backend == Backend::AVX2 && DetectBackend() != Backend::AVX2)
+            backend = DetectBackend();
+#if !defined(ENGINE_X86)
+        backend = Backend::Scalar;
+#endif
+        CurrentBackend() = backend;
+    }
+
+    const char *GetBackendName(Backend backend)
+    {
+        switch (backend)
+        {
+        case Backend::AVX2:
+            return "AVX2";
+        case Backend::SSE:
+            return "SSE";
+        default:
+            return "Scalar";
+        }
+    }
+
+    void IntegrateAxis(float *position, float *velocity, const float *force, const float *inverseMass,
+                       float acceleration, float dt, size_t count)
+    {
+        size_t done = 0;
+#if defined(ENGINE_X86)
+        switch (CurrentBackend())
+        {
+        case Backend::AVX2:
+            done = IntegrateAVX2(position, velocity, force, inverseMass, acceleration, dt, count);
+            break;
+        case Backend::SSE:
+            done = IntegrateSSE(position, velocity, force, inverseMass, acceleration, dt, count);
+            break;
+        default:
+            break;
+        }
+#endif
+        // The scalar kernel does everything, or just the tail the SIMD kernels left over
+        IntegrateScalar(position, velocity, force, inverseMass, acceleration, dt, done, count);
+    }
+} // namespace Integrator
@@ -0,0 +1,102 @@
+#include <Island.h>
+
+int IslandBuilder::FindRoot(int body)
+{
+    // Path halving keeps the trees flat without recursion
+    while (parents[body] != body)
+    {
+        parents[body] = parents[parents[body]];
+        body = parents[body];
+    }
+    return body;
+}
+
+void IslandBuilder::Build(size_t bodyCount, const std::vector<float> &inverseMasses,
+                          const std::vector<BroadphasePair> &pairs, const std::vector<char> &touching)
+{
+    // 1. Union-find over the touching contacts between dynamic bodies.
+    //    The lower index always becomes the root, so the result is unique.
+    parents.resize(bodyCount);
+    for (size_t i = 0; i < bodyCount; ++i)
+    {
+        parents[i] = static_cast<int>(i);
+    }
+    for (size_t k = 0; k < pairs.size(); ++k)
+    {
+        if (!touching[k] || inverseMasses[pairs[k].a] == 0.0f || inverseMasses[pairs[k].b] == 0.0f)
+        {
+            continue;
+        }
+        const int rootA = FindRoot(pairs[k].a);
+        const int rootB = FindRoot(pairs[k].b);
+        if (rootA < rootB)
+            parents[rootB] = rootA;
+        else if (rootB < rootA)
+            parents[rootA] = rootB;
+    }
+
+    // 2. Number the islands in order of their lowest body
+    bodyIslands.assign(bodyCount, -1);
+    int islandCount = 0;
+    for (size_t i = 0; i < bodyCount; ++i)
+    {
+        if (inverseMasses[i] == 0.0f)
+        {
+            continue;
+        }
+        const int root = FindRoot(static_cast<int>(i));
+        if (root == static_cast<int>(i))
+        {
+            bodyIslands[i] = islandCount++;
+        }
+        else
+        {
+            bodyIslands[i] = bodyIslands[root];
+        }
+    }
+
+    // 3. Bucket bodies and contacts per island (counting sort, so the order
+    //    inside an island is the original order)
+    islandBodyStarts.assign(islandCount + 1, 0);
+    for (size_t i = 0; i < bodyCount; ++i)
+    {
+        if (bodyIslands[i] >= 0)
+            ++islandBodyStarts[bodyIslands[i] + 1];
+    }
+    for (int i = 0; i < islandCount; ++i)
+    {
+        islandBodyStarts[i + 1] += islandBodyStarts[i];
+    }
+    islandBodies.resize(islandBodyStarts[islandCount]);
+    cursor.assign(islandBodyStarts.begin(), islandBodyStarts.end() - 1);
+    for (size_t i = 0; i < bodyCount; ++i)
+    {
+        if (bodyIslands[i] >= 0)
+            islandBodies[cursor[bodyIslands[i]]++] = static_cast<int>(i);
+    }
+
+    // A contact with a static body belongs to the island of the other body
+    auto contactIsland = [&](size_t k)
+    {
+        const int islandA = bodyIslands[pairs[k].a];
+        return islandA >= 0 ? islandA : bodyIslands[pairs[k].b];
+    };
+
+    islandContactStarts.assign(islandCount + 1, 0);
+    for (size_t k = 0; k < pairs.size(); ++k)
+    {
+        if (touching[k] && contactIsland(k) >= 0)
+            ++islandContactStarts[contactIsland(k) + 1];
+    }
+    for (int i = 0; i < islandCount; ++i)
+    {
+        islandContactStarts[i + 1] += islandContactStarts[i];
+    }
+    islandContacts.resize(islandContactStarts[islandCount]);
+    cursor.assign(islandContactStarts.begin(), islandContactStarts.end() - 1);
+    for (size_t k = 0; k < pairs.size(); ++k)
+    {
+        if (touching[k] && contactIsland(k) >= 0)
+            islandContacts[cursor[contactIsland(k)]++] = static_cast<int>(k);
+    }
+}
@@ -0,0 +1,179 @@
+#include <JobSystem.h>
+
+JobSystem::JobSystem(int threadCount)
+{
+    StartWorkers(threadCount);
+}
+
+JobSystem::~JobSystem()
+{
+    StopWorkers();
+}
+
+void JobSystem::SetThreadCount(int threadCount)
+{
+    StopWorkers();
+    StartWorkers(threadCount);
+}
+
+void JobSystem::StartWorkers(int threadCount)
+{
+    if (threadCount <= 0)
+    {
+        threadCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    if (threadCount < 1)
+    {
+        threadCount = 1;
+    }
+
+    stopping = false;
+    queues.clear();
+    for (int i = 0; i < threadCount; ++i)
+    {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (int i = 1; i < threadCount; ++i)
+    {
+        workers.emplace_back(&JobSystem::WorkerLoop, this, static_cast<size_t>(i));
+    }
+}
+
+void JobSystem::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void JobSystem::Run(Batch &batch, size_t count, size_t grainSize)
+{
+    const size_t chunkCount = (count + grainSize - 1) / grainSize;
+    batch.remaining.store(chunkCount, std::memory_order_relaxed);
+
+    // Deal the chunks out round-robin so every thread starts with local work
+    const size_t queueCount = queues.size();
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        const size_t begin = chunk * grainSize;
+        const size_t end = begin + grainSize < count ? begin + grainSize : count;
+        Queue &queue = *queues[chunk % queueCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.PushBack({&batch, begin, end});
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        pendingJobs.fetch_add(chunkCount, std::memory_order_release);
+    }
+    wakeCondition.notify_all();
+
+    // Help out until the whole batch is finished
+    Job job;
+    while (batch.remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (PopOrSteal(0, job))
+        {
+            Execute(job);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool JobSystem::PopOrSteal(size_t queueIndex, Job &job)
+{
+    // Own queue first, newest job (still hot in cache)
+    {
+        Queue &own = *queues[queueIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.count > 0)
+        {
+            job = own.PopBack();
+            return true;
+        }
+    }
+
+    // Then steal the oldest job of someone else
+    const size_t queueCount = queues.size();
+    for (size_t offset = 1; offset < queueCount; ++offset)
+    {
+        Queue &victim = *queues[(queueIndex + offset) % queueCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.count > 0)
+        {
+            job = victim.PopFront();
+            return true;
+        }
+    }
+    return false;
+}
+
+// Doubling keeps the capacity a power of two; the jobs are unrolled so the
+// front is at index 0 again
+void JobSystem::Queue::PushBack(const Job &job)
+{
+    if (count == jobs.size())
+    {
+        std::vector<Job> grown(jobs.size() * 2);
+        for (size_t i = 0; i < count; ++i)
+        {
+            grown[i] = jobs[(head + i) & (jobs.size() - 1)];
+        }
+        jobs.swap(grown);
+        head = 0;
+    }
+    jobs[(head + count) & (jobs.size() - 1)] = job;
+    ++count;
+}
+
+JobSystem::Job JobSystem::Queue::PopBack()
+{
+    --count;
+    return jobs[(head + count) & (jobs.size() - 1)];
+}
+
+JobSystem::Job JobSystem::Queue::PopFront()
+{
+    const Job job = jobs[head];
+    head = (head + 1) & (jobs.size() - 1);
+    --count;
+    return job;
+}
+
+void JobSystem::Execute(const Job &job)
+{
+    pendingJobs.fetch_sub(1, std::memory_order_relaxed);
+    job.batch->run(job.batch->context, job.begin, job.end);
+    job.batch->remaining.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void JobSystem::WorkerLoop(size_t queueIndex)
+{
+    Job job;
+    while (true)
+    {
+        if (PopOrSteal(queueIndex, job))
+        {
+            Execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait(lock, [this]
+                           { return stopping || pendingJobs.load(std::memory_order_acquire) > 0; });
+        if (stopping)
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,380 @@
+#include <ParticleSystem.h>
+#include <Integrator.h>
+#include <Trig.h>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Particles per job
+    const size_t particleGrainSize = 16384;
+
+    // Snapshot section ids (the links use 128 and up)
+    enum Section : std::uint32_t
+    {
+        PositionX = 1,
+        PositionY,
+        VelocityX,
+        VelocityY,
+        ForceX,
+        ForceY,
+        InverseMasses,
+        Ages,
+        Lifetimes,
+        Alive,
+        FreeSlots,
+        Emitters,
+        Winds,
+        Settings,
+        Random,
+    };
+
+    struct SettingsRecord
+    {
+        Vec2 gravity;
+        float drag;
+        float gravitationalConstant;
+        float openingAngle;
+        std::uint64_t aliveCount;
+    };
+}
+
+ParticleSystem::ParticleSystem()
+    : jobSystem(std::make_unique<JobSystem>()),
+      random(1)
+{
+}
+
+void ParticleSystem::Reserve(size_t capacity)
+{
+    positionX.reserve(capacity);
+    positionY.reserve(capacity);
+    velocityX.reserve(capacity);
+    velocityY.reserve(capacity);
+    forceX.reserve(capacity);
+    forceY.reserve(capacity);
+    inverseMasses.reserve(capacity);
+    ages.reserve(capacity);
+    lifetimes.reserve(capacity);
+    alive.reserve(capacity);
+    freeSlots.reserve(capacity);
+}
+
+std::uint32_t ParticleSystem::Spawn(const Vec2 &position, const Vec2 &velocity, float mass, float lifetime)
+{
+    std::uint32_t index;
+    if (!freeSlots.empty())
+    {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        index = static_cast<std::uint32_t>(positionX.size());
+        positionX.push_back(0.0f);
+        positionY.push_back(0.0f);
+        velocityX.push_back(0.0f);
+        velocityY.push_back(0.0f);
+        forceX.push_back(0.0f);
+        forceY.push_back(0.0f);
+        inverseMasses.push_back(0.0f);
+        ages.push_back(0.0f);
+        lifetimes.push_back(0.0f);
+        alive.push_back(0);
+    }
+
+    positionX[index] = position.x;
+    positionY[index] = position.y;
+    velocityX[index] = velocity.x;
+    velocityY[index] = velocity.y;
+    forceX[index] = 0.0f;
+    forceY[index] = 0.0f;
+    inverseMasses[index] = mass > 1e-6f ? 1.0f / mass : 0.0f;
+    ages[index] = 0.0f;
+    lifetimes[index] = lifetime;
+    alive[index] = 1;
+    ++aliveCount;
+    return index;
+}
+
+// The slot stays in the arrays, inert, until Spawn reuses it. Its links go
+// now: left in place, they would tie whatever particle gets the slot next to
+// the old partners.
+void ParticleSystem::Kill(std::uint32_t index)
+{
+    if (!alive[index])
+    {
+        return;
+    }
+    links.RemoveLinks(index);
+    alive[index] = 0;
+    inverseMasses[index] = 0.0f;
+    velocityX[index] = 0.0f;
+    velocityY[index] = 0.0f;
+    forceX[index] = 0.0f;
+    forceY[index] = 0.0f;
+    --aliveCount;
+    freeSlots.push_back(index);
+}
+
+void ParticleSystem::Save(Snapshot &snapshot) const
+{
+    snapshot.Begin(SnapshotKind::Particles);
+    snapshot.Write(PositionX, positionX);
+    snapshot.Write(PositionY, positionY);
+    snapshot.Write(VelocityX, velocityX);
+    snapshot.Write(VelocityY, velocityY);
+    snapshot.Write(ForceX, forceX);
+    snapshot.Write(ForceY, forceY);
+    snapshot.Write(InverseMasses, inverseMasses);
+    snapshot.Write(Ages, ages);
+    snapshot.Write(Lifetimes, lifetimes);
+    snapshot.Write(Alive, alive);
+    snapshot.Write(FreeSlots, freeSlots);
+    snapshot.Write(Emitters, emitters);
+    snapshot.Write(Winds, winds);
+    snapshot.WriteValue(Settings, SettingsRecord{gravity, drag, gravitationalConstant, openingAngle, aliveCount});
+    snapshot.WriteValue(Random, random);
+    links.Save(snapshot);
+    snapshot.End();
+}
+
+bool ParticleSystem::Restore(const SnapshotReader &reader)
+{
+    SettingsRecord settings;
+    size_t capacity = 0, count = 0;
+    bool valid = reader.IsValid(SnapshotKind::Particles) && reader.ReadValue(Settings, settings) &&
+                 reader.Get<float>(PositionX, capacity);
+    for (const Section id : {PositionY, VelocityX, VelocityY, ForceX, ForceY, InverseMasses, Ages, Lifetimes})
+    {
+        valid = valid && reader.Get<float>(id, count) && count == capacity;
+    }
+    valid = valid && reader.Get<char>(Alive, count) && count == capacity;
+    const std::uint32_t *slots = reader.Get<std::uint32_t>(FreeSlots, count);
+    valid = valid && slots && std::all_of(slots, slots + count, [&](std::uint32_t slot)
+                                          { return slot < capacity; });
+    valid = valid && reader.Get<ParticleEmitter>(Emitters, count) && reader.Get<WindField>(Winds, count) &&
+            reader.Get<std::minstd_rand>(Random, count) && count == 1;
+    // The links go last: they check themselves, and are only replaced if
+    // everything else checked out
+    if (!valid || !links.Restore(reader, capacity))
+    {
+        return false;
+    }
+
+    reader.Read(PositionX, positionX);
+    reader.Read(PositionY, positionY);
+    reader.Read(VelocityX, velocityX);
+    reader.Read(VelocityY, velocityY);
+    reader.Read(ForceX, forceX);
+    reader.Read(ForceY, forceY);
+    reader.Read(InverseMasses, inverseMasses);
+    reader.Read(Ages, ages);
+    reader.Read(Lifetimes, lifetimes);
+    reader.Read(Alive, alive);
+    reader.Read(FreeSlots, freeSlots);
+    reader.Read(Emitters, emitters);
+    reader.Read(Winds, winds);
+    reader.ReadValue(Random, random);
+    gravity = settings.gravity;
+    drag = settings.drag;
+    gravitationalConstant = settings.gravitationalConstant;
+    openingAngle = settings.openingAngle;
+    aliveCount = static_cast<size_t>(settings.aliveCount);
+    return true;
+}
+
+std::uint64_t ParticleSystem::ComputeStateHash() const
+{
+    std::uint64_t hash = stateHashSeed;
+    for (const std::vector<float> *array : {&positionX, &positionY, &velocityX, &velocityY, &ages})
+    {
+        hash = HashState(*array, hash);
+    }
+    return HashState(alive, hash);
+}
+
+void ParticleSystem::Step(float dt)
+{
+    ENGINE_PROFILE_FRAME(profiler);
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "Emit");
+        Emit(dt);
+    }
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "ApplyForces");
+        ApplyForces();
+    }
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "ApplySprings");
+        ApplySprings();
+    }
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "ApplyAttraction");
+        ApplyAttraction();
+    }
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "Integrate");
+        Integrate(dt);
+    }
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "Age");
+        Age(dt);
+    }
+
+    ENGINE_PROFILE_COUNTER(profiler, "particles", static_cast<std::int64_t>(aliveCount));
+    ENGINE_PROFILE_COUNTER(profiler, "links", static_cast<std::int64_t>(links.GetLinkCount()));
+}
+
+void ParticleSystem::Emit(float dt)
+{
+    // Uniform in [0, 1) from the top 24 bits of the engine (minstd_rand
+    // gives 31). std::uniform_real_distribution would do, but its algorithm
+    // differs between standard libraries, and emitters must spawn the same
+    // particles everywhere.
+    auto unit = [](std::minstd_rand &engine)
+    { return static_cast<float>(engine() >> 7) * (1.0f / 16777216.0f); };
+    for (ParticleEmitter &emitter : emitters)
+    {
+        if (!emitter.enabled)
+        {
+            continue;
+        }
+        emitter.pending += emitter.rate * dt;
+        const int count = static_cast<int>(emitter.pending);
+        emitter.pending -= static_cast<float>(count);
+
+        const Vec2 size = emitter.region.max - emitter.region.min;
+        for (int i = 0; i < count; ++i)
+        {
+            const Vec2 position = emitter.region.min + Vec2(size.x * unit(random), size.y * unit(random));
+            const float angle = 6.2831853f * unit(random);
+            const float speed = emitter.spread * unit(random);
+            float sine, cosine;
+            Trig::SinCos(angle, sine, cosine);
+            const Vec2 velocity = emitter.velocity + Vec2(cosine, sine) * speed;
+            Spawn(position, velocity, emitter.mass, emitter.lifetime);
+        }
+    }
+}
+
+// Drag and wind, which only read the particle they push
+void ParticleSystem::ApplyForces()
+{
+    if (drag == 0.0f && winds.empty())
+    {
+        return;
+    }
+    jobSystem->ParallelFor(GetCapacity(), particleGrainSize, [&](size_t begin, size_t end)
+                           {
+        if (drag != 0.0f)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                const float vx = velocityX[i];
+                const float vy = velocityY[i];
+                const float scale = -drag * std::sqrt(vx * vx + vy * vy);
+                forceX[i] += vx * scale;
+                forceY[i] += vy * scale;
+            }
+        }
+        for (const WindField &wind : winds)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                const float x = positionX[i];
+                const float y = positionY[i];
+                if (x < wind.region.min.x || x > wind.region.max.x || y < wind.region.min.y || y > wind.region.max.y)
+                {
+                    continue;
+                }
+                forceX[i] += (wind.velocity.x - velocityX[i]) * wind.strength;
+                forceY[i] += (wind.velocity.y - velocityY[i]) * wind.strength;
+            }
+        } });
+}
+
+// Spring forces, when the links are springs
+void ParticleSystem::ApplySprings()
+{
+    if (links.solver != ConstraintNetwork::Solver::Springs || links.GetLinkCount() == 0)
+    {
+        return;
+    }
+    links.ApplyForces(positionX.data(), positionY.data(), forceX.data(), forceY.data(), *jobSystem);
+}
+
+void ParticleSystem::ApplyAttraction()
+{
+    if (gravitationalConstant == 0.0f)
+    {
+        return;
+    }
+    attractionTree.Build(positionX.data(), positionY.data(), inverseMasses.data(), GetCapacity(), *jobSystem);
+    attractionTree.ApplyForces(gravitationalConstant, openingAngle, forceX.data(), forceY.data(), *jobSystem);
+}
+
+// Weight is the same acceleration for every particle, so it goes straight
+// into the integrator instead of through the force arrays.
+// With XPBD links the step is cut into substeps, each integrated and then
+// corrected by the links: many small steps converge much faster than as many
+// solver iterations over one big step.
+void ParticleSystem::Integrate(float dt)
+{
+    const bool constrained = links.solver == ConstraintNetwork::Solver::XPBD && links.GetLinkCount() > 0;
+    const int substeps = constrained ? std::max(links.substeps, 1) : 1;
+    const float h = dt / static_cast<float>(substeps);
+
+    for (int substep = 0; substep < substeps; ++substep)
+    {
+        if (constrained)
+        {
+            previousX = positionX;
+            previousY = positionY;
+        }
+        jobSystem->ParallelFor(GetCapacity(), particleGrainSize, [&](size_t begin, size_t end)
+                               {
+            const size_t count = end - begin;
+            Integrator::IntegrateAxis(&positionX[begin], &velocityX[begin], &forceX[begin], &inverseMasses[begin], gravity.x, h, count);
+            Integrator::IntegrateAxis(&positionY[begin], &velocityY[begin], &forceY[begin], &inverseMasses[begin], gravity.y, h, count); });
+        if (constrained)
+        {
+            SolveConstraints(h);
+        }
+    }
+
+    std::fill(forceX.begin(), forceX.end(), 0.0f);
+    std::fill(forceY.begin(), forceY.end(), 0.0f);
+}
+
+// Pulls the integrated positions back together, then sets each velocity to
+// how far the particle moved during the substep
+void ParticleSystem::SolveConstraints(float dt)
+{
+    links.SolvePositions(positionX.data(), positionY.data(), inverseMasses.data(), dt, *jobSystem);
+
+    const float inverseDt = 1.0f / dt;
+    jobSystem->ParallelFor(GetCapacity(), particleGrainSize, [&](size_t begin, size_t end)
+                           {
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (inverseMasses[i] > 0.0f)
+            {
+                velocityX[i] = (positionX[i] - previousX[i]) * inverseDt;
+                velocityY[i] = (positionY[i] - previousY[i]) * inverseDt;
+            }
+        } });
+}
+
+// Removes the particles that outlived their lifetime
+void ParticleSystem::Age(float dt)
+{
+    for (size_t i = 0; i < GetCapacity(); ++i)
+    {
+        ages[i] += dt;
+        if (alive[i] && ages[i] >= lifetimes[i])
+        {
+            Kill(static_cast<std::uint32_t>(i));
+        }
+    }
+}
@@ -0,0 +1,210 @@
+#include <Profiler.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+std::int64_t ProfileFrame::GetScopeTime(const char *name) const
+{
+    std::int64_t total = 0;
+    for (const ProfileScope &scope : scopes)
+    {
+        if (std::strcmp(scope.name, name) == 0)
+        {
+            total += scope.duration;
+        }
+    }
+    return total;
+}
+
+std::int64_t ProfileFrame::GetCounter(const char *name, std::int64_t fallback) const
+{
+    for (const ProfileCounter &counter : counters)
+    {
+        if (std::strcmp(counter.name, name) == 0)
+        {
+            return counter.value;
+        }
+    }
+    return fallback;
+}
+
+Profiler::Profiler(size_t frameCapacity)
+    : frames(std::max<size_t>(frameCapacity, 1)),
+      epoch(0)
+{
+    epoch = Now();
+}
+
+std::int64_t Profiler::Now() const
+{
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count() - epoch;
+}
+
+// The frame is written in place in the ring buffer, over the oldest one. Its
+// vectors keep their capacity, so after the first lap nothing is allocated.
+void Profiler::BeginFrame()
+{
+    if (!enabled || recording)
+    {
+        return;
+    }
+    recording = true;
+    ProfileFrame &frame = frames[frameCount % frames.size()];
+    frame.index = frameCount;
+    frame.scopes.clear();
+    frame.counters.clear();
+    openScopes.clear();
+    if (allocationCounter)
+    {
+        allocationsAtBegin = allocationCounter();
+    }
+    frame.start = Now();
+}
+
+void Profiler::EndFrame()
+{
+    if (!recording)
+    {
+        return;
+    }
+    ProfileFrame &frame = frames[frameCount % frames.size()];
+    frame.duration = Now() - frame.start;
+    while (!openScopes.empty())
+    {
+        EndScope();
+    }
+    if (allocationCounter)
+    {
+        SetCounter("allocations", allocationCounter() - allocationsAtBegin);
+    }
+    recording = false;
+    ++frameCount;
+}
+
+void Profiler::BeginScope(const char *name)
+{
+    if (!recording)
+    {
+        return;
+    }
+    ProfileFrame &frame = frames[frameCount % frames.size()];
+    openScopes.push_back(frame.scopes.size());
+    frame.scopes.push_back({name, Now(), 0, static_cast<int>(openScopes.size()) - 1});
+}
+
+void Profiler::EndScope()
+{
+    if (!recording || openScopes.empty())
+    {
+        return;
+    }
+    ProfileScope &scope = frames[frameCount % frames.size()].scopes[openScopes.back()];
+    scope.duration = Now() - scope.start;
+    openScopes.pop_back();
+}
+
+void Profiler::SetCounter(const char *name, std::int64_t value)
+{
+    if (!recording)
+    {
+        return;
+    }
+    std::vector<ProfileCounter> &counters = frames[frameCount % frames.size()].counters;
+    for (ProfileCounter &counter : counters)
+    {
+        if (counter.name == name || std::strcmp(counter.name, name) == 0)
+        {
+            counter.value = value;
+            return;
+        }
+    }
+    counters.push_back({name, value});
+}
+
+size_t Profiler::GetFrameCount() const
+{
+    return static_cast<size_t>(std::min<std::uint64_t>(frameCount, frames.size()));
+}
+
+const ProfileFrame &Profiler::GetFrame(size_t age) const
+{
+    return frames[(frameCount - 1 - age) % frames.size()];
+}
+
+void Profiler::Clear()
+{
+    frameCount = 0;
+    recording = false;
+    openScopes.clear();
+}
+
+namespace
+{
+    // Scope and counter names are plain identifiers and phrases, but escape
+    // them anyway so the file always parses
+    void WriteJsonString(std::FILE *file, const char *text)
+    {
+        std::fputc('"', file);
+        for (const char *c = text; *c; ++c)
+        {
+            if (*c == '"' || *c == '\\')
+            {
+                std::fputc('\\', file);
+                std::fputc(*c, file);
+            }
+            else if (static_cast<unsigned char>(*c) < 0x20)
+            {
+                std::fprintf(file, "\\u%04x", *c);
+            }
+            else
+            {
+                std::fputc(*c, file);
+            }
+        }
+        std::fputc('"', file);
+    }
+}
+
+// Each frame becomes a "Step" complete event (ph X) with its scopes nested
+// inside, on one thread track, and one counter event (ph C) per counter,
+// which the viewers draw as graphs. Trace timestamps are in microseconds.
+bool Profiler::ExportChromeTrace(const char *path) const
+{
+    std::FILE *file = std::fopen(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    auto writeComplete = [&](const char *name, std::int64_t start, std::int64_t duration)
+    {
+        std::fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+        WriteJsonString(file, name);
+        std::fprintf(file, ",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}", start / 1000.0,
+                     duration / 1000.0);
+        first = false;
+    };
+
+    for (size_t age = GetFrameCount(); age-- > 0;)
+    {
+        const ProfileFrame &frame = GetFrame(age);
+        writeComplete("Step", frame.start, frame.duration);
+        for (const ProfileScope &scope : frame.scopes)
+        {
+            writeComplete(scope.name, scope.start, scope.duration);
+        }
+        for (const ProfileCounter &counter : frame.counters)
+        {
+            std::fprintf(file, ",\n{\"name\":");
+            WriteJsonString(file, counter.name);
+            std::fprintf(file, ",\"ph\":\"C\",\"pid\":0,\"ts\":%.3f,\"args\":{\"value\":%lld}}", frame.start / 1000.0,
+                         static_cast<long long>(counter.value));
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
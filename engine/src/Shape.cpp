@@ -0,0 +1,12 @@
+#include <Shape.h>
+#include <CircleShape.h>
+#include <PolygonShape.h>
+
+float Shape::GetMomentOfInertia() const
+{
+    if (type == POLYGON)
+    {
+        return static_cast<const PolygonShape *>(this)->GetMomentOfInertia();
+    }
+    return static_cast<const CircleShape *>(this)->GetMomentOfInertia();
+}
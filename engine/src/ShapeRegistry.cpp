@@ -0,0 +1,64 @@
+#include <ShapeRegistry.h>
+
+std::shared_ptr<const PolygonGeometry> ShapeRegistry::GetPolygon(const std::vector<Vec2> &vertices)
+{
+    const std::uint64_t hash = PolygonGeometry::Hash(vertices);
+    auto [first, last] = polygons.equal_range(hash);
+    for (auto it = first; it != last; ++it)
+    {
+        if (it->second->vertices == vertices)
+        {
+            return it->second;
+        }
+    }
+    return polygons.emplace(hash, std::make_shared<const PolygonGeometry>(vertices))->second;
+}
+
+std::shared_ptr<const PolygonGeometry> ShapeRegistry::Intern(const std::shared_ptr<const PolygonGeometry> &geometry)
+{
+    auto [first, last] = polygons.equal_range(geometry->hash);
+    for (auto it = first; it != last; ++it)
+    {
+        // Most shapes handed to a World were built from the registry already
+        if (it->second == geometry || it->second->vertices == geometry->vertices)
+        {
+            return it->second;
+        }
+    }
+    return polygons.emplace(geometry->hash, geometry)->second;
+}
+
+size_t ShapeRegistry::Prune()
+{
+    size_t count = 0;
+    for (auto it = polygons.begin(); it != polygons.end();)
+    {
+        if (it->second.use_count() == 1)
+        {
+            it = polygons.erase(it);
+            ++count;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return count;
+}
+
+void ShapeRegistry::Release(const std::shared_ptr<const PolygonGeometry> &geometry)
+{
+    if (!geometry || geometry.use_count() != 2)
+    {
+        return;
+    }
+    auto [first, last] = polygons.equal_range(geometry->hash);
+    for (auto it = first; it != last; ++it)
+    {
+        if (it->second == geometry)
+        {
+            polygons.erase(it);
+            return;
+        }
+    }
+}
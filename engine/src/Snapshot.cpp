@@ -0,0 +1,209 @@
+#include <Snapshot.h>
+#include <algorithm>
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SNAPSHOT_HAS_MMAP 1
+#else
+#define SNAPSHOT_HAS_MMAP 0
+#endif
+
+namespace
+{
+    const char magic[4] = {'P', '2', 'D', 'S'};
+    const size_t sectionAlignment = 16;
+
+    size_t AlignUp(size_t offset)
+    {
+        return (offset + sectionAlignment - 1) & ~(sectionAlignment - 1);
+    }
+}
+
+std::uint64_t HashStateBytes(const void *data, size_t size, std::uint64_t hash)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4)
+    {
+        std::uint32_t word;
+        std::memcpy(&word, bytes + i, 4);
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+    for (; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// --- Snapshot ---
+
+void Snapshot::Begin(SnapshotKind kind)
+{
+    bytes.clear();
+    sections.clear();
+    bytes.resize(AlignUp(sizeof(SnapshotHeader)));
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.kind = static_cast<std::uint32_t>(kind);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+}
+
+void *Snapshot::WriteBytes(std::uint32_t id, size_t elementSize, const void *data, size_t count)
+{
+    const size_t offset = AlignUp(bytes.size());
+    const size_t size = elementSize * count;
+    bytes.resize(offset + size);
+    if (data && size > 0)
+    {
+        std::memcpy(bytes.data() + offset, data, size);
+    }
+    sections.push_back({id, static_cast<std::uint32_t>(elementSize), offset, count});
+    return bytes.data() + offset;
+}
+
+// The section table goes last, once the number of sections is known
+void Snapshot::End()
+{
+    const size_t tableOffset = AlignUp(bytes.size());
+    const size_t tableSize = sections.size() * sizeof(SnapshotSection);
+    bytes.resize(tableOffset + tableSize);
+    if (tableSize > 0)
+    {
+        std::memcpy(bytes.data() + tableOffset, sections.data(), tableSize);
+    }
+
+    SnapshotHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    header.sectionCount = static_cast<std::uint32_t>(sections.size());
+    header.tableOffset = tableOffset;
+    header.size = bytes.size();
+    std::memcpy(bytes.data(), &header, sizeof(header));
+}
+
+bool Snapshot::SaveToFile(const char *path) const
+{
+    std::FILE *file = std::fopen(path, "wb");
+    if (!file)
+    {
+        return false;
+    }
+    const bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return std::fclose(file) == 0 && written;
+}
+
+// --- SnapshotReader ---
+
+SnapshotReader::SnapshotReader(const unsigned char *data, size_t size) : data(data), size(size)
+{
+}
+
+bool SnapshotReader::IsValid(SnapshotKind kind) const
+{
+    if (!data || size < sizeof(SnapshotHeader))
+    {
+        return false;
+    }
+    SnapshotHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != Snapshot::version ||
+        header.kind != static_cast<std::uint32_t>(kind) || header.size > size)
+    {
+        return false;
+    }
+
+    // The table must fit between its offset and the end, and be aligned for
+    // reading in place. The sizes come from the bytes, so every check is
+    // written so it cannot overflow.
+    if (header.tableOffset > header.size || header.tableOffset % sectionAlignment != 0 ||
+        reinterpret_cast<std::uintptr_t>(data + header.tableOffset) % alignof(SnapshotSection) != 0 ||
+        header.sectionCount > (header.size - header.tableOffset) / sizeof(SnapshotSection))
+    {
+        return false;
+    }
+
+    // Every section must lie inside the snapshot, before the table, at an
+    // offset the writer could have put it
+    const SnapshotSection *table = reinterpret_cast<const SnapshotSection *>(data + header.tableOffset);
+    return std::all_of(table, table + header.sectionCount, [&](const SnapshotSection &section)
+                       {
+                           return section.elementSize > 0 && section.offset <= header.tableOffset &&
+                                  section.offset % sectionAlignment == 0 &&
+                                  section.count <= (header.tableOffset - section.offset) / section.elementSize;
+                       });
+}
+
+const SnapshotSection *SnapshotReader::Find(std::uint32_t id) const
+{
+    SnapshotHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    const SnapshotSection *table = reinterpret_cast<const SnapshotSection *>(data + header.tableOffset);
+    for (std::uint32_t i = 0; i < header.sectionCount; ++i)
+    {
+        if (table[i].id == id)
+        {
+            return &table[i];
+        }
+    }
+    return nullptr;
+}
+
+// --- MappedSnapshotFile ---
+
+MappedSnapshotFile::MappedSnapshotFile(const char *path)
+{
+#if SNAPSHOT_HAS_MMAP
+    const int file = open(path, O_RDONLY);
+    if (file < 0)
+    {
+        return;
+    }
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size > 0)
+    {
+        void *mapping = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapping != MAP_FAILED)
+        {
+            data = static_cast<const unsigned char *>(mapping);
+            size = static_cast<size_t>(status.st_size);
+        }
+    }
+    close(file);
+#else
+    std::FILE *file = std::fopen(path, "rb");
+    if (!file)
+    {
+        return;
+    }
+    std::fseek(file, 0, SEEK_END);
+    const long length = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    if (length > 0)
+    {
+        fallback.resize(static_cast<size_t>(length));
+        if (std::fread(fallback.data(), 1, fallback.size(), file) == fallback.size())
+        {
+            data = fallback.data();
+            size = fallback.size();
+        }
+    }
+    std::fclose(file);
+#endif
+}
+
+MappedSnapshotFile::~MappedSnapshotFile()
+{
+#if SNAPSHOT_HAS_MMAP
+    if (data)
+    {
+        munmap(const_cast<unsigned char *>(data), size);
+    }
+#endif
+}
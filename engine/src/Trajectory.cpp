@@ -0,0 +1,710 @@
+#include <Trajectory.h>
+#include <CircleShape.h>
+#include <PolygonShape.h>
+#include <World.h>
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    const char magic[4] = {'P', '2', 'D', 'T'};
+    const std::uint32_t version = 1;
+    const std::uint32_t noSlot = BodyHandle::invalidSlot;
+    const std::uint64_t chunkHeaderSize = 2 * sizeof(std::uint32_t); // Frame count, byte count
+
+    std::int32_t Quantize(float value, float step)
+    {
+        const double steps = std::nearbyint(static_cast<double>(value) / step);
+        if (!(steps == steps))
+        {
+            return 0; // NaN
+        }
+        return static_cast<std::int32_t>(std::clamp(steps, -2147483648.0, 2147483647.0));
+    }
+
+    // Small numbers of either sign to small unsigned ones: 0, -1, 1, -2...
+    std::uint64_t ZigZag(std::int64_t value)
+    {
+        return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+    }
+
+    std::int64_t UnZigZag(std::uint64_t value)
+    {
+        return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+    }
+
+    // LEB128: seven bits per byte, the high bit set on all but the last
+    void WriteVarint(std::vector<unsigned char> &bytes, std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            bytes.push_back(static_cast<unsigned char>(value | 0x80));
+            value >>= 7;
+        }
+        bytes.push_back(static_cast<unsigned char>(value));
+    }
+
+    bool ReadVarint(const std::vector<unsigned char> &bytes, size_t &cursor, std::uint64_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (cursor >= bytes.size())
+            {
+                return false;
+            }
+            const unsigned char byte = bytes[cursor++];
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename T>
+    bool WriteRaw(std::FILE *file, const T *data, size_t count)
+    {
+        return count == 0 || std::fwrite(data, sizeof(T), count, file) == count;
+    }
+
+    template <typename T>
+    bool ReadRaw(std::FILE *file, T *data, size_t count)
+    {
+        return count == 0 || std::fread(data, sizeof(T), count, file) == count;
+    }
+
+    // Seeking with 64 bit offsets: fseek takes a long, which is 32 bits on
+    // some platforms
+    bool Seek(std::FILE *file, std::uint64_t offset)
+    {
+#if defined(_WIN32)
+        return offset <= static_cast<std::uint64_t>(LLONG_MAX) &&
+               _fseeki64(file, static_cast<long long>(offset), SEEK_SET) == 0;
+#elif defined(__unix__) || defined(__APPLE__)
+        return offset <= static_cast<std::uint64_t>(std::numeric_limits<off_t>::max()) &&
+               fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#else
+        return offset <= static_cast<std::uint64_t>(LONG_MAX) &&
+               std::fseek(file, static_cast<long>(offset), SEEK_SET) == 0;
+#endif
+    }
+
+    bool GetFileSize(std::FILE *file, std::uint64_t &size)
+    {
+#if defined(_WIN32)
+        const long long end = _fseeki64(file, 0, SEEK_END) == 0 ? _ftelli64(file) : -1;
+#elif defined(__unix__) || defined(__APPLE__)
+        const off_t end = fseeko(file, 0, SEEK_END) == 0 ? ftello(file) : -1;
+#else
+        const long end = std::fseek(file, 0, SEEK_END) == 0 ? std::ftell(file) : -1;
+#endif
+        size = static_cast<std::uint64_t>(end);
+        return end >= 0;
+    }
+
+    // Starts frame: makes room for bodyCount bodies, keeping the entries of
+    // the last frame that are there to be predicted from
+    void BeginFrame(TrajectoryHistory &history, size_t bodyCount)
+    {
+        const size_t size = std::max(bodyCount, history.slots[0].size());
+        for (std::vector<std::uint32_t> &slots : history.slots)
+        {
+            slots.resize(size, noSlot);
+        }
+        for (auto &frame : history.values)
+        {
+            for (std::vector<std::int32_t> &values : frame)
+            {
+                values.resize(size, 0);
+            }
+        }
+        history.shapes.resize(size, 0);
+        history.flags.resize(size, 0);
+    }
+
+    void EndFrame(TrajectoryHistory &history, size_t bodyCount)
+    {
+        for (std::vector<std::uint32_t> &slots : history.slots)
+        {
+            slots.resize(bodyCount);
+        }
+        for (auto &frame : history.values)
+        {
+            for (std::vector<std::int32_t> &values : frame)
+            {
+                values.resize(bodyCount);
+            }
+        }
+        history.shapes.resize(bodyCount);
+        history.flags.resize(bodyCount);
+    }
+
+    // Constant velocity if the body held index i for the two frames before,
+    // constant position if only for the last one, nothing otherwise
+    std::int64_t Predict(const TrajectoryHistory &history, size_t i, std::uint32_t slot, int component)
+    {
+        if (history.slots[0][i] != slot)
+        {
+            return 0;
+        }
+        const std::int64_t last = history.values[0][component][i];
+        if (history.slots[1][i] != slot)
+        {
+            return last;
+        }
+        return 2 * last - history.values[1][component][i];
+    }
+
+    // Moves body i's entries back a frame and stores the new ones
+    void Push(TrajectoryHistory &history, size_t i, std::uint32_t slot, const std::int32_t (&values)[3])
+    {
+        history.slots[1][i] = history.slots[0][i];
+        history.slots[0][i] = slot;
+        for (int component = 0; component < 3; ++component)
+        {
+            history.values[1][component][i] = history.values[0][component][i];
+            history.values[0][component][i] = values[component];
+        }
+    }
+}
+
+void TrajectoryHistory::Clear()
+{
+    for (std::vector<std::uint32_t> &frame : slots)
+    {
+        frame.clear();
+    }
+    for (auto &frame : values)
+    {
+        for (std::vector<std::int32_t> &component : frame)
+        {
+            component.clear();
+        }
+    }
+    shapes.clear();
+    flags.clear();
+}
+
+// --- TrajectoryRecorder ---
+
+void TrajectoryRecorder::Chunk::Clear()
+{
+    bodyCounts.clear();
+    slots.clear();
+    shapes.clear();
+    flags.clear();
+    positionX.clear();
+    positionY.clear();
+    angles.clear();
+}
+
+TrajectoryRecorder::~TrajectoryRecorder()
+{
+    Close();
+}
+
+bool TrajectoryRecorder::Open(const char *path, const TrajectorySettings &newSettings)
+{
+    Close();
+    file = std::fopen(path, "wb");
+    if (!file)
+    {
+        return false;
+    }
+
+    settings = newSettings;
+    settings.framesPerChunk = std::max(settings.framesPerChunk, 1);
+    frameCount = 0;
+    front.Clear();
+    front.firstFrame = 0;
+    slotShapes.clear();
+    shapeTable.clear();
+    polygonShapes.clear();
+    circleShapes.clear();
+    geometries.clear();
+    backPending = false;
+    stopping = false;
+    index.clear();
+
+    TrajectoryFileHeader header = {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.positionStep = settings.positionStep;
+    header.angleStep = settings.angleStep;
+    header.frameTime = settings.frameTime;
+    writeFailed = !WriteRaw(file, &header, 1);
+    bytesWritten = sizeof(header);
+
+    writer = std::thread([this] { WriterLoop(); });
+    return true;
+}
+
+std::uint32_t TrajectoryRecorder::FindShape(const Shape *shape)
+{
+    if (shape->GetType() == Shape::POLYGON)
+    {
+        const std::shared_ptr<const PolygonGeometry> &geometry = static_cast<const PolygonShape *>(shape)->geometry;
+        auto [it, inserted] = polygonShapes.try_emplace(geometry.get(), static_cast<std::uint32_t>(shapeTable.size()));
+        if (inserted)
+        {
+            geometries.push_back(geometry);
+            shapeTable.push_back({Shape::POLYGON, 0.0f, geometry->vertices});
+        }
+        return it->second;
+    }
+
+    const float radius = static_cast<const CircleShape *>(shape)->radius;
+    auto [it, inserted] = circleShapes.try_emplace(std::bit_cast<std::uint32_t>(radius),
+                                                   static_cast<std::uint32_t>(shapeTable.size()));
+    if (inserted)
+    {
+        shapeTable.push_back({Shape::CIRCLE, radius, {}});
+    }
+    return it->second;
+}
+
+// Only copies: this runs in the step loop
+void TrajectoryRecorder::Record(const World &world)
+{
+    if (!file)
+    {
+        return;
+    }
+
+    const size_t bodyCount = world.GetBodyCount();
+    front.bodyCounts.push_back(static_cast<std::uint32_t>(bodyCount));
+    front.positionX.insert(front.positionX.end(), world.positionX.begin(), world.positionX.end());
+    front.positionY.insert(front.positionY.end(), world.positionY.begin(), world.positionY.end());
+    front.angles.insert(front.angles.end(), world.angles.begin(), world.angles.end());
+    for (size_t i = 0; i < bodyCount; ++i)
+    {
+        const BodyHandle handle = world.GetHandle(i);
+        if (handle.slot >= slotShapes.size())
+        {
+            slotShapes.resize(handle.slot + 1);
+        }
+        SlotShape &slotShape = slotShapes[handle.slot];
+        if (!slotShape.known || slotShape.generation != handle.generation)
+        {
+            slotShape.generation = handle.generation;
+            slotShape.shape = FindShape(world.shapes[i]);
+            slotShape.known = true;
+        }
+        front.slots.push_back(handle.slot);
+        front.shapes.push_back(slotShape.shape);
+        front.flags.push_back(static_cast<std::uint8_t>((world.inverseMasses[i] == 0.0f ? TrajectoryFrame::STATIC : 0) |
+                                                        (world.IsAwake(i) ? TrajectoryFrame::AWAKE : 0)));
+    }
+    ++frameCount;
+
+    if (front.bodyCounts.size() >= static_cast<size_t>(settings.framesPerChunk))
+    {
+        Submit();
+    }
+}
+
+// Swapping keeps the capacity of both buffers, so once they have grown to a
+// chunk's worth of frames recording no longer allocates
+void TrajectoryRecorder::Submit()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (backPending)
+    {
+        return; // Still writing the last chunk; this one grows instead
+    }
+    std::swap(front, back);
+    backPending = true;
+    front.Clear();
+    front.firstFrame = frameCount;
+    condition.notify_all();
+}
+
+void TrajectoryRecorder::WriterLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        condition.wait(lock, [this] { return backPending || stopping; });
+        if (!backPending)
+        {
+            return;
+        }
+
+        // The recording thread leaves back alone while it is pending
+        lock.unlock();
+        Encode(back);
+        const bool written = WriteRaw(file, encoded.data(), encoded.size());
+        lock.lock();
+
+        index.push_back({back.firstFrame, bytesWritten});
+        bytesWritten += encoded.size();
+        writeFailed |= !written;
+        backPending = false;
+        condition.notify_all();
+    }
+}
+
+// A chunk is its frame count, its size in bytes, then the frames. A frame is
+// its body count, then per body: slot, shape and flags against the last
+// frame's at that index, and the three prediction errors of the pose.
+void TrajectoryRecorder::Encode(const Chunk &chunk)
+{
+    encoded.assign(chunkHeaderSize, 0);
+    history.Clear();
+
+    size_t body = 0;
+    for (const std::uint32_t bodyCount : chunk.bodyCounts)
+    {
+        WriteVarint(encoded, bodyCount);
+        BeginFrame(history, bodyCount);
+        for (size_t i = 0; i < bodyCount; ++i, ++body)
+        {
+            const std::uint32_t slot = chunk.slots[body];
+            const std::uint32_t lastSlot = history.slots[0][i];
+            WriteVarint(encoded, ZigZag(static_cast<std::int64_t>(slot) - (lastSlot == noSlot ? 0 : lastSlot)));
+            WriteVarint(encoded, ZigZag(static_cast<std::int64_t>(chunk.shapes[body]) - history.shapes[i]));
+            WriteVarint(encoded, chunk.flags[body] ^ history.flags[i]);
+            history.shapes[i] = chunk.shapes[body];
+            history.flags[i] = chunk.flags[body];
+
+            const std::int32_t values[3] = {Quantize(chunk.positionX[body], settings.positionStep),
+                                            Quantize(chunk.positionY[body], settings.positionStep),
+                                            Quantize(chunk.angles[body], settings.angleStep)};
+            for (int component = 0; component < 3; ++component)
+            {
+                WriteVarint(encoded, ZigZag(values[component] - Predict(history, i, slot, component)));
+            }
+            Push(history, i, slot, values);
+        }
+        EndFrame(history, bodyCount);
+    }
+
+    const std::uint32_t sizes[2] = {static_cast<std::uint32_t>(chunk.bodyCounts.size()),
+                                    static_cast<std::uint32_t>(encoded.size() - sizeof(sizes))};
+    std::memcpy(encoded.data(), sizes, sizeof(sizes));
+}
+
+bool TrajectoryRecorder::Close()
+{
+    if (!file)
+    {
+        return false;
+    }
+
+    // Wait for the writer to be free, hand it the last frames and let it
+    // finish
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this] { return !backPending; });
+        if (!front.bodyCounts.empty())
+        {
+            std::swap(front, back);
+            backPending = true;
+            front.Clear();
+        }
+        stopping = true;
+        condition.notify_all();
+    }
+    writer.join();
+
+    // Shape table, index, footer
+    TrajectoryFileFooter footer = {};
+    footer.shapeTableOffset = bytesWritten;
+    const std::uint32_t shapeCount = static_cast<std::uint32_t>(shapeTable.size());
+    bool written = !writeFailed && WriteRaw(file, &shapeCount, 1);
+    bytesWritten += sizeof(shapeCount);
+    for (const TrajectoryShape &shape : shapeTable)
+    {
+        const std::uint32_t type = shape.type;
+        const std::uint32_t vertexCount = static_cast<std::uint32_t>(shape.vertices.size());
+        written = written && WriteRaw(file, &type, 1) && WriteRaw(file, &shape.radius, 1) &&
+                  WriteRaw(file, &vertexCount, 1);
+        for (const Vec2 &vertex : shape.vertices)
+        {
+            const float coordinates[2] = {vertex.x, vertex.y};
+            written = written && WriteRaw(file, coordinates, 2);
+        }
+        bytesWritten += 3 * sizeof(std::uint32_t) + shape.vertices.size() * 2 * sizeof(float);
+    }
+
+    footer.indexOffset = bytesWritten;
+    footer.frameCount = frameCount;
+    footer.chunkCount = static_cast<std::uint32_t>(index.size());
+    std::memcpy(footer.magic, magic, sizeof(magic));
+    written = written && WriteRaw(file, index.data(), index.size()) && WriteRaw(file, &footer, 1);
+    bytesWritten += index.size() * sizeof(TrajectoryChunkEntry) + sizeof(footer);
+
+    written = std::fclose(file) == 0 && written;
+    file = nullptr;
+    geometries.clear();
+    return written;
+}
+
+std::uint64_t TrajectoryRecorder::GetBytesWritten() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytesWritten;
+}
+
+// --- TrajectoryReader ---
+
+TrajectoryReader::~TrajectoryReader()
+{
+    Close();
+}
+
+void TrajectoryReader::Close()
+{
+    if (file)
+    {
+        std::fclose(file);
+        file = nullptr;
+    }
+    frameCount = 0;
+    shapeTableOffset = 0;
+    index.clear();
+    shapes.clear();
+    loadedChunk = SIZE_MAX;
+}
+
+bool TrajectoryReader::Open(const char *path)
+{
+    Close();
+    file = std::fopen(path, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    // The footer is at the end of the file, and every part it points to must
+    // lie between the header and it. The index is what is left in between.
+    TrajectoryFileFooter footer;
+    std::uint64_t fileSize = 0;
+    bool valid = GetFileSize(file, fileSize) && fileSize >= sizeof(header) + sizeof(footer) && Seek(file, 0) &&
+                 ReadRaw(file, &header, 1) && std::memcmp(header.magic, magic, sizeof(magic)) == 0 &&
+                 header.version == version && Seek(file, fileSize - sizeof(footer)) && ReadRaw(file, &footer, 1) &&
+                 std::memcmp(footer.magic, magic, sizeof(magic)) == 0 && footer.shapeTableOffset >= sizeof(header) &&
+                 footer.shapeTableOffset <= footer.indexOffset && footer.indexOffset <= fileSize - sizeof(footer) &&
+                 (fileSize - sizeof(footer) - footer.indexOffset) ==
+                     static_cast<std::uint64_t>(footer.chunkCount) * sizeof(TrajectoryChunkEntry);
+
+    // The shape table runs up to the index. Each vertex count is checked
+    // against the bytes left before it is read.
+    if (valid && Seek(file, footer.shapeTableOffset))
+    {
+        std::uint32_t shapeCount = 0;
+        std::uint64_t position = footer.shapeTableOffset + sizeof(shapeCount);
+        valid = position <= footer.indexOffset && ReadRaw(file, &shapeCount, 1);
+        for (std::uint32_t i = 0; valid && i < shapeCount; ++i)
+        {
+            std::uint32_t type = 0;
+            std::uint32_t vertexCount = 0;
+            TrajectoryShape shape = {};
+            position += 3 * sizeof(std::uint32_t);
+            valid = position <= footer.indexOffset && ReadRaw(file, &type, 1) && ReadRaw(file, &shape.radius, 1) &&
+                    ReadRaw(file, &vertexCount, 1) && type < Shape::TYPE_COUNT &&
+                    vertexCount <= (footer.indexOffset - position) / (2 * sizeof(float));
+            if (!valid)
+            {
+                break;
+            }
+            position += static_cast<std::uint64_t>(vertexCount) * 2 * sizeof(float);
+            shape.type = static_cast<Shape::Type>(type);
+            for (std::uint32_t k = 0; valid && k < vertexCount; ++k)
+            {
+                float coordinates[2];
+                valid = ReadRaw(file, coordinates, 2);
+                shape.vertices.push_back(Vec2(coordinates[0], coordinates[1]));
+                shape.extent = std::max(shape.extent, shape.vertices.back().Magnitude());
+            }
+            shape.extent = std::max(shape.extent, shape.radius);
+            shapes.push_back(std::move(shape));
+        }
+        valid = valid && position == footer.indexOffset;
+    }
+    else
+    {
+        valid = false;
+    }
+
+    if (valid && Seek(file, footer.indexOffset))
+    {
+        index.resize(footer.chunkCount);
+        valid = ReadRaw(file, index.data(), index.size());
+    }
+    else
+    {
+        valid = false;
+    }
+
+    // Chunks follow each other in frame order and cover every frame. They lie
+    // back to back between the header and the shape table, so each starts at
+    // least a chunk header past the one before.
+    for (size_t i = 0; valid && i < index.size(); ++i)
+    {
+        const std::uint64_t start = i == 0 ? sizeof(header) : index[i - 1].offset + chunkHeaderSize;
+        valid = index[i].offset >= start && index[i].offset <= footer.shapeTableOffset - chunkHeaderSize &&
+                index[i].firstFrame < footer.frameCount &&
+                (i == 0 ? index[i].firstFrame == 0 : index[i].firstFrame > index[i - 1].firstFrame);
+    }
+    valid = valid && (index.empty() == (footer.frameCount == 0));
+
+    if (!valid)
+    {
+        Close();
+        return false;
+    }
+    frameCount = footer.frameCount;
+    shapeTableOffset = footer.shapeTableOffset;
+    return true;
+}
+
+bool TrajectoryReader::LoadChunk(size_t chunk)
+{
+    loadedChunk = SIZE_MAX;
+    std::uint32_t sizes[2];
+    if (!Seek(file, index[chunk].offset) || !ReadRaw(file, sizes, 2))
+    {
+        return false;
+    }
+    // The chunk's bytes run up to the next chunk, or the shape table
+    const std::uint64_t end = chunk + 1 < index.size() ? index[chunk + 1].firstFrame : frameCount;
+    const std::uint64_t limit = chunk + 1 < index.size() ? index[chunk + 1].offset : shapeTableOffset;
+    if (index[chunk].firstFrame + sizes[0] != end || sizes[1] != limit - index[chunk].offset - chunkHeaderSize)
+    {
+        return false;
+    }
+    chunkBytes.resize(sizes[1]);
+    if (!ReadRaw(file, chunkBytes.data(), chunkBytes.size()))
+    {
+        return false;
+    }
+
+    loadedChunk = chunk;
+    cursor = 0;
+    nextFrame = index[chunk].firstFrame;
+    chunkEnd = end;
+    history.Clear();
+    return true;
+}
+
+bool TrajectoryReader::DecodeNext(TrajectoryFrame &out)
+{
+    std::uint64_t bodyCount;
+    if (!ReadVarint(chunkBytes, cursor, bodyCount) || bodyCount > chunkBytes.size() - cursor)
+    {
+        return false; // Every body takes at least a byte per field
+    }
+
+    out.slots.resize(bodyCount);
+    out.shapes.resize(bodyCount);
+    out.flags.resize(bodyCount);
+    out.positionX.resize(bodyCount);
+    out.positionY.resize(bodyCount);
+    out.angles.resize(bodyCount);
+    BeginFrame(history, bodyCount);
+    for (size_t i = 0; i < bodyCount; ++i)
+    {
+        std::uint64_t fields[6];
+        for (std::uint64_t &field : fields)
+        {
+            if (!ReadVarint(chunkBytes, cursor, field))
+            {
+                return false;
+            }
+        }
+
+        const std::uint32_t lastSlot = history.slots[0][i];
+        const std::uint32_t slot = static_cast<std::uint32_t>(UnZigZag(fields[0]) + (lastSlot == noSlot ? 0 : lastSlot));
+        const std::uint32_t shape = static_cast<std::uint32_t>(UnZigZag(fields[1]) + history.shapes[i]);
+        if (shape >= shapes.size())
+        {
+            return false;
+        }
+        history.shapes[i] = shape;
+        history.flags[i] = static_cast<std::uint8_t>(fields[2] ^ history.flags[i]);
+
+        std::int32_t values[3];
+        for (int component = 0; component < 3; ++component)
+        {
+            values[component] = static_cast<std::int32_t>(UnZigZag(fields[3 + component]) + Predict(history, i, slot, component));
+        }
+        Push(history, i, slot, values);
+
+        out.slots[i] = slot;
+        out.shapes[i] = shape;
+        out.flags[i] = history.flags[i];
+        out.positionX[i] = static_cast<float>(values[0] * static_cast<double>(header.positionStep));
+        out.positionY[i] = static_cast<float>(values[1] * static_cast<double>(header.positionStep));
+        out.angles[i] = static_cast<float>(values[2] * static_cast<double>(header.angleStep));
+    }
+    EndFrame(history, bodyCount);
+    ++nextFrame;
+    return true;
+}
+
+bool TrajectoryReader::ReadFrame(std::uint64_t frame, TrajectoryFrame &out)
+{
+    if (!file || frame >= frameCount)
+    {
+        return false;
+    }
+
+    // Decode on from where the last read left off if the frame is ahead of
+    // it in the same chunk, or else from the start of the frame's chunk
+    if (loadedChunk == SIZE_MAX || frame < nextFrame || frame >= chunkEnd)
+    {
+        const auto it = std::upper_bound(index.begin(), index.end(), frame,
+                                         [](std::uint64_t value, const TrajectoryChunkEntry &entry)
+                                         { return value < entry.firstFrame; });
+        if (!LoadChunk(static_cast<size_t>(it - index.begin()) - 1))
+        {
+            return false;
+        }
+    }
+    while (nextFrame <= frame)
+    {
+        if (!DecodeNext(out))
+        {
+            loadedChunk = SIZE_MAX;
+            return false;
+        }
+    }
+    return true;
+}
+
+void TrajectoryReader::Draw(const TrajectoryFrame &frame, DebugDraw &draw) const
+{
+    for (size_t i = 0; i < frame.GetBodyCount(); ++i)
+    {
+        const bool isStatic = (frame.flags[i] & TrajectoryFrame::STATIC) != 0;
+        const bool isAwake = (frame.flags[i] & TrajectoryFrame::AWAKE) != 0;
+        const Color color = isStatic ? Color(0, 255, 100) : (isAwake ? Color(255, 255, 255) : Color(128, 128, 128));
+        const TrajectoryShape &shape = shapes[frame.shapes[i]];
+        const Vec2 position(frame.positionX[i], frame.positionY[i]);
+        if (!draw.IsVisible(AABB(position, position).Fattened(shape.extent)))
+        {
+            continue;
+        }
+        const Transform transform(position, frame.angles[i]);
+        if (shape.type == Shape::POLYGON)
+        {
+            drawVertices.resize(shape.vertices.size());
+            for (size_t k = 0; k < shape.vertices.size(); ++k)
+            {
+                drawVertices[k] = transform.Apply(shape.vertices[k]);
+            }
+            draw.DrawPolygon(drawVertices.data(), static_cast<int>(drawVertices.size()), color);
+        }
+        else
+        {
+            draw.DrawCircle(transform.position, shape.radius, transform.angle, color);
+        }
+    }
+}
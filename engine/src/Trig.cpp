@@ -0,0 +1,39 @@
+#include <Trig.h>
+
+// The polynomials are the minimax fits of Cephes' sinf and cosf on
+// [-pi/4, pi/4]. The angle is first brought into that range by subtracting a
+// whole number of quarter turns, with pi/2 split in three parts (Cody-Waite)
+// so that the products with the number of quarter turns are exact.
+void Trig::SinCosPortable(float angle, float &sine, float &cosine)
+{
+    const float quarterTurns = std::floor(angle * 0.636619772f + 0.5f);
+    float r = angle - quarterTurns * 1.5703125f;
+    r = r - quarterTurns * 4.837512969970703125e-4f;
+    r = r - quarterTurns * 7.54978995489188216e-8f;
+
+    const float r2 = r * r;
+    const float sinR = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+    const float cosR = 1.0f - 0.5f * r2 +
+                       r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+
+    // sin and cos of r plus that many quarter turns
+    switch (static_cast<long long>(quarterTurns) & 3)
+    {
+    case 0:
+        sine = sinR;
+        cosine = cosR;
+        break;
+    case 1:
+        sine = cosR;
+        cosine = -sinR;
+        break;
+    case 2:
+        sine = -sinR;
+        cosine = -cosR;
+        break;
+    default:
+        sine = -cosR;
+        cosine = sinR;
+        break;
+    }
+}
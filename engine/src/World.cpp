@@ -0,0 +1,1142 @@
+#include <World.h>
+#include <CircleShape.h>
+#include <Distance.h>
+#include <PolygonShape.h>
+#include <Integrator.h>
+#include <Trajectory.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// --- BodyRef ---
+
+Vec2 BodyRef::GetPosition() const { return Vec2(world->positionX[index], world->positionY[index]); }
+void BodyRef::SetPosition(const Vec2 &position)
+{
+    world->SetAwake(index, true);
+    world->positionX[index] = position.x;
+    world->positionY[index] = position.y;
+}
+Vec2 BodyRef::GetVelocity() const { return Vec2(world->velocityX[index], world->velocityY[index]); }
+void BodyRef::SetVelocity(const Vec2 &velocity)
+{
+    world->SetAwake(index, true);
+    world->velocityX[index] = velocity.x;
+    world->velocityY[index] = velocity.y;
+}
+float BodyRef::GetAngle() const { return world->angles[index]; }
+void BodyRef::SetAngle(float angle)
+{
+    world->SetAwake(index, true);
+    world->angles[index] = angle;
+}
+float BodyRef::GetAngularVelocity() const { return world->angularVelocities[index]; }
+void BodyRef::SetAngularVelocity(float angularVelocity)
+{
+    world->SetAwake(index, true);
+    world->angularVelocities[index] = angularVelocity;
+}
+
+float BodyRef::GetInverseMass() const { return world->inverseMasses[index]; }
+float BodyRef::GetInverseInertia() const { return world->inverseInertias[index]; }
+
+Shape &BodyRef::GetShape() const { return *world->shapes[index]; }
+Shape::Type BodyRef::GetShapeType() const { return world->shapeTypes[index]; }
+
+void BodyRef::AddForce(const Vec2 &force)
+{
+    world->SetAwake(index, true);
+    world->forceX[index] += force.x;
+    world->forceY[index] += force.y;
+}
+void BodyRef::AddTorque(float torque)
+{
+    world->SetAwake(index, true);
+    world->torques[index] += torque;
+}
+
+bool BodyRef::IsAwake() const { return world->IsAwake(index); }
+void BodyRef::SetAwake(bool awake) { world->SetAwake(index, awake); }
+
+bool BodyRef::IsBullet() const { return world->IsBullet(index); }
+void BodyRef::SetBullet(bool bullet) { world->SetBullet(index, bullet); }
+
+BodyHandle BodyRef::GetHandle() const { return world->GetHandle(index); }
+
+// --- World ---
+
+World::World(int threadCount)
+    : jobSystem(std::make_unique<JobSystem>(threadCount)),
+      broadphase(std::make_unique<TreeBroadphase>())
+{
+}
+
+namespace
+{
+    // Items per job for the different passes
+    const size_t bodyGrainSize = 1024;
+    const size_t pairGrainSize = 256;
+    const size_t islandGrainSize = 16;
+}
+
+BodyHandle World::CreateBody(const Shape &shape, float x, float y)
+{
+    const std::uint32_t index = static_cast<std::uint32_t>(shapes.size());
+
+    positionX.push_back(x);
+    positionY.push_back(y);
+    velocityX.push_back(0.0f);
+    velocityY.push_back(0.0f);
+    forceX.push_back(0.0f);
+    forceY.push_back(0.0f);
+    angles.push_back(0.0f);
+    angularVelocities.push_back(0.0f);
+    torques.push_back(0.0f);
+
+    const float mass = shape.mass;
+    inverseMasses.push_back(mass <= 1e-6f ? 0.0f : 1.0f / mass);
+    const float inertia = shape.GetMomentOfInertia();
+    inverseInertias.push_back(inertia <= 1e-6f ? 0.0f : 1.0f / inertia);
+    activeInverseMasses.push_back(inverseMasses.back());
+    activeInverseInertias.push_back(inverseInertias.back());
+    awake.push_back(1);
+    sleepTimes.push_back(0.0f);
+    bullets.push_back(0);
+    previousPositionX.push_back(x);
+    previousPositionY.push_back(y);
+    previousAngles.push_back(0.0f);
+
+    shapeTypes.push_back(shape.GetType());
+    shapes.push_back(CreateShape(shape));
+    transforms.push_back(Transform(Vec2(x, y), 0.0f));
+
+    // Reuse a free slot if there is one
+    std::uint32_t slot;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        slot = static_cast<std::uint32_t>(slots.size());
+        slots.emplace_back();
+    }
+    slots[slot].index = index;
+    indexToSlot.push_back(slot);
+
+    if (shapeTypes[index] == Shape::POLYGON)
+    {
+        static_cast<PolygonShape *>(shapes[index])->UpdateWorldVertices(transforms[index]);
+    }
+    aabbs.push_back(ComputeAABB(index));
+
+    BodyHandle handle;
+    handle.slot = slot;
+    handle.generation = slots[slot].generation;
+    return handle;
+}
+
+// A copy of shape from the pools. Polygons share the registered geometry
+// with the same outline, and only get their own world vertices.
+Shape *World::CreateShape(const Shape &shape)
+{
+    if (shape.GetType() == Shape::POLYGON)
+    {
+        const PolygonShape &polygon = static_cast<const PolygonShape &>(shape);
+        PolygonShape *copy = polygonPool.Create(polygon);
+        copy->geometry = shapeRegistry.Intern(polygon.geometry);
+        return copy;
+    }
+    return circlePool.Create(static_cast<const CircleShape &>(shape));
+}
+
+// Back to its pool, where the next body of the same kind reuses it. A
+// polygon lets go of its geometry, and the registry forgets a geometry no
+// other body uses, so a world that keeps making new outlines does not keep
+// every one it ever made.
+void World::ReleaseShape(Shape *shape)
+{
+    if (shape->GetType() == Shape::POLYGON)
+    {
+        PolygonShape *polygon = static_cast<PolygonShape *>(shape);
+        const std::shared_ptr<const PolygonGeometry> geometry = std::move(polygon->geometry);
+        polygonPool.Release(polygon);
+        shapeRegistry.Release(geometry);
+    }
+    else
+    {
+        circlePool.Release(static_cast<CircleShape *>(shape));
+    }
+}
+
+void World::Reserve(size_t bodyCount)
+{
+    for (auto *array : {&positionX, &positionY, &velocityX, &velocityY, &forceX, &forceY, &angles,
+                        &angularVelocities, &torques, &inverseMasses, &inverseInertias, &activeInverseMasses,
+                        &activeInverseInertias, &sleepTimes, &previousPositionX, &previousPositionY, &previousAngles})
+    {
+        array->reserve(bodyCount);
+    }
+    awake.reserve(bodyCount);
+    bullets.reserve(bodyCount);
+    shapeTypes.reserve(bodyCount);
+    shapes.reserve(bodyCount);
+    transforms.reserve(bodyCount);
+    aabbs.reserve(bodyCount);
+    slots.reserve(bodyCount);
+    freeSlots.reserve(bodyCount);
+    indexToSlot.reserve(bodyCount);
+    circlePool.Reserve(bodyCount);
+    polygonPool.Reserve(bodyCount);
+}
+
+BodyHandle World::GetHandle(size_t index) const
+{
+    BodyHandle handle;
+    handle.slot = indexToSlot[index];
+    handle.generation = slots[handle.slot].generation;
+    return handle;
+}
+
+bool World::IsValid(BodyHandle handle) const
+{
+    return handle.slot < slots.size() && slots[handle.slot].generation == handle.generation &&
+           slots[handle.slot].index < shapes.size() && indexToSlot[slots[handle.slot].index] == handle.slot;
+}
+
+void World::DestroyBody(BodyHandle handle)
+{
+    if (!IsValid(handle))
+    {
+        return;
+    }
+
+    // Bodies sleeping on this one would be left hanging in the air
+    const std::uint32_t index = slots[handle.slot].index;
+    for (size_t i = 0; i < GetBodyCount(); ++i)
+    {
+        if (!awake[i] && aabbs[i].Overlaps(aabbs[index]))
+        {
+            SetAwake(i, true);
+        }
+    }
+
+    RemoveBody(handle);
+
+    // The slot will be reused, so forget its contacts
+    pairCache.erase(std::remove_if(pairCache.begin(), pairCache.end(), [&](const CachedPair &cached)
+                                   { return static_cast<std::uint32_t>(cached.key >> 32) == handle.slot ||
+                                            static_cast<std::uint32_t>(cached.key) == handle.slot; }),
+                    pairCache.end());
+}
+
+// Destroying bodies one by one scans every body for sleepers and every
+// cached contact, per body. Here the sleepers touching any of the bodies are
+// found in one sweep over the boxes sorted along x, and the contacts are
+// filtered once.
+void World::DestroyBodies(const std::vector<BodyHandle> &handles)
+{
+    std::vector<std::uint8_t> destroyed(slots.size(), 0);
+    for (const BodyHandle handle : handles)
+    {
+        if (IsValid(handle))
+        {
+            destroyed[handle.slot] = 1;
+        }
+    }
+
+    // Sleeping bodies and destroyed ones, by the left side of their box. A
+    // box leaves the sweep once the boxes reached start right of it.
+    struct Entry
+    {
+        float minX;
+        std::uint32_t index;
+        bool destroyed;
+    };
+    std::vector<Entry> entries;
+    for (size_t i = 0; i < GetBodyCount(); ++i)
+    {
+        const bool isDestroyed = destroyed[indexToSlot[i]] != 0;
+        if (isDestroyed || !awake[i])
+        {
+            entries.push_back({aabbs[i].min.x, static_cast<std::uint32_t>(i), isDestroyed});
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry &x, const Entry &y)
+              { return x.minX < y.minX || (x.minX == y.minX && x.index < y.index); });
+
+    std::vector<std::uint32_t> open[2]; // [0] sleeping, [1] destroyed
+    for (const Entry &entry : entries)
+    {
+        for (std::vector<std::uint32_t> &list : open)
+        {
+            list.erase(std::remove_if(list.begin(), list.end(), [&](std::uint32_t i)
+                                      { return aabbs[i].max.x < entry.minX; }),
+                       list.end());
+        }
+        for (const std::uint32_t other : open[entry.destroyed ? 0 : 1])
+        {
+            if (aabbs[other].Overlaps(aabbs[entry.index]))
+            {
+                SetAwake(entry.destroyed ? other : entry.index, true);
+            }
+        }
+        open[entry.destroyed ? 1 : 0].push_back(entry.index);
+    }
+
+    for (const BodyHandle handle : handles)
+    {
+        if (IsValid(handle))
+        {
+            RemoveBody(handle);
+        }
+    }
+
+    pairCache.erase(std::remove_if(pairCache.begin(), pairCache.end(), [&](const CachedPair &cached)
+                                   { return destroyed[static_cast<std::uint32_t>(cached.key >> 32)] ||
+                                            destroyed[static_cast<std::uint32_t>(cached.key)]; }),
+                    pairCache.end());
+}
+
+// Takes a valid body out of the arrays and frees its slot. Waking the bodies
+// around it and its cached contacts are up to the caller.
+void World::RemoveBody(BodyHandle handle)
+{
+    // Keep the arrays packed: move the last body into the hole
+    const std::uint32_t index = slots[handle.slot].index;
+    const std::uint32_t last = static_cast<std::uint32_t>(shapes.size()) - 1;
+
+    bulletCount -= bullets[index];
+    bulletStarts.clear();
+
+    ReleaseShape(shapes[index]);
+
+    auto removeAt = [index](auto &array)
+    {
+        array[index] = std::move(array.back());
+        array.pop_back();
+    };
+    removeAt(positionX);
+    removeAt(positionY);
+    removeAt(velocityX);
+    removeAt(velocityY);
+    removeAt(forceX);
+    removeAt(forceY);
+    removeAt(angles);
+    removeAt(angularVelocities);
+    removeAt(torques);
+    removeAt(inverseMasses);
+    removeAt(inverseInertias);
+    removeAt(activeInverseMasses);
+    removeAt(activeInverseInertias);
+    removeAt(awake);
+    removeAt(sleepTimes);
+    removeAt(bullets);
+    removeAt(previousPositionX);
+    removeAt(previousPositionY);
+    removeAt(previousAngles);
+    removeAt(shapeTypes);
+    removeAt(shapes);
+    removeAt(transforms);
+    removeAt(aabbs);
+
+    if (index != last)
+    {
+        const std::uint32_t movedSlot = indexToSlot[last];
+        indexToSlot[index] = movedSlot;
+        slots[movedSlot].index = index;
+    }
+    indexToSlot.pop_back();
+
+    ++slots[handle.slot].generation;
+    freeSlots.push_back(handle.slot);
+}
+
+void World::SetAwake(size_t index, bool isAwake)
+{
+    if (inverseMasses[index] == 0.0f || (awake[index] != 0) == isAwake)
+    {
+        return;
+    }
+
+    awake[index] = isAwake ? 1 : 0;
+    sleepTimes[index] = 0.0f;
+    if (isAwake)
+    {
+        activeInverseMasses[index] = inverseMasses[index];
+        activeInverseInertias[index] = inverseInertias[index];
+        return;
+    }
+
+    activeInverseMasses[index] = 0.0f;
+    activeInverseInertias[index] = 0.0f;
+    velocityX[index] = 0.0f;
+    velocityY[index] = 0.0f;
+    angularVelocities[index] = 0.0f;
+    forceX[index] = 0.0f;
+    forceY[index] = 0.0f;
+    torques[index] = 0.0f;
+}
+
+void World::SetBullet(size_t index, bool isBullet)
+{
+    if ((bullets[index] != 0) == isBullet)
+    {
+        return;
+    }
+    bullets[index] = isBullet ? 1 : 0;
+    if (isBullet)
+        ++bulletCount;
+    else
+        --bulletCount;
+}
+
+size_t World::GetAwakeBodyCount() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < GetBodyCount(); ++i)
+    {
+        if (IsActive(i))
+        {
+            ++count;
+        }
+    }
+    return count;
+}
+
+size_t World::GetContactCount() const
+{
+    size_t count = 0;
+    for (size_t k = 0; k < touching.size(); ++k)
+    {
+        if (touching[k])
+        {
+            count += manifolds[k].pointCount;
+        }
+    }
+    return count;
+}
+
+void World::SetBroadphase(std::unique_ptr<Broadphase> newBroadphase)
+{
+    broadphase = std::move(newBroadphase);
+}
+
+// Each phase is a profiler scope, and the counters are taken once the step
+// is done (see GetProfiler)
+void World::Step(float dt)
+{
+    ENGINE_PROFILE_FRAME(profiler);
+    frameArena.Reset();
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "Integrate");
+        Integrate(dt);
+    }
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "UpdateWorldVertices");
+        UpdateWorldVertices();
+    }
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "UpdateAABBs");
+        UpdateAABBs();
+    }
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "FindPairs");
+        FindPairs();
+    }
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "DetectCollisions");
+        DetectCollisions();
+    }
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "BuildIslands");
+        BuildIslands();
+    }
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "ResolveCollisions");
+        ResolveCollisions(dt);
+    }
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "SolveContinuous");
+        SolveContinuous(dt);
+    }
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "UpdateSleep");
+        UpdateSleep(dt);
+    }
+    if (hashEachStep)
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "HashState");
+        stateHash = ComputeStateHash();
+    }
+    if (recorder)
+    {
+        ENGINE_PROFILE_SCOPE(profiler, "Record");
+        recorder->Record(*this);
+    }
+
+    ENGINE_PROFILE_COUNTER(profiler, "bodies", static_cast<std::int64_t>(GetBodyCount()));
+    ENGINE_PROFILE_COUNTER(profiler, "bodies awake", static_cast<std::int64_t>(GetAwakeBodyCount()));
+    ENGINE_PROFILE_COUNTER(profiler, "pairs", static_cast<std::int64_t>(pairs.size()));
+    ENGINE_PROFILE_COUNTER(profiler, "pairs tested", std::count(tested.begin(), tested.end(), 1));
+    ENGINE_PROFILE_COUNTER(profiler, "pairs colliding", std::count(touching.begin(), touching.end(), 1));
+    ENGINE_PROFILE_COUNTER(profiler, "contacts", static_cast<std::int64_t>(GetContactCount()));
+    ENGINE_PROFILE_COUNTER(profiler, "islands", static_cast<std::int64_t>(islands.GetIslandCount()));
+}
+
+std::uint64_t World::ComputeStateHash() const
+{
+    std::uint64_t hash = stateHashSeed;
+    for (const std::vector<float> *array : {&positionX, &positionY, &velocityX, &velocityY, &angles,
+                                            &angularVelocities, &sleepTimes})
+    {
+        hash = HashState(*array, hash);
+    }
+    return HashState(awake, hash);
+}
+
+int World::Update(float elapsedTime)
+{
+    accumulator += elapsedTime;
+    int steps = 0;
+    while (accumulator >= fixedTimeStep)
+    {
+        if (steps == maxStepsPerUpdate)
+        {
+            accumulator = std::fmod(accumulator, fixedTimeStep);
+            break;
+        }
+        previousPositionX = positionX;
+        previousPositionY = positionY;
+        previousAngles = angles;
+        const int count = std::max(substeps, 1);
+        for (int substep = 0; substep < count; ++substep)
+        {
+            Step(fixedTimeStep / static_cast<float>(count));
+        }
+        accumulator -= fixedTimeStep;
+        ++steps;
+    }
+    return steps;
+}
+
+Transform World::GetInterpolatedTransform(size_t index) const
+{
+    const float alpha = GetInterpolationAlpha();
+    const Vec2 previous(previousPositionX[index], previousPositionY[index]);
+    const Vec2 current(positionX[index], positionY[index]);
+    return Transform(previous + (current - previous) * alpha,
+                     previousAngles[index] + (angles[index] - previousAngles[index]) * alpha);
+}
+
+// Semi-implicit Euler over the whole arrays, the same maths as Body::Integrate.
+// Gravity is added as an acceleration, so it does not need the mass, and
+// static and sleeping bodies are masked out inside the kernel.
+void World::Integrate(float dt)
+{
+    bulletStarts.clear();
+    for (size_t i = 0; bulletCount > 0 && i < GetBodyCount(); ++i)
+    {
+        if (bullets[i] && IsActive(i))
+        {
+            bulletStarts.push_back({static_cast<std::uint32_t>(i), Vec2(positionX[i], positionY[i]), angles[i]});
+        }
+    }
+
+    jobSystem->ParallelFor(GetBodyCount(), bodyGrainSize, [&](size_t begin, size_t end)
+                           {
+        const size_t count = end - begin;
+        Integrator::IntegrateAxis(&positionX[begin], &velocityX[begin], &forceX[begin], &activeInverseMasses[begin], gravity.x, dt, count);
+        Integrator::IntegrateAxis(&positionY[begin], &velocityY[begin], &forceY[begin], &activeInverseMasses[begin], gravity.y, dt, count);
+        Integrator::IntegrateAxis(&angles[begin], &angularVelocities[begin], &torques[begin], &activeInverseInertias[begin], 0.0f, dt, count);
+
+        std::fill(&forceX[begin], &forceX[begin] + count, 0.0f);
+        std::fill(&forceY[begin], &forceY[begin] + count, 0.0f);
+        std::fill(&torques[begin], &torques[begin] + count, 0.0f); });
+}
+
+// cos/sin are computed at most once per body and step, and only for bodies
+// that rotated. Bodies that did not move at all (static ones like the floor,
+// or resting and sleeping ones) keep last step's vertices untouched.
+void World::UpdateWorldVertices()
+{
+    jobSystem->ParallelFor(GetBodyCount(), bodyGrainSize, [&](size_t begin, size_t end)
+                           {
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (!awake[i] || !transforms[i].Set(Vec2(positionX[i], positionY[i]), angles[i]) || shapeTypes[i] != Shape::POLYGON)
+            {
+                continue;
+            }
+            static_cast<PolygonShape *>(shapes[i])->UpdateWorldVertices(transforms[i]);
+        } });
+}
+
+// Sleeping bodies keep their AABB from when they fell asleep
+void World::UpdateAABBs()
+{
+    jobSystem->ParallelFor(GetBodyCount(), bodyGrainSize, [&](size_t begin, size_t end)
+                           {
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (awake[i])
+            {
+                aabbs[i] = ComputeAABB(i);
+            }
+        } });
+}
+
+AABB World::ComputeAABB(size_t index) const
+{
+    const Vec2 position(positionX[index], positionY[index]);
+    if (shapeTypes[index] == Shape::CIRCLE)
+    {
+        const float radius = static_cast<const CircleShape *>(shapes[index])->radius;
+        return AABB(position - Vec2(radius, radius), position + Vec2(radius, radius));
+    }
+
+    const std::vector<Vec2> &vertices = static_cast<const PolygonShape *>(shapes[index])->worldVertices;
+    AABB aabb(position, position);
+    if (!vertices.empty())
+    {
+        aabb = AABB(vertices[0], vertices[0]);
+    }
+    for (const auto &v : vertices)
+    {
+        aabb.min.x = std::min(aabb.min.x, v.x);
+        aabb.min.y = std::min(aabb.min.y, v.y);
+        aabb.max.x = std::max(aabb.max.x, v.x);
+        aabb.max.y = std::max(aabb.max.y, v.y);
+    }
+    return aabb;
+}
+
+// Distance from the body position to the furthest point of its shape
+float World::ComputeReach(size_t index) const
+{
+    const Shape &shape = *shapes[index];
+    const Vec2 position(positionX[index], positionY[index]);
+    float reachSquared = 0.0f;
+    for (int i = 0; i < shape.GetVertexCount(); ++i)
+    {
+        reachSquared = std::max(reachSquared, (shape.GetVertex(i, position) - position).MagnitudeSq());
+    }
+    return std::sqrt(reachSquared) + shape.GetRadius();
+}
+
+void World::FindPairs()
+{
+    broadphase->FindPairs(aabbs, pairs);
+#if ENGINE_DETERMINISTIC
+    // Everything after this runs in pair order. The broadphases here sort
+    // their pairs, but one plugged in from outside might not.
+    if (!std::is_sorted(pairs.begin(), pairs.end()))
+    {
+        std::sort(pairs.begin(), pairs.end());
+    }
+#endif
+}
+
+// Narrow phase. Every pair is independent, so they are tested in parallel
+// and each one only writes its own slot of manifolds/touching.
+//
+// The pairs to test are first bucketed by the types of their two shapes
+// (a counting sort of their indices), and each bucket runs through its one
+// manifold function: no per pair dispatch, and a batch of the same kind of
+// work with the same branches taken. Within a bucket pairs keep their order,
+// and the pairs array itself is untouched, so the results do not change.
+void World::DetectCollisions()
+{
+    manifolds.resize(pairs.size());
+    touching.resize(pairs.size());
+    tested.resize(pairs.size());
+    narrowPhaseCaches.resize(pairs.size());
+
+    const size_t comboCount = Shape::TYPE_COUNT * Shape::TYPE_COUNT;
+    auto getCombo = [&](size_t k)
+    { return shapeTypes[pairs[k].a] * Shape::TYPE_COUNT + shapeTypes[pairs[k].b]; };
+    pairBucketOffsets.fill(0);
+    for (size_t k = 0; k < pairs.size(); ++k)
+    {
+        touching[k] = 0;
+        tested[k] = 0;
+        if (IsActive(pairs[k].a) || IsActive(pairs[k].b)) // Static and sleeping bodies do not move each other
+        {
+            ++pairBucketOffsets[getCombo(k) + 1];
+        }
+    }
+    for (size_t combo = 0; combo < comboCount; ++combo)
+    {
+        pairBucketOffsets[combo + 1] += pairBucketOffsets[combo];
+    }
+    pairOrder.resize(pairBucketOffsets[comboCount]);
+    std::array<std::uint32_t, comboCount> next;
+    std::copy(pairBucketOffsets.begin(), pairBucketOffsets.end() - 1, next.begin());
+    for (size_t k = 0; k < pairs.size(); ++k)
+    {
+        if (IsActive(pairs[k].a) || IsActive(pairs[k].b))
+        {
+            pairOrder[next[getCombo(k)]++] = static_cast<std::uint32_t>(k);
+        }
+    }
+
+    for (size_t combo = 0; combo < comboCount; ++combo)
+    {
+        const size_t first = pairBucketOffsets[combo];
+        const Collision::CollideFunction collide = Collision::GetCollideFunction(
+            static_cast<Shape::Type>(combo / Shape::TYPE_COUNT), static_cast<Shape::Type>(combo % Shape::TYPE_COUNT));
+        jobSystem->ParallelFor(pairBucketOffsets[combo + 1] - first, pairGrainSize, [&](size_t begin, size_t end)
+                               {
+            for (size_t j = first + begin; j < first + end; ++j)
+            {
+                TestPair(pairOrder[j], collide);
+            } });
+    }
+
+    WakeTouchingBodies();
+}
+
+// Runs the narrow phase on pairs[k], starting from the separating axis and
+// the simplex the pair had in the last step, and gives the new contact
+// points the impulses the same features had then
+void World::TestPair(size_t k, Collision::CollideFunction collide)
+{
+    const size_t a = pairs[k].a;
+    const size_t b = pairs[k].b;
+    const std::uint64_t key = GetPairKey(k);
+    const auto cached = std::lower_bound(pairCache.begin(), pairCache.end(), key,
+                                         [](const CachedPair &entry, std::uint64_t value)
+                                         { return entry.key < value; });
+    const bool found = cached != pairCache.end() && cached->key == key;
+    // A pair whose bodies swapped order sees its cache from the other side,
+    // and has its normal and ids the other way round
+    const bool sameOrder = found && cached->slotA == indexToSlot[a];
+
+    NarrowPhaseCache &cache = narrowPhaseCaches[k];
+    cache = found ? cached->cache : NarrowPhaseCache();
+    if (found && !sameOrder)
+    {
+        cache.axis.owner ^= 1;
+        for (int i = 0; i < cache.simplex.count; ++i)
+        {
+            std::swap(cache.simplex.indexA[i], cache.simplex.indexB[i]);
+        }
+    }
+
+    Manifold &manifold = manifolds[k];
+    tested[k] = 1;
+    touching[k] = collide(*shapes[a], Vec2(positionX[a], positionY[a]),
+                          *shapes[b], Vec2(positionX[b], positionY[b]), manifold, cache)
+                      ? 1
+                      : 0;
+    if (!touching[k] || !sameOrder)
+    {
+        return;
+    }
+
+    for (int p = 0; p < manifold.pointCount; ++p)
+    {
+        for (int q = 0; q < cached->manifold.pointCount; ++q)
+        {
+            if (manifold.points[p].id == cached->manifold.points[q].id)
+            {
+                manifold.points[p].normalImpulse = cached->manifold.points[q].normalImpulse;
+                manifold.points[p].tangentImpulse = cached->manifold.points[q].tangentImpulse;
+                break;
+            }
+        }
+    }
+}
+
+std::uint64_t World::GetPairKey(size_t k) const
+{
+    const std::uint32_t slotA = indexToSlot[pairs[k].a];
+    const std::uint32_t slotB = indexToSlot[pairs[k].b];
+    return static_cast<std::uint64_t>(std::min(slotA, slotB)) << 32 | std::max(slotA, slotB);
+}
+
+// An awake body touching a sleeping one wakes it up. The woken body may in
+// turn touch other sleeping bodies, through pairs that were skipped above,
+// so this repeats until nothing new wakes up.
+void World::WakeTouchingBodies()
+{
+    bool woke = true;
+    while (woke)
+    {
+        woke = false;
+        for (size_t k = 0; k < pairs.size(); ++k)
+        {
+            const size_t a = pairs[k].a;
+            const size_t b = pairs[k].b;
+            if (!tested[k])
+            {
+                if (!IsActive(a) && !IsActive(b))
+                {
+                    continue;
+                }
+                TestPair(k, Collision::GetCollideFunction(shapeTypes[a], shapeTypes[b]));
+            }
+
+            if (touching[k] && awake[a] != awake[b])
+            {
+                SetAwake(awake[a] ? b : a, true);
+                woke = true;
+            }
+        }
+    }
+}
+
+void World::BuildIslands()
+{
+    islands.Build(GetBodyCount(), activeInverseMasses, pairs, touching);
+}
+
+// Islands share no dynamic bodies, and the solver never writes the static
+// ones they do share, so each island is solved on its own thread.
+// Inside an island the contacts are solved in pair order, so the result
+// does not depend on the thread count.
+void World::ResolveCollisions(float dt)
+{
+    ContactSolver::Bodies bodies;
+    bodies.positionX = positionX.data();
+    bodies.positionY = positionY.data();
+    bodies.angles = angles.data();
+    bodies.velocityX = velocityX.data();
+    bodies.velocityY = velocityY.data();
+    bodies.angularVelocities = angularVelocities.data();
+    bodies.inverseMasses = inverseMasses.data();
+    bodies.inverseInertias = inverseInertias.data();
+
+    contactSolver.Reset(pairs.size(), GetBodyCount());
+    jobSystem->ParallelFor(islands.GetIslandCount(), islandGrainSize, [&](size_t begin, size_t end)
+                           {
+        for (size_t island = begin; island < end; ++island)
+        {
+            contactSolver.SolveIsland(bodies, solverSettings, dt, islands, island, pairs, manifolds);
+        } });
+
+    UpdatePairCache();
+}
+
+void World::UpdatePairCache()
+{
+    pairCache.clear();
+    for (size_t k = 0; k < pairs.size(); ++k)
+    {
+        if (!tested[k])
+        {
+            continue;
+        }
+        CachedPair &cached = pairCache.emplace_back();
+        cached.key = GetPairKey(k);
+        cached.slotA = indexToSlot[pairs[k].a];
+        cached.cache = narrowPhaseCaches[k];
+        cached.manifold.pointCount = 0;
+        if (touching[k])
+        {
+            cached.manifold = manifolds[k];
+        }
+    }
+    std::sort(pairCache.begin(), pairCache.end(), [](const CachedPair &x, const CachedPair &y)
+              { return x.key < y.key; });
+}
+
+// Sweeps each bullet from where it started the step to where the solver
+// left it, against the other bodies near its path, which hold still at
+// their end of step poses. At the first impact the bullet stops, bounces off
+// the body it hit, and travels on for the time it has left, which is swept
+// again: a bullet takes up to maxBulletSubsteps small steps while the rest
+// of the world takes one.
+void World::SolveContinuous(float dt)
+{
+    const float targetDistance = solverSettings.linearSlop;
+    const TreeBroadphase *tree = dynamic_cast<const TreeBroadphase *>(broadphase.get());
+
+    for (const BulletStart &start : bulletStarts)
+    {
+        const size_t i = start.index;
+        Sweep sweep = {start.position, Vec2(positionX[i], positionY[i]), start.angle, angles[i]};
+        Vec2 velocity(velocityX[i], velocityY[i]);
+        float timeLeft = dt;
+        const float reach = ComputeReach(i);
+
+        for (int substep = 0; substep < maxBulletSubsteps; ++substep)
+        {
+            const Vec2 extent(reach, reach);
+            const AABB sweptBox = AABB::Combine(AABB(sweep.position0 - extent, sweep.position0 + extent),
+                                                AABB(sweep.position1 - extent, sweep.position1 + extent));
+
+            // Earliest impact along the sweep. Bullets do not sweep against
+            // each other.
+            TimeOfImpactOutput first;
+            first.state = TimeOfImpactOutput::SEPARATED;
+            first.t = 1.0f;
+            size_t hit = i;
+            auto sweepAgainst = [&](size_t j)
+            {
+                if (j == i || bullets[j] || !aabbs[j].Overlaps(sweptBox))
+                {
+                    return;
+                }
+                const Vec2 position(positionX[j], positionY[j]);
+                const Sweep still = {position, position, angles[j], angles[j]};
+                TimeOfImpactOutput output = Distance::TimeOfImpact(*shapes[i], sweep, *shapes[j], still, targetDistance);
+                if (output.state == TimeOfImpactOutput::OVERLAPPED &&
+                    (sweep.position1 - sweep.position0).Dot(output.normal) > reach)
+                {
+                    // Touching at the start and then moving further into the
+                    // body than the bullet is big: the narrow phase looked at
+                    // the far side and missed it, so stop right here
+                    output.state = TimeOfImpactOutput::HIT;
+                }
+                // Ties go to the lowest body index, so the result does not
+                // depend on the order the tree happens to visit the bodies in
+                if (output.state == TimeOfImpactOutput::HIT &&
+                    (output.t < first.t || (output.t == first.t && first.state == TimeOfImpactOutput::HIT && j < hit)))
+                {
+                    first = output;
+                    hit = j;
+                }
+            };
+            if (tree)
+            {
+                tree->GetTree().Query(sweptBox, [&](int proxy)
+                                      {
+                    sweepAgainst(static_cast<size_t>(tree->GetTree().GetUserData(proxy)));
+                    return true; });
+            }
+            else
+            {
+                for (size_t j = 0; j < GetBodyCount(); ++j)
+                {
+                    sweepAgainst(j);
+                }
+            }
+
+            if (first.state != TimeOfImpactOutput::HIT)
+            {
+                break;
+            }
+
+            // Bounce off the body that was hit, with the solver's restitution
+            SetAwake(hit, true);
+            const Vec2 &normal = first.normal;
+            const Vec2 otherVelocity(velocityX[hit], velocityY[hit]);
+            const float approach = (velocity - otherVelocity).Dot(normal);
+            if (approach > 0.0f)
+            {
+                const float restitution = approach > solverSettings.restitutionThreshold ? solverSettings.restitution : 0.0f;
+                const float impulse = (1.0f + restitution) * approach / (inverseMasses[i] + inverseMasses[hit]);
+                velocity -= normal * (impulse * inverseMasses[i]);
+                velocityX[hit] += normal.x * impulse * inverseMasses[hit];
+                velocityY[hit] += normal.y * impulse * inverseMasses[hit];
+            }
+
+            const Transform impact = sweep.GetTransform(first.t);
+            timeLeft *= 1.0f - first.t;
+            sweep.position0 = impact.position;
+            sweep.angle0 = impact.angle;
+            if (substep == maxBulletSubsteps - 1)
+            {
+                // Out of substeps: wait at the impact for the next step
+                sweep.position1 = impact.position;
+                sweep.angle1 = impact.angle;
+                break;
+            }
+            sweep.position1 = impact.position + velocity * timeLeft;
+            sweep.angle1 = impact.angle + angularVelocities[i] * timeLeft;
+        }
+
+        positionX[i] = sweep.position1.x;
+        positionY[i] = sweep.position1.y;
+        angles[i] = sweep.angle1;
+        velocityX[i] = velocity.x;
+        velocityY[i] = velocity.y;
+
+        // The sweeps posed the shape all along the way
+        transforms[i].Set(sweep.position1, sweep.angle1);
+        shapes[i]->UpdateWorldVertices(transforms[i]);
+        aabbs[i] = ComputeAABB(i);
+    }
+}
+
+// Tracks how long each body has been resting. An island only falls asleep as
+// a whole, once its most recently moving body has rested for timeToSleep:
+// putting half of a stack to sleep would let the other half sink into it.
+void World::UpdateSleep(float dt)
+{
+    if (!allowSleep)
+    {
+        for (size_t i = 0; i < GetBodyCount(); ++i)
+        {
+            SetAwake(i, true);
+        }
+        return;
+    }
+
+    const float linearToleranceSquared = sleepLinearTolerance * sleepLinearTolerance;
+    const float angularToleranceSquared = sleepAngularTolerance * sleepAngularTolerance;
+    jobSystem->ParallelFor(GetBodyCount(), bodyGrainSize, [&](size_t begin, size_t end)
+                           {
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (!IsActive(i))
+            {
+                continue;
+            }
+            const float speedSquared = velocityX[i] * velocityX[i] + velocityY[i] * velocityY[i];
+            const float angularSpeedSquared = angularVelocities[i] * angularVelocities[i];
+            if (speedSquared > linearToleranceSquared || angularSpeedSquared > angularToleranceSquared)
+                sleepTimes[i] = 0.0f;
+            else
+                sleepTimes[i] += dt;
+        } });
+
+    jobSystem->ParallelFor(islands.GetIslandCount(), islandGrainSize, [&](size_t begin, size_t end)
+                           {
+        for (size_t island = begin; island < end; ++island)
+        {
+            float minSleepTime = timeToSleep;
+            for (int b = islands.islandBodyStarts[island]; b < islands.islandBodyStarts[island + 1]; ++b)
+            {
+                minSleepTime = std::min(minSleepTime, sleepTimes[islands.islandBodies[b]]);
+            }
+            if (minSleepTime < timeToSleep)
+            {
+                continue;
+            }
+            for (int b = islands.islandBodyStarts[island]; b < islands.islandBodyStarts[island + 1]; ++b)
+            {
+                SetAwake(islands.islandBodies[b], false);
+            }
+        } });
+}
+
+namespace
+{
+    Color GetBodyColor(bool isStatic, bool isAwake)
+    {
+        return isStatic ? Color(0, 255, 100) : (isAwake ? Color(255, 255, 255) : Color(128, 128, 128));
+    }
+
+    void DrawBox(DebugDraw &draw, const AABB &box, const Color &color)
+    {
+        const Vec2 corners[4] = {box.min, Vec2(box.max.x, box.min.y), box.max, Vec2(box.min.x, box.max.y)};
+        draw.DrawPolygon(corners, 4, color);
+    }
+
+    // A cross on each contact point, and the normal from the first one
+    void DrawContacts(DebugDraw &draw, const std::vector<Manifold> &manifolds, const std::vector<char> &touching)
+    {
+        const float size = 3.0f;
+        const float normalLength = 15.0f;
+        const Color pointColor(255, 60, 60);
+        const Color normalColor(255, 220, 0);
+        for (size_t k = 0; k < manifolds.size(); ++k)
+        {
+            const Manifold &manifold = manifolds[k];
+            if (!touching[k] || manifold.pointCount == 0)
+            {
+                continue;
+            }
+            for (int p = 0; p < manifold.pointCount; ++p)
+            {
+                const Vec2 &point = manifold.points[p].point;
+                if (!draw.IsVisible(AABB(point - Vec2(size, size), point + Vec2(size, size))))
+                {
+                    continue;
+                }
+                draw.DrawSegment(point - Vec2(size, size), point + Vec2(size, size), pointColor);
+                draw.DrawSegment(point - Vec2(size, -size), point + Vec2(size, -size), pointColor);
+                if (p == 0)
+                {
+                    draw.DrawSegment(point, point + manifold.normal * normalLength, normalColor);
+                }
+            }
+        }
+    }
+}
+
+// Bodies whose AABB is off screen are skipped before anything about them is
+// read; with thousands of bodies most of a large scene usually is.
+void World::Draw(DebugDraw &draw) const
+{
+    for (size_t i = 0; i < GetBodyCount(); ++i)
+    {
+        if (!draw.IsVisible(aabbs[i]))
+        {
+            continue;
+        }
+        if (draw.flags & DebugDraw::AABBS)
+        {
+            DrawBox(draw, aabbs[i], Color(80, 80, 200));
+        }
+        if (!(draw.flags & DebugDraw::SHAPES))
+        {
+            continue;
+        }
+        const Color color = GetBodyColor(inverseMasses[i] == 0.0f, awake[i] != 0);
+        if (shapeTypes[i] == Shape::POLYGON)
+        {
+            const std::vector<Vec2> &vertices = static_cast<const PolygonShape *>(shapes[i])->worldVertices;
+            draw.DrawPolygon(vertices.data(), static_cast<int>(vertices.size()), color);
+        }
+        else
+        {
+            const float radius = static_cast<const CircleShape *>(shapes[i])->radius;
+            draw.DrawCircle(Vec2(positionX[i], positionY[i]), radius, angles[i], color);
+        }
+    }
+    if (draw.flags & DebugDraw::CONTACTS)
+    {
+        DrawContacts(draw, manifolds, touching);
+    }
+}
+
+// The posed vertices of each polygon only live until it is drawn, so they
+// go in the frame arena. A body is culled by its AABB swept back to where it
+// was before the last step, which covers every pose in between.
+void World::DrawInterpolated(DebugDraw &draw) const
+{
+    for (size_t i = 0; i < GetBodyCount(); ++i)
+    {
+        const Vec2 offset(previousPositionX[i] - positionX[i], previousPositionY[i] - positionY[i]);
+        const AABB before(aabbs[i].min + offset, aabbs[i].max + offset);
+        if (!draw.IsVisible(AABB::Combine(aabbs[i], before)))
+        {
+            continue;
+        }
+        if (draw.flags & DebugDraw::AABBS)
+        {
+            DrawBox(draw, aabbs[i], Color(80, 80, 200));
+        }
+        if (!(draw.flags & DebugDraw::SHAPES))
+        {
+            continue;
+        }
+        const Color color = GetBodyColor(inverseMasses[i] == 0.0f, awake[i] != 0);
+        const Transform transform = GetInterpolatedTransform(i);
+        if (shapeTypes[i] == Shape::POLYGON)
+        {
+            const std::vector<Vec2> &localVertices = static_cast<const PolygonShape *>(shapes[i])->GetLocalVertices();
+            const FrameArena::Marker marker = frameArena.GetMarker();
+            Vec2 *vertices = frameArena.Allocate<Vec2>(localVertices.size());
+            for (size_t k = 0; k < localVertices.size(); ++k)
+            {
+                vertices[k] = transform.Apply(localVertices[k]);
+            }
+            draw.DrawPolygon(vertices, static_cast<int>(localVertices.size()), color);
+            frameArena.Rewind(marker);
+        }
+        else
+        {
+            const float radius = static_cast<const CircleShape *>(shapes[i])->radius;
+            draw.DrawCircle(transform.position, radius, transform.angle, color);
+        }
+    }
+    if (draw.flags & DebugDraw::CONTACTS)
+    {
+        DrawContacts(draw, manifolds, touching);
+    }
+}
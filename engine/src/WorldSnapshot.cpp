@@ -0,0 +1,379 @@
+#include <World.h>
+#include <algorithm>
+
+// Saving, restoring and cloning a World (see Snapshot.h for the format).
+//
+// The body arrays go into the snapshot as they are. What a step recomputes
+// from them before using it (the pairs, manifolds and islands of the last
+// step) is left out; the contact cache is kept, so that the next step warm
+// starts exactly as it would have. The broadphase is left alone: it always
+// reports exactly the overlaps of the boxes it is given, whatever it cached
+// (see Broadphase::FindPairs), so after a restore it just sees bodies that moved. Shapes hold
+// pointers, so they are saved as records instead: a mass and radius per
+// body, and an index into a table of the polygon outlines.
+
+namespace
+{
+    // Section ids. Sections below firstSharedSection have one entry per body.
+    enum Section : std::uint32_t
+    {
+        PositionX = 1,
+        PositionY,
+        VelocityX,
+        VelocityY,
+        ForceX,
+        ForceY,
+        Angles,
+        AngularVelocities,
+        Torques,
+        InverseMasses,
+        InverseInertias,
+        ShapeTypes,
+        Transforms,
+        IndexToSlot,
+        Awake,
+        SleepTimes,
+        ActiveInverseMasses,
+        ActiveInverseInertias,
+        Bullets,
+        PreviousPositionX,
+        PreviousPositionY,
+        PreviousAngles,
+        AABBs,
+        Shapes,
+
+        firstSharedSection = 64,
+        Slots = firstSharedSection,
+        FreeSlots,
+        PairCache,
+        Settings,
+        Geometries,
+        Vertices,
+    };
+
+    const std::uint32_t noGeometry = 0xFFFFFFFFu;
+
+    struct ShapeRecord
+    {
+        float mass;
+        float radius;          // Circles
+        std::uint32_t geometry; // Polygons: index into the Geometries section
+    };
+
+    struct GeometryRecord
+    {
+        std::uint32_t firstVertex; // Into the Vertices section
+        std::uint32_t vertexCount;
+    };
+
+    struct SettingsRecord
+    {
+        Vec2 gravity;
+        float fixedTimeStep;
+        int maxStepsPerUpdate;
+        int substeps;
+        SolverSettings solverSettings;
+        std::uint8_t allowSleep;
+        float sleepLinearTolerance;
+        float sleepAngularTolerance;
+        float timeToSleep;
+        int maxBulletSubsteps;
+        std::uint64_t bulletCount;
+        float accumulator;
+    };
+}
+
+template <typename Fn, typename... Worlds>
+void World::ForEachStateArray(Fn &&fn, Worlds &...worlds)
+{
+    fn(PositionX, worlds.positionX...);
+    fn(PositionY, worlds.positionY...);
+    fn(VelocityX, worlds.velocityX...);
+    fn(VelocityY, worlds.velocityY...);
+    fn(ForceX, worlds.forceX...);
+    fn(ForceY, worlds.forceY...);
+    fn(Angles, worlds.angles...);
+    fn(AngularVelocities, worlds.angularVelocities...);
+    fn(Torques, worlds.torques...);
+    fn(InverseMasses, worlds.inverseMasses...);
+    fn(InverseInertias, worlds.inverseInertias...);
+    fn(ShapeTypes, worlds.shapeTypes...);
+    fn(Transforms, worlds.transforms...);
+    fn(IndexToSlot, worlds.indexToSlot...);
+    fn(Awake, worlds.awake...);
+    fn(SleepTimes, worlds.sleepTimes...);
+    fn(ActiveInverseMasses, worlds.activeInverseMasses...);
+    fn(ActiveInverseInertias, worlds.activeInverseInertias...);
+    fn(Bullets, worlds.bullets...);
+    fn(PreviousPositionX, worlds.previousPositionX...);
+    fn(PreviousPositionY, worlds.previousPositionY...);
+    fn(PreviousAngles, worlds.previousAngles...);
+    fn(AABBs, worlds.aabbs...);
+    fn(Slots, worlds.slots...);
+    fn(FreeSlots, worlds.freeSlots...);
+    fn(PairCache, worlds.pairCache...);
+}
+
+void World::Save(Snapshot &snapshot) const
+{
+    snapshot.Begin(SnapshotKind::World);
+    ForEachStateArray([&](std::uint32_t id, const auto &array)
+                      { snapshot.Write(id, array); },
+                      *this);
+
+    SettingsRecord settings = {};
+    settings.gravity = gravity;
+    settings.fixedTimeStep = fixedTimeStep;
+    settings.maxStepsPerUpdate = maxStepsPerUpdate;
+    settings.substeps = substeps;
+    settings.solverSettings = solverSettings;
+    settings.allowSleep = allowSleep ? 1 : 0;
+    settings.sleepLinearTolerance = sleepLinearTolerance;
+    settings.sleepAngularTolerance = sleepAngularTolerance;
+    settings.timeToSleep = timeToSleep;
+    settings.maxBulletSubsteps = maxBulletSubsteps;
+    settings.bulletCount = bulletCount;
+    settings.accumulator = accumulator;
+    snapshot.WriteValue(Settings, settings);
+
+    // The shapes, with each shared outline written once. Outlines are told
+    // apart by address, through a small open addressing table in the frame
+    // arena, so a warm Save allocates nothing.
+    const FrameArena::Marker marker = frameArena.GetMarker();
+    size_t tableSize = 1;
+    while (tableSize < 2 * GetBodyCount())
+    {
+        tableSize *= 2;
+    }
+    struct Entry
+    {
+        const PolygonGeometry *geometry;
+        std::uint32_t index;
+    };
+    Entry *table = frameArena.Allocate<Entry>(tableSize);
+    std::fill(table, table + tableSize, Entry{nullptr, 0});
+    const PolygonGeometry **geometries = frameArena.Allocate<const PolygonGeometry *>(GetBodyCount());
+    std::uint32_t geometryCount = 0;
+    size_t vertexCount = 0;
+
+    ShapeRecord *records = snapshot.Add<ShapeRecord>(Shapes, GetBodyCount());
+    for (size_t i = 0; i < GetBodyCount(); ++i)
+    {
+        records[i] = {shapes[i]->mass, 0.0f, noGeometry};
+        if (shapeTypes[i] == Shape::CIRCLE)
+        {
+            records[i].radius = static_cast<const CircleShape *>(shapes[i])->radius;
+            continue;
+        }
+        const PolygonGeometry *geometry = static_cast<const PolygonShape *>(shapes[i])->geometry.get();
+        size_t slot = (reinterpret_cast<std::uintptr_t>(geometry) >> 4) & (tableSize - 1);
+        while (table[slot].geometry && table[slot].geometry != geometry)
+        {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (!table[slot].geometry)
+        {
+            table[slot] = {geometry, geometryCount};
+            geometries[geometryCount++] = geometry;
+            vertexCount += geometry->vertices.size();
+        }
+        records[i].geometry = table[slot].index;
+    }
+
+    GeometryRecord *geometryRecords = snapshot.Add<GeometryRecord>(Geometries, geometryCount);
+    std::uint32_t firstVertex = 0;
+    for (std::uint32_t g = 0; g < geometryCount; ++g)
+    {
+        const std::uint32_t count = static_cast<std::uint32_t>(geometries[g]->vertices.size());
+        geometryRecords[g] = {firstVertex, count};
+        firstVertex += count;
+    }
+    Vec2 *vertices = snapshot.Add<Vec2>(Vertices, vertexCount);
+    for (std::uint32_t g = 0; g < geometryCount; ++g)
+    {
+        vertices = std::copy(geometries[g]->vertices.begin(), geometries[g]->vertices.end(), vertices);
+    }
+    frameArena.Rewind(marker);
+
+    snapshot.End();
+}
+
+bool World::Restore(const SnapshotReader &reader)
+{
+    // Check everything before changing anything
+    SettingsRecord settings;
+    size_t bodyCount = 0;
+    size_t slotCount = 0;
+    if (!reader.IsValid(SnapshotKind::World) || !reader.ReadValue(Settings, settings) ||
+        !reader.Get<float>(PositionX, bodyCount) || !reader.Get<Slot>(Slots, slotCount))
+    {
+        return false;
+    }
+    bool valid = true;
+    ForEachStateArray([&](std::uint32_t id, auto &array)
+                      {
+        size_t count;
+        const auto *elements = reader.Get<typename std::remove_reference_t<decltype(array)>::value_type>(id, count);
+        valid = valid && elements && (id >= firstSharedSection || count == bodyCount); },
+                      *this);
+
+    size_t shapeCount, geometryCount, vertexCount, count;
+    const ShapeRecord *records = reader.Get<ShapeRecord>(Shapes, shapeCount);
+    const GeometryRecord *geometryRecords = reader.Get<GeometryRecord>(Geometries, geometryCount);
+    const Vec2 *vertices = reader.Get<Vec2>(Vertices, vertexCount);
+    const Shape::Type *types = reader.Get<Shape::Type>(ShapeTypes, count);
+    const Slot *savedSlots = reader.Get<Slot>(Slots, count);
+    const std::uint32_t *savedIndexToSlot = reader.Get<std::uint32_t>(IndexToSlot, count);
+    size_t freeSlotCount;
+    const std::uint32_t *savedFreeSlots = reader.Get<std::uint32_t>(FreeSlots, freeSlotCount);
+    valid = valid && shapeCount == bodyCount &&
+            std::all_of(savedFreeSlots, savedFreeSlots + freeSlotCount, [&](std::uint32_t slot)
+                        { return slot < slotCount; });
+    for (size_t i = 0; valid && i < bodyCount; ++i)
+    {
+        valid = (types[i] == Shape::CIRCLE || (types[i] == Shape::POLYGON && records[i].geometry < geometryCount)) &&
+                savedIndexToSlot[i] < slotCount && savedSlots[savedIndexToSlot[i]].index == i;
+    }
+    for (size_t g = 0; valid && g < geometryCount; ++g)
+    {
+        valid = geometryRecords[g].vertexCount >= 3 &&
+                geometryRecords[g].firstVertex + static_cast<size_t>(geometryRecords[g].vertexCount) <= vertexCount;
+    }
+
+    // The contact cache is looked up by binary search, and its counts bound
+    // loops over fixed size arrays in the next step
+    size_t cachedCount;
+    const CachedPair *cached = reader.Get<CachedPair>(PairCache, cachedCount);
+    for (size_t k = 0; valid && k < cachedCount; ++k)
+    {
+        valid = (k == 0 || cached[k - 1].key < cached[k].key) && cached[k].manifold.pointCount >= 0 &&
+                cached[k].manifold.pointCount <= 2 && cached[k].cache.simplex.count <= 3 &&
+                cached[k].cache.axis.support >= 0;
+    }
+    if (!valid)
+    {
+        return false;
+    }
+
+    ForEachStateArray([&](std::uint32_t id, auto &array)
+                      { reader.Read(id, array); },
+                      *this);
+
+    gravity = settings.gravity;
+    fixedTimeStep = settings.fixedTimeStep;
+    maxStepsPerUpdate = settings.maxStepsPerUpdate;
+    substeps = settings.substeps;
+    solverSettings = settings.solverSettings;
+    allowSleep = settings.allowSleep != 0;
+    sleepLinearTolerance = settings.sleepLinearTolerance;
+    sleepAngularTolerance = settings.sleepAngularTolerance;
+    timeToSleep = settings.timeToSleep;
+    maxBulletSubsteps = settings.maxBulletSubsteps;
+    bulletCount = static_cast<size_t>(settings.bulletCount);
+    accumulator = settings.accumulator;
+
+    // Shapes are rebuilt from the records. A body whose current shape has
+    // the right type keeps it and only has its fields overwritten, so rolling
+    // back to a recent snapshot hardly touches the pools. The world vertices
+    // are recomputed from the saved transforms, which is exactly how the
+    // saved world got them.
+    std::vector<std::shared_ptr<const PolygonGeometry>> geometries(geometryCount);
+    for (size_t g = 0; g < geometryCount; ++g)
+    {
+        const Vec2 *first = vertices + geometryRecords[g].firstVertex;
+        geometries[g] = shapeRegistry.GetPolygon(std::vector<Vec2>(first, first + geometryRecords[g].vertexCount));
+    }
+    for (size_t i = bodyCount; i < shapes.size(); ++i)
+    {
+        ReleaseShape(shapes[i]);
+    }
+    shapes.resize(bodyCount, nullptr);
+    for (size_t i = 0; i < bodyCount; ++i)
+    {
+        if (shapes[i] && shapes[i]->GetType() != shapeTypes[i])
+        {
+            ReleaseShape(shapes[i]);
+            shapes[i] = nullptr;
+        }
+
+        if (shapeTypes[i] == Shape::CIRCLE)
+        {
+            if (!shapes[i])
+            {
+                shapes[i] = circlePool.Create(CircleShape(records[i].radius, records[i].mass));
+            }
+            CircleShape *circle = static_cast<CircleShape *>(shapes[i]);
+            circle->radius = records[i].radius;
+            circle->mass = records[i].mass;
+            continue;
+        }
+
+        const std::shared_ptr<const PolygonGeometry> &geometry = geometries[records[i].geometry];
+        if (!shapes[i])
+        {
+            shapes[i] = polygonPool.Create(PolygonShape(geometry, records[i].mass));
+        }
+        PolygonShape *polygon = static_cast<PolygonShape *>(shapes[i]);
+        if (polygon->geometry != geometry)
+        {
+            const std::shared_ptr<const PolygonGeometry> replaced = std::move(polygon->geometry);
+            polygon->geometry = geometry;
+            shapeRegistry.Release(replaced);
+            polygon->worldVertices.resize(geometry->vertices.size());
+            polygon->worldNormals.resize(geometry->vertices.size());
+        }
+        polygon->mass = records[i].mass;
+        polygon->UpdateWorldVertices(transforms[i]);
+    }
+
+    // Last step's results refer to the old bodies; the next step recomputes them
+    pairs.clear();
+    manifolds.clear();
+    touching.clear();
+    tested.clear();
+    narrowPhaseCaches.clear();
+    bulletStarts.clear();
+    return true;
+}
+
+std::unique_ptr<World> World::Clone() const
+{
+    // Started with this world's thread count, not restarted with it
+    auto copy = std::make_unique<World>(GetThreadCount());
+    copy->SetBroadphase(broadphase->Clone());
+
+    ForEachStateArray([](std::uint32_t, auto &to, const auto &from)
+                      { to = from; },
+                      *copy, *this);
+    copy->gravity = gravity;
+    copy->fixedTimeStep = fixedTimeStep;
+    copy->maxStepsPerUpdate = maxStepsPerUpdate;
+    copy->substeps = substeps;
+    copy->solverSettings = solverSettings;
+    copy->allowSleep = allowSleep;
+    copy->sleepLinearTolerance = sleepLinearTolerance;
+    copy->sleepAngularTolerance = sleepAngularTolerance;
+    copy->timeToSleep = timeToSleep;
+    copy->maxBulletSubsteps = maxBulletSubsteps;
+    copy->bulletCount = bulletCount;
+    copy->accumulator = accumulator;
+    copy->hashEachStep = hashEachStep;
+    copy->stateHash = stateHash;
+
+    // Shapes are copied whole, world vertices included
+    copy->shapes.reserve(shapes.size());
+    for (const Shape *shape : shapes)
+    {
+        copy->shapes.push_back(copy->CreateShape(*shape));
+    }
+
+    // The broadphase was copied with its state, so the last step's results
+    // still match it
+    copy->pairs = pairs;
+    copy->manifolds = manifolds;
+    copy->touching = touching;
+    copy->tested = tested;
+    copy->narrowPhaseCaches = narrowPhaseCaches;
+    copy->islands = islands;
+    return copy;
+}